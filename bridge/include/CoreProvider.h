@@ -128,6 +128,7 @@ public:
 	void			(*UpdateAdminCmdFlags)(const char *cmd, OverrideType type, FlagBits bits, bool remove);
 	bool			(*LookForCommandAdminFlags)(const char *cmd, FlagBits *pFlags);
 	int             (*GetGlobalTarget)();
+	void            (*InvalidateTargetCache)();
 };
 
 } // namespace SourceMod
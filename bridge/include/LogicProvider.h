@@ -52,6 +52,20 @@ class ITextParsers;
 class ILogger;
 class ICellArray;
 
+// Work that core hands to logic's async file workers. It is ordered against
+// every other async file task on the same path, or on a directory containing
+// it, in submission order.
+class IFileTask
+{
+public:
+	virtual ~IFileTask()
+	{}
+	// Called on a worker thread. Tasks still queued at shutdown are run then.
+	virtual void Run() = 0;
+	// Called on the main thread after Run(), unless the owner was unloaded.
+	virtual void Complete() = 0;
+};
+
 struct sm_logic_t
 {
 	SMGlobalClass	*head;
@@ -77,6 +91,8 @@ struct sm_logic_t
 	void            (*Shutdown)();
 	void            (*SetJitEnabled)(bool enabled);
 	void            (*SetDebugMetadataFlags)(int flags);
+	bool            (*QueueFileTask)(const char *path, IdentityToken_t *owner, IFileTask *task);
+	void            (*RunFileTaskNow)(const char *path, IFileTask *task);
 	IScriptManager	*scripts;
 	IShareSys		*sharesys;
 	IExtensionSys	*extsys;
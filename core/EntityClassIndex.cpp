@@ -0,0 +1,393 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod
+ * Copyright (C) 2004-2026 AlliedModders LLC.  All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.  AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>.
+ *
+ * Version: $Id$
+ */
+
+#include "EntityClassIndex.h"
+#include "HalfLife2.h"
+#include "logic_bridge.h"
+#include <IGameConfigs.h>
+#include <utlvector.h>
+#include <algorithm>
+#include <string.h>
+
+EntityClassIndex g_EntityClassIndex;
+
+static IGameConfigManager *gameconfs = NULL;
+static IGameConfig *listener_conf = NULL;
+
+static CUtlVector<IEntityListener *> *EntListeners()
+{
+	void *gEntList = g_HL2.GetGlobalEntityList();
+	if (gEntList)
+	{
+		int offset = -1;
+		if (listener_conf->GetOffset("EntityListeners", &offset))
+		{
+			return (CUtlVector<IEntityListener *> *)((intptr_t)gEntList + offset);
+		}
+	}
+	else
+	{
+		void *entListeners;
+		if (listener_conf->GetAddress("EntityListenersPtr", &entListeners))
+		{
+			return (CUtlVector<IEntityListener *> *)entListeners;
+		}
+	}
+
+	return NULL;
+}
+
+static inline int EntityIndex(CBaseEntity *pEntity)
+{
+	CBaseHandle hndl = reinterpret_cast<IServerUnknown *>(pEntity)->GetRefEHandle();
+	return hndl.IsValid() ? hndl.GetEntryIndex() : -1;
+}
+
+static bool MatchesPattern(const char *pattern, size_t len, bool prefix, const char *classname)
+{
+	if (prefix)
+	{
+		return strncmp(classname, pattern, len) == 0;
+	}
+	return strcmp(classname, pattern) == 0;
+}
+
+EntityClassIndex::EntityClassIndex()
+	: m_Listening(false),
+	  m_Unavailable(false)
+{
+	m_Slots.resize(NUM_ENT_ENTRIES);
+	m_Live.reserve(NUM_ENT_ENTRIES);
+	Reset();
+}
+
+void EntityClassIndex::OnSourceModLevelChange(const char *mapName)
+{
+	StartListening();
+}
+
+void EntityClassIndex::OnSourceModShutdown()
+{
+	if (m_Listening)
+	{
+		CUtlVector<IEntityListener *> *entListeners = EntListeners();
+		if (entListeners)
+		{
+			entListeners->FindAndRemove(this);
+		}
+		m_Listening = false;
+	}
+
+	if (listener_conf)
+	{
+		gameconfs->CloseGameConfigFile(listener_conf);
+		listener_conf = NULL;
+	}
+
+	Reset();
+}
+
+bool EntityClassIndex::StartListening()
+{
+	if (m_Listening)
+		return true;
+	if (m_Unavailable)
+		return false;
+
+	// The listener list lives at an engine specific location, which SDKHooks
+	// already maintains gamedata for.
+	if (!gameconfs && !sharesys->RequestInterface(SMINTERFACE_GAMECONFIG_NAME,
+	                                               SMINTERFACE_GAMECONFIG_VERSION,
+	                                               NULL,
+	                                               (SMInterface **)&gameconfs))
+	{
+		m_Unavailable = true;
+		return false;
+	}
+
+	char error[255];
+	if (!listener_conf && !gameconfs->LoadGameConfigFile("sdkhooks.games", &listener_conf, error, sizeof(error)))
+	{
+		logger->LogError("[SM] Entity class index unavailable, could not read sdkhooks.games gamedata: %s", error);
+		listener_conf = NULL;
+		m_Unavailable = true;
+		return false;
+	}
+
+	CUtlVector<IEntityListener *> *entListeners = EntListeners();
+	if (!entListeners)
+	{
+		// The global entity list may not exist until the first map loads.
+		if (!g_HL2.GetGlobalEntityList())
+			return false;
+
+		m_Unavailable = true;
+		return false;
+	}
+
+	entListeners->AddToTail(this);
+	m_Listening = true;
+
+	Seed();
+	return true;
+}
+
+void EntityClassIndex::Reset()
+{
+	for (size_t i = 0; i < m_Slots.size(); i++)
+	{
+		Slot &slot = m_Slots[i];
+		slot.entity = NULL;
+		slot.classname = NULL;
+		slot.classId = -1;
+		slot.prev = -1;
+		slot.next = -1;
+		slot.livePos = -1;
+	}
+	m_Live.clear();
+	m_Classes.clear();
+	m_ClassIds.clear();
+	m_PooledIds.clear();
+}
+
+void EntityClassIndex::Seed()
+{
+	Reset();
+
+	for (int i = 0; i < NUM_ENT_ENTRIES; i++)
+	{
+		CBaseEntity *pEntity = g_HL2.ReferenceToEntity(i);
+		if (pEntity)
+			Insert(i, pEntity);
+	}
+}
+
+int EntityClassIndex::FindClassId(const char *classname)
+{
+	// Classnames are pooled, so the pointer nearly always identifies the class.
+	// The name is still compared in case the pool handed the address out again.
+	auto pooled = m_PooledIds.find(classname);
+	if (pooled != m_PooledIds.end() && m_Classes[pooled->second].name == classname)
+		return pooled->second;
+
+	int id;
+	auto named = m_ClassIds.find(classname);
+	if (named == m_ClassIds.end())
+	{
+		id = (int)m_Classes.size();
+		m_Classes.push_back(ClassList());
+		m_Classes[id].name = classname;
+		m_Classes[id].head = -1;
+		m_Classes[id].count = 0;
+		m_ClassIds.emplace(classname, id);
+	}
+	else
+	{
+		id = named->second;
+	}
+
+	m_PooledIds[classname] = id;
+	return id;
+}
+
+void EntityClassIndex::Link(int index, const char *classname)
+{
+	Slot &slot = m_Slots[index];
+	slot.classname = classname;
+	if (!classname)
+		return;
+
+	int id = FindClassId(classname);
+	ClassList &cls = m_Classes[id];
+	slot.classId = id;
+	slot.prev = -1;
+	slot.next = cls.head;
+	if (cls.head != -1)
+		m_Slots[cls.head].prev = index;
+	cls.head = index;
+	cls.count++;
+}
+
+void EntityClassIndex::Unlink(int index)
+{
+	Slot &slot = m_Slots[index];
+	if (slot.classId == -1)
+		return;
+
+	ClassList &cls = m_Classes[slot.classId];
+	if (slot.prev != -1)
+		m_Slots[slot.prev].next = slot.next;
+	else
+		cls.head = slot.next;
+	if (slot.next != -1)
+		m_Slots[slot.next].prev = slot.prev;
+	cls.count--;
+
+	slot.classId = -1;
+	slot.prev = -1;
+	slot.next = -1;
+}
+
+void EntityClassIndex::Insert(int index, CBaseEntity *pEntity)
+{
+	Slot &slot = m_Slots[index];
+	if (slot.livePos == -1)
+	{
+		slot.livePos = (int)m_Live.size();
+		m_Live.push_back(index);
+	}
+	else
+	{
+		Unlink(index);
+	}
+
+	slot.entity = pEntity;
+	Link(index, g_HL2.GetEntityClassname(pEntity));
+}
+
+void EntityClassIndex::Remove(int index)
+{
+	Slot &slot = m_Slots[index];
+	if (slot.livePos == -1)
+		return;
+
+	Unlink(index);
+
+	int last = m_Live.back();
+	m_Live[slot.livePos] = last;
+	m_Slots[last].livePos = slot.livePos;
+	m_Live.pop_back();
+
+	slot.entity = NULL;
+	slot.classname = NULL;
+	slot.livePos = -1;
+}
+
+void EntityClassIndex::Refresh()
+{
+	for (size_t i = 0; i < m_Live.size(); i++)
+	{
+		int index = m_Live[i];
+		Slot &slot = m_Slots[index];
+
+		const char *classname = g_HL2.GetEntityClassname(slot.entity);
+		if (classname != slot.classname)
+		{
+			Unlink(index);
+			Link(index, classname);
+		}
+	}
+}
+
+void EntityClassIndex::OnEntityCreated(CBaseEntity *pEntity)
+{
+	int index = EntityIndex(pEntity);
+	if (index != -1)
+		Insert(index, pEntity);
+}
+
+void EntityClassIndex::OnEntitySpawned(CBaseEntity *pEntity)
+{
+	// Keyvalues applied before spawn can still change the classname.
+	OnEntityCreated(pEntity);
+}
+
+void EntityClassIndex::OnEntityDeleted(CBaseEntity *pEntity)
+{
+	int index = EntityIndex(pEntity);
+	if (index != -1)
+		Remove(index);
+}
+
+void EntityClassIndex::ScanAll(const char *pattern, std::vector<CBaseEntity *> &out)
+{
+	size_t len = strlen(pattern);
+	bool prefix = len > 0 && pattern[len - 1] == '*';
+	if (prefix)
+		len--;
+
+	for (int i = 0; i < NUM_ENT_ENTRIES; i++)
+	{
+		CBaseEntity *pEntity = g_HL2.ReferenceToEntity(i);
+		if (!pEntity)
+			continue;
+
+		const char *classname = g_HL2.GetEntityClassname(pEntity);
+		if (classname && MatchesPattern(pattern, len, prefix, classname))
+			out.push_back(pEntity);
+	}
+}
+
+void EntityClassIndex::FindByClassname(const char *pattern, std::vector<CBaseEntity *> &out)
+{
+	if (!StartListening())
+	{
+		ScanAll(pattern, out);
+		return;
+	}
+
+	size_t len = strlen(pattern);
+	bool prefix = len > 0 && pattern[len - 1] == '*';
+	if (prefix)
+		len--;
+
+	// Pick up classnames changed since the last search, including entities
+	// renamed to the class being searched for.
+	Refresh();
+
+	std::vector<int> indices;
+	if (prefix)
+	{
+		for (size_t i = 0; i < m_Classes.size(); i++)
+		{
+			const ClassList &cls = m_Classes[i];
+			if (cls.count == 0 || !MatchesPattern(pattern, len, prefix, cls.name.c_str()))
+				continue;
+
+			for (int index = cls.head; index != -1; index = m_Slots[index].next)
+				indices.push_back(index);
+		}
+	}
+	else
+	{
+		auto iter = m_ClassIds.find(pattern);
+		if (iter != m_ClassIds.end())
+		{
+			for (int index = m_Classes[iter->second].head; index != -1; index = m_Slots[index].next)
+				indices.push_back(index);
+		}
+	}
+	std::sort(indices.begin(), indices.end());
+
+	out.reserve(out.size() + indices.size());
+	for (size_t i = 0; i < indices.size(); i++)
+		out.push_back(m_Slots[indices[i]].entity);
+}
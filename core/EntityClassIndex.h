@@ -0,0 +1,132 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod
+ * Copyright (C) 2004-2026 AlliedModders LLC.  All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.  AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>.
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_ENTITY_CLASS_INDEX_H_
+#define _INCLUDE_SOURCEMOD_ENTITY_CLASS_INDEX_H_
+
+#include "sm_globals.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CBaseEntity;
+
+// Mirrors IEntityListener from game/server/entitylist.h.
+class IEntityListener
+{
+public:
+#if SOURCE_ENGINE == SE_BMS
+	virtual ~IEntityListener() {};
+	virtual void OnEntityPreSpawned(CBaseEntity *pEntity) {};
+#endif
+	virtual void OnEntityCreated(CBaseEntity *pEntity) {};
+	virtual void OnEntitySpawned(CBaseEntity *pEntity) {};
+	virtual void OnEntityDeleted(CBaseEntity *pEntity) {};
+#if SOURCE_ENGINE == SE_BMS
+	virtual void OnEntityFlagsChanged(CBaseEntity *pEntity, int nAddedFlags, int nRemovedFlags) {};
+#endif
+};
+
+/**
+ * Keeps a classname -> entity index map up to date from the game's entity
+ * listener list, so batched entity searches don't have to walk every slot.
+ *
+ * The engine doesn't announce classname changes, so each slot remembers the
+ * m_iClassname pointer it was indexed under and every search first re-buckets
+ * the entities whose pointer changed. Classnames are pooled strings, so that
+ * costs one pointer compare per live entity.
+ *
+ * If the listener list can't be found in gamedata, searches fall back to a
+ * full scan of the entity list.
+ */
+class EntityClassIndex :
+	public SMGlobalClass,
+	public IEntityListener
+{
+public:
+	EntityClassIndex();
+public: // SMGlobalClass
+	void OnSourceModLevelChange(const char *mapName) override;
+	void OnSourceModShutdown() override;
+public: // IEntityListener
+	void OnEntityCreated(CBaseEntity *pEntity) override;
+	void OnEntitySpawned(CBaseEntity *pEntity) override;
+	void OnEntityDeleted(CBaseEntity *pEntity) override;
+public:
+	/**
+	 * Collects entities whose classname matches a pattern. A trailing '*'
+	 * matches any classname with the given prefix.
+	 *
+	 * @param pattern		Classname or classname prefix ending in '*'.
+	 * @param out			Vector to append matching entities to, in index order.
+	 */
+	void FindByClassname(const char *pattern, std::vector<CBaseEntity *> &out);
+private:
+	struct Slot
+	{
+		CBaseEntity *entity;
+		const char *classname;	// m_iClassname when last indexed, compared by pointer
+		int classId;			// -1 if not in any class list
+		int prev;
+		int next;
+		int livePos;			// Position in m_Live, -1 if the slot is free
+	};
+	struct ClassList
+	{
+		std::string name;
+		int head;
+		int count;
+	};
+private:
+	bool StartListening();
+	void Reset();
+	void Seed();
+	void Insert(int index, CBaseEntity *pEntity);
+	void Remove(int index);
+	void Link(int index, const char *classname);
+	void Unlink(int index);
+	int FindClassId(const char *classname);
+	void Refresh();
+	void ScanAll(const char *pattern, std::vector<CBaseEntity *> &out);
+private:
+	// Flat per-index storage, class lists are threaded through the slots.
+	std::vector<Slot> m_Slots;
+	std::vector<int> m_Live;
+	std::vector<ClassList> m_Classes;
+	std::unordered_map<std::string, int> m_ClassIds;
+	std::unordered_map<const char *, int> m_PooledIds;
+	bool m_Listening;
+	bool m_Unavailable;
+};
+
+extern EntityClassIndex g_EntityClassIndex;
+
+#endif //_INCLUDE_SOURCEMOD_ENTITY_CLASS_INDEX_H_
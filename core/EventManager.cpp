@@ -35,6 +35,7 @@
 
 #include "logic_bridge.h"
 #include <bridge/include/IScriptManager.h>
+#include <algorithm>
 
 EventManager g_EventManager;
 
@@ -57,7 +58,7 @@ public:
 	}
 };
 
-EventManager::EventManager() : m_EventType(0)
+EventManager::EventManager() : m_EventType(0), m_FilterType(0), m_EventDepth(0)
 {
 }
 
@@ -88,6 +89,9 @@ void EventManager::OnSourceModAllInitialized()
 
 	/* Create the 'GameEvent' handle type */
 	m_EventType = handlesys->CreateType("GameEvent", this, 0, NULL, &sec, g_pCoreIdent, NULL);
+
+	/* Create the 'GameEventFilter' handle type */
+	m_FilterType = handlesys->CreateType("GameEventFilter", this, 0, NULL, NULL, g_pCoreIdent, NULL);
 }
 
 void EventManager::OnSourceModShutdown()
@@ -96,8 +100,18 @@ void EventManager::OnSourceModShutdown()
 	SH_REMOVE_HOOK(IGameEventManager2, FireEvent, gameevents, SH_MEMBER(this, &EventManager::OnFireEvent), false);
 	SH_REMOVE_HOOK(IGameEventManager2, FireEvent, gameevents, SH_MEMBER(this, &EventManager::OnFireEvent_Post), true);
 
-	/* Remove the 'GameEvent' handle type */
+	/* Free the pooled hook handles */
+	HandleSecurity sec(NULL, g_pCoreIdent);
+	for (size_t i = 0; i < m_HookSlots.size(); i++)
+	{
+		handlesys->FreeHandle(m_HookSlots[i]->hndl, &sec);
+		delete m_HookSlots[i];
+	}
+	m_HookSlots.clear();
+
+	/* Remove the 'GameEvent' and 'GameEventFilter' handle types */
 	handlesys->RemoveType(m_EventType, g_pCoreIdent);
+	handlesys->RemoveType(m_FilterType, g_pCoreIdent);
 
 	/* Remove ourselves as listener for events */
 	gameevents->RemoveListener(this);
@@ -105,6 +119,12 @@ void EventManager::OnSourceModShutdown()
 
 void EventManager::OnHandleDestroy(HandleType_t type, void *object)
 {
+	if (type == m_FilterType)
+	{
+		delete static_cast<EventFilter *>(object);
+		return;
+	}
+
 	EventInfo *pInfo = static_cast<EventInfo *>(object);
 
 	/* Should only free event when created by a plugin */
@@ -131,6 +151,8 @@ void EventManager::OnPluginUnloaded(IPlugin *plugin)
 		{
 			pHook = (*iter);
 
+			RemoveFilteredCallbacks(pHook, plugin->GetBaseContext());
+
 			if (--pHook->refCount == 0)
 			{
 				if (pHook->pPreHook)
@@ -259,6 +281,118 @@ EventHookError EventManager::HookEvent(const char *name, IPluginFunction *pFunct
 	return EventHookErr_Okay;
 }
 
+EventHookError EventManager::HookFilteredEvent(const char *name, IPluginFunction *pFunction, const EventFilter &filter, EventHookMode mode)
+{
+	EventHook *pHook;
+	EventHookList *pHookList;
+
+	/* If we aren't listening to this event... */
+	if (!gameevents->FindListener(this, name))
+	{
+		/* Then add ourselves */
+		if (!gameevents->AddListener(this, name, true))
+		{
+			/* If event doesn't exist... */
+			return EventHookErr_InvalidEvent;
+		}
+	}
+
+	/* A hook structure may exist with neither forward in use */
+	if (!m_EventHooks.retrieve(name, &pHook))
+	{
+		pHook = new EventHook();
+		pHook->name = name;
+		m_EventHooks.insert(name, pHook);
+	}
+
+	IPlugin *plugin = scripts->FindPluginByContext(pFunction->GetParentContext());
+
+	/* Every filtered hook is tracked in the plugin's list so unloading releases it */
+	if (!plugin->GetProperty("EventHooks", (void **)&pHookList))
+	{
+		pHookList = new EventHookList();
+		plugin->SetProperty("EventHooks", pHookList);
+	}
+	pHookList->push_back(pHook);
+
+	if (mode == EventHookMode_Pre)
+	{
+		pHook->filteredPre.push_back(new FilteredEventCallback(pFunction, filter));
+	} else {
+		/* Filters have to read the event, so a post hook always needs a copy */
+		pHook->postCopy = true;
+		pHook->filteredPost.push_back(new FilteredEventCallback(pFunction, filter));
+	}
+
+	pHook->refCount++;
+
+	return EventHookErr_Okay;
+}
+
+EventHookError EventManager::UnhookFilteredEvent(EventHook *pHook, IPluginFunction *pFunction, EventHookMode mode)
+{
+	FilteredEventList &list = (mode == EventHookMode_Pre) ? pHook->filteredPre : pHook->filteredPost;
+	bool found = false;
+
+	for (FilteredEventList::iterator iter(list); !iter.done(); iter.next())
+	{
+		if ((*iter)->pFunction == pFunction)
+		{
+			delete (*iter);
+			iter.remove();
+			found = true;
+			break;
+		}
+	}
+
+	if (!found)
+	{
+		return EventHookErr_InvalidCallback;
+	}
+
+	EventHookList *pHookList;
+	IPlugin *plugin = scripts->FindPluginByContext(pFunction->GetParentContext());
+
+	/* Drop one reference from the plugin's list, matching HookFilteredEvent */
+	if (plugin->GetProperty("EventHooks", (void **)&pHookList))
+	{
+		EventHookList::iterator iter = pHookList->find(pHook);
+		if (iter != pHookList->end())
+		{
+			pHookList->erase(iter);
+		}
+	}
+
+	if (--pHook->refCount == 0)
+	{
+		m_EventHooks.remove(pHook->name.c_str());
+		delete pHook;
+	}
+
+	return EventHookErr_Okay;
+}
+
+void EventManager::RemoveFilteredCallbacks(EventHook *pHook, IPluginContext *pContext)
+{
+	for (FilteredEventList::iterator iter(pHook->filteredPre); !iter.done(); iter.next())
+	{
+		if ((*iter)->pFunction->GetParentContext() == pContext)
+		{
+			delete (*iter);
+			iter.remove();
+		}
+	}
+
+	for (FilteredEventList::iterator iter(pHook->filteredPost); !iter.done(); iter.next())
+	{
+		if ((*iter)->pFunction->GetParentContext() == pContext)
+		{
+			delete (*iter);
+			iter.remove();
+		}
+	}
+}
+
 EventHookError EventManager::UnhookEvent(const char *name, IPluginFunction *pFunction, EventHookMode mode)
 {
 	EventHook *pHook;
@@ -278,10 +412,10 @@ EventHookError EventManager::UnhookEvent(const char *name, IPluginFunction *pFun
 		pEventForward = &pHook->pPostHook;
 	}
 
-	/* Remove function from forward's list */
+	/* Remove function from forward's list, otherwise it may have been hooked with a filter */
 	if (*pEventForward == NULL || !(*pEventForward)->RemoveFunction(pFunction))
 	{
-		return EventHookErr_InvalidCallback;
+		return UnhookFilteredEvent(pHook, pFunction, mode);
 	}
 
 	/* If forward's list contains 0 functions now, free it */
@@ -381,6 +515,122 @@ void EventManager::CancelCreatedEvent(EventInfo *pInfo)
 	m_FreeEvents.push(pInfo);
 }
 
+EventHookSlot *EventManager::AcquireHookSlot(size_t depth, IGameEvent *pEvent, bool bDontBroadcast)
+{
+	/* Handles are created once per stack depth and then reused, rather than
+	 * going through CreateHandle/FreeHandle for every hooked event.
+	 */
+	while (m_HookSlots.size() <= depth)
+	{
+		EventHookSlot *pSlot = new EventHookSlot();
+		pSlot->info.pEvent = NULL;
+		pSlot->info.pOwner = NULL;
+		pSlot->info.bDontBroadcast = false;
+		pSlot->hndl = handlesys->CreateHandle(m_EventType, &pSlot->info, NULL, g_pCoreIdent, NULL);
+		m_HookSlots.push_back(pSlot);
+	}
+
+	EventHookSlot *pSlot = m_HookSlots[depth];
+	pSlot->info.pEvent = pEvent;
+	pSlot->info.bDontBroadcast = bDontBroadcast;
+
+	return pSlot;
+}
+
+void EventManager::FireFilteredCallbacks(FilteredEventList &list, EventHookSlot *pSlot, const char *name, cell_t *result)
+{
+	for (FilteredEventList::iterator iter(list); !iter.done(); iter.next())
+	{
+		FilteredEventCallback *pCallback = (*iter);
+		IPluginFunction *pFunction = pCallback->pFunction;
+
+		if (pFunction->GetParentRuntime()->IsPaused())
+			continue;
+
+		/* Never hand a cleared slot to a filter or a callback */
+		if (!pSlot->info.pEvent)
+			break;
+
+		if (!pCallback->filter.Matches(pSlot->info.pEvent))
+			continue;
+
+		/* The callback may unhook itself, so don't touch pCallback after this */
+		cell_t res = Pl_Continue;
+		pFunction->PushCell(pSlot->hndl);
+		pFunction->PushString(name);
+		pFunction->PushCell(pSlot->info.bDontBroadcast);
+		pFunction->Execute(&res);
+
+		if (result && res > *result)
+		{
+			*result = res;
+		}
+	}
+}
+
+bool EventFilter::Matches(IGameEvent *pEvent) const
+{
+	for (size_t i = 0; i < rules.size(); i++)
+	{
+		const EventFilterRule &rule = rules[i];
+
+		switch (rule.type)
+		{
+		case EventFilter_IntRange:
+			{
+				int value = pEvent->GetInt(rule.field.c_str());
+				if (value < rule.min || value > rule.max)
+					return false;
+				break;
+			}
+		case EventFilter_IntSet:
+			{
+				cell_t value = pEvent->GetInt(rule.field.c_str());
+				if (std::find(rule.values.begin(), rule.values.end(), value) == rule.values.end())
+					return false;
+				break;
+			}
+		case EventFilter_FloatRange:
+			{
+				float value = pEvent->GetFloat(rule.field.c_str());
+				if (value < rule.fmin || value > rule.fmax)
+					return false;
+				break;
+			}
+		case EventFilter_String:
+			{
+				const char *value = pEvent->GetString(rule.field.c_str(), "");
+				int cmp = rule.flag ? strcmp(value, rule.str.c_str()) : strcasecmp(value, rule.str.c_str());
+				if (cmp != 0)
+					return false;
+				break;
+			}
+		case EventFilter_ClientTeam:
+		case EventFilter_ClientBot:
+			{
+				int client = g_Players.GetClientOfUserId(pEvent->GetInt(rule.field.c_str()));
+				CPlayer *pPlayer = g_Players.GetPlayerByIndex(client);
+				if (!pPlayer || !pPlayer->IsInGame())
+					return false;
+
+				if (rule.type == EventFilter_ClientBot)
+				{
+					if (pPlayer->IsFakeClient() != rule.flag)
+						return false;
+					break;
+				}
+
+				IPlayerInfo *pInfo = pPlayer->GetPlayerInfo();
+				if (!pInfo || pInfo->GetTeamIndex() != rule.min)
+					return false;
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
 /* IGameEventManager2::FireEvent hook */
 bool EventManager::OnFireEvent(IGameEvent *pEvent, bool bDontBroadcast)
 {
@@ -406,32 +656,43 @@ bool EventManager::OnFireEvent(IGameEvent *pEvent, bool bDontBroadcast)
 		pHook->refCount++;
 		m_EventStack.push(pHook);
 
+		size_t depth = m_EventDepth++;
+
 		pForward = pHook->pPreHook;
 
-		if (pForward)
+		if (pForward || !pHook->filteredPre.empty())
 		{
-			EventInfo info(pEvent, NULL);
-			HandleSecurity sec(NULL, g_pCoreIdent);
-			Handle_t hndl = handlesys->CreateHandle(m_EventType, &info, NULL, g_pCoreIdent, NULL);
+			EventHookSlot *pSlot = AcquireHookSlot(depth, pEvent, bDontBroadcast);
 
-			info.bDontBroadcast = bDontBroadcast;
+			if (pForward)
+			{
+				EventForwardFilter filter(&pSlot->info);
 
-			EventForwardFilter filter(&info);
+				pForward->PushCell(pSlot->hndl);
+				pForward->PushString(name);
+				pForward->PushCell(bDontBroadcast);
+				pForward->Execute(&res, &filter);
+			}
 
-			pForward->PushCell(hndl);
-			pForward->PushString(name);
-			pForward->PushCell(bDontBroadcast);
-			pForward->Execute(&res, &filter);
+			FireFilteredCallbacks(pHook->filteredPre, pSlot, name, &res);
 
-			broadcast = info.bDontBroadcast;
+			broadcast = pSlot->info.bDontBroadcast;
 
-			handlesys->FreeHandle(hndl, &sec);
+			/* Stale copies of the handle must not reach the event anymore */
+			pSlot->info.pEvent = NULL;
 		}
 
-		if (pHook->postCopy)
+		/* The engine frees the event before the post hook runs, so a copy is
+		 * only worth making if someone is still listening for it.
+		 */
+		if (pHook->postCopy && (pHook->pPostHook || !pHook->filteredPost.empty()))
 		{
 			m_EventCopies.push(gameevents->DuplicateEvent(pEvent));
 		}
+		else
+		{
+			m_EventCopies.push(NULL);
+		}
 
 		if (res >= Pl_Handled)
 		{
@@ -442,6 +703,7 @@ bool EventManager::OnFireEvent(IGameEvent *pEvent, bool bDontBroadcast)
 	else
 	{
 		m_EventStack.push(NULL);
+		m_EventDepth++;
 	}
 
 	if (broadcast != bDontBroadcast)
@@ -454,9 +716,7 @@ bool EventManager::OnFireEvent(IGameEvent *pEvent, bool bDontBroadcast)
 bool EventManager::OnFireEvent_Post(IGameEvent *pEvent, bool bDontBroadcast)
 {
 	EventHook *pHook;
-	EventInfo info;
 	IChangeableForward *pForward;
-	Handle_t hndl = 0;
 
 	/* The engine accepts NULL without crashing, so to prevent a crash in SM we ignore these */
 	if (!pEvent)
@@ -466,38 +726,43 @@ bool EventManager::OnFireEvent_Post(IGameEvent *pEvent, bool bDontBroadcast)
 
 	pHook = m_EventStack.front();
 
+	/* The depth is only released after the callbacks below have run, so that
+	 * an event fired from inside a post hook gets a slot of its own.
+	 */
+	size_t depth = m_EventDepth - 1;
+
 	if (pHook != NULL)
 	{
+		IGameEvent *pCopy = m_EventCopies.front();
+		m_EventCopies.pop();
+
 		pForward = pHook->pPostHook;
 
-		if (pForward)
+		EventHookSlot *pSlot = NULL;
+		if (pCopy)
 		{
-			if (pHook->postCopy)
-			{
-				info.bDontBroadcast = bDontBroadcast;
-				info.pEvent = m_EventCopies.front();
-				info.pOwner = NULL;
-				hndl = handlesys->CreateHandle(m_EventType, &info, NULL, g_pCoreIdent, NULL);
-
-				pForward->PushCell(hndl);
-			} else {
-				pForward->PushCell(BAD_HANDLE);
-			}
+			pSlot = AcquireHookSlot(depth, pCopy, bDontBroadcast);
+		}
 
+		if (pForward)
+		{
+			pForward->PushCell(pSlot ? pSlot->hndl : BAD_HANDLE);
 			pForward->PushString(pHook->name.c_str());
 			pForward->PushCell(bDontBroadcast);
 			pForward->Execute(NULL);
+		}
 
-			if (pHook->postCopy)
-			{
-				/* Free handle */
-				HandleSecurity sec(NULL, g_pCoreIdent);
-				handlesys->FreeHandle(hndl, &sec);
+		/* Filtered callbacks can't run without the event data */
+		if (pSlot)
+		{
+			FireFilteredCallbacks(pHook->filteredPost, pSlot, pHook->name.c_str(), NULL);
+			pSlot->info.pEvent = NULL;
+		}
 
-				/* Free event structure */
-				gameevents->FreeEvent(info.pEvent);
-				m_EventCopies.pop();
-			}
+		if (pCopy)
+		{
+			/* Free event structure */
+			gameevents->FreeEvent(pCopy);
 		}
 
 		/* Decrement reference count, check if a delayed delete is needed */
@@ -511,6 +776,7 @@ bool EventManager::OnFireEvent_Post(IGameEvent *pEvent, bool bDontBroadcast)
 	}
 
 	m_EventStack.pop();
+	m_EventDepth--;
 
 	RETURN_META_VALUE(MRES_IGNORED, true);
 }
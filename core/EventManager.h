@@ -37,6 +37,8 @@
 #include <sm_namehashset.h>
 #include <sh_list.h>
 #include <sh_stack.h>
+#include <vector>
+#include <ReentrantList.h>
 #include <IHandleSys.h>
 #include <IForwardSys.h>
 #include <IPluginSys.h>
@@ -58,6 +60,63 @@ struct EventInfo
 	bool bDontBroadcast;
 };
 
+/* Pre-allocated handle used to pass hooked events to plugins.
+ * One of these exists per event stack depth so nested events don't clash.
+ */
+struct EventHookSlot
+{
+	EventHookSlot() : hndl(BAD_HANDLE)
+	{
+	}
+	EventInfo info;
+	Handle_t hndl;
+};
+
+enum EventFilterType
+{
+	EventFilter_IntRange,		/**< Integer field within [min, max] */
+	EventFilter_IntSet,			/**< Integer field equal to one of a set of values */
+	EventFilter_FloatRange,		/**< Float field within [min, max] */
+	EventFilter_String,			/**< String field equal to a value */
+	EventFilter_ClientTeam,		/**< Userid field refers to an in-game client on a team */
+	EventFilter_ClientBot,		/**< Userid field refers to an in-game client that is (not) a bot */
+};
+
+struct EventFilterRule
+{
+	EventFilterType type;
+	std::string field;
+	cell_t min;
+	cell_t max;
+	float fmin;
+	float fmax;
+	std::vector<cell_t> values;
+	std::string str;
+	bool flag;
+};
+
+/* Declarative predicate evaluated on a game event before entering SourcePawn.
+ * All rules must match for the callback to be invoked.
+ */
+struct EventFilter
+{
+	bool Matches(IGameEvent *pEvent) const;
+
+	std::vector<EventFilterRule> rules;
+};
+
+struct FilteredEventCallback
+{
+	FilteredEventCallback(IPluginFunction *pFunction, const EventFilter &filter)
+	 : pFunction(pFunction), filter(filter)
+	{
+	}
+	IPluginFunction *pFunction;
+	EventFilter filter;
+};
+
+typedef ReentrantList<FilteredEventCallback *> FilteredEventList;
+
 struct EventHook
 {
 	EventHook()
@@ -67,8 +126,17 @@ struct EventHook
 		postCopy = false;
 		refCount = 0;
 	}
+	~EventHook()
+	{
+		for (FilteredEventList::iterator iter(filteredPre); !iter.done(); iter.next())
+			delete (*iter);
+		for (FilteredEventList::iterator iter(filteredPost); !iter.done(); iter.next())
+			delete (*iter);
+	}
 	IChangeableForward *pPreHook;
 	IChangeableForward *pPostHook;
+	FilteredEventList filteredPre;
+	FilteredEventList filteredPost;
 	bool postCopy;
 	unsigned int refCount;
 	std::string name;
@@ -127,8 +195,17 @@ public:
 	{
 		return m_EventType;
 	}
+
+	/**
+	 * Get the 'GameEventFilter' handle type ID.
+	 */
+	inline HandleType_t GetFilterHandleType()
+	{
+		return m_FilterType;
+	}
 public:
 	EventHookError HookEvent(const char *name, IPluginFunction *pFunction, EventHookMode mode=EventHookMode_Post);
+	EventHookError HookFilteredEvent(const char *name, IPluginFunction *pFunction, const EventFilter &filter, EventHookMode mode=EventHookMode_Post);
 	EventHookError UnhookEvent(const char *name, IPluginFunction *pFunction, EventHookMode mode=EventHookMode_Post);
 	EventInfo *CreateEvent(IPluginContext *pContext, const char *name, bool force=false);
 	void FireEvent(EventInfo *pInfo, bool bDontBroadcast=false);
@@ -137,12 +214,19 @@ public:
 private: // IGameEventManager2 hooks
 	bool OnFireEvent(IGameEvent *pEvent, bool bDontBroadcast);
 	bool OnFireEvent_Post(IGameEvent *pEvent, bool bDontBroadcast);
+	EventHookSlot *AcquireHookSlot(size_t depth, IGameEvent *pEvent, bool bDontBroadcast);
+	void FireFilteredCallbacks(FilteredEventList &list, EventHookSlot *pSlot, const char *name, cell_t *result);
+	EventHookError UnhookFilteredEvent(EventHook *pHook, IPluginFunction *pFunction, EventHookMode mode);
+	void RemoveFilteredCallbacks(EventHook *pHook, IPluginContext *pContext);
 private:
 	HandleType_t m_EventType;
+	HandleType_t m_FilterType;
 	NameHashSet<EventHook *> m_EventHooks;
 	CStack<EventInfo *> m_FreeEvents;
 	CStack<EventHook *> m_EventStack;
 	CStack<IGameEvent *> m_EventCopies;
+	std::vector<EventHookSlot *> m_HookSlots;
+	size_t m_EventDepth;
 };
 
 extern EventManager g_EventManager;
@@ -0,0 +1,452 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod
+ * Copyright (C) 2004-2026 AlliedModders LLC.  All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.  AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>.
+ *
+ * Version: $Id$
+ */
+
+
+#include "KeyValuesBinary.h"
+#include <KeyValues.h>
+#include <stdio.h>
+#include <string.h>
+#include <string_view>
+#include <unordered_map>
+
+static const char kMagic[4] = {'S', 'M', 'K', 'V'};
+static const uint8_t kVersion = 1;
+
+// Nesting limit while decoding, so a corrupt file can't exhaust the stack.
+// Capturing enforces the same limit, so every file written can be read.
+static const unsigned int kMaxDepth = 512;
+
+enum KVBinTag : uint8_t
+{
+	KVBin_Section = 0,
+	KVBin_String,
+	KVBin_Int,
+	KVBin_Float,
+	KVBin_Color,
+	KVBin_UInt64,
+};
+
+uint32_t KeyValuesSnapshot::AddString(const char *str)
+{
+	size_t length = str ? strlen(str) : 0;
+	m_Strings.emplace_back(static_cast<uint32_t>(m_Arena.size()), static_cast<uint32_t>(length));
+	m_Arena.append(str ? str : "", length);
+	return static_cast<uint32_t>(m_Strings.size() - 1);
+}
+
+bool KeyValuesSnapshot::Capture(KeyValues *root)
+{
+	m_Arena.clear();
+	m_Strings.clear();
+	m_Nodes.clear();
+	return CaptureR(root, 0);
+}
+
+bool KeyValuesSnapshot::CaptureR(KeyValues *kv, unsigned int depth)
+{
+	if (depth > kMaxDepth)
+		return false;
+
+	Node node;
+	node.name = AddString(kv->GetName());
+	node.value = 0;
+
+	if (KeyValues *sub = kv->GetFirstSubKey())
+	{
+		size_t index = m_Nodes.size();
+		node.tag = KVBin_Section;
+		m_Nodes.push_back(node);
+
+		uint64_t children = 0;
+		for (; sub != NULL; sub = sub->GetNextKey())
+		{
+			if (sub->GetDataType() == KeyValues::TYPE_PTR)
+				continue;
+			if (!CaptureR(sub, depth + 1))
+				return false;
+			children++;
+		}
+		m_Nodes[index].value = children;
+		return true;
+	}
+
+	switch (kv->GetDataType())
+	{
+		case KeyValues::TYPE_STRING:
+		case KeyValues::TYPE_WSTRING:
+			node.tag = KVBin_String;
+			node.value = AddString(kv->GetString());
+			break;
+		case KeyValues::TYPE_INT:
+			node.tag = KVBin_Int;
+			node.value = static_cast<uint32_t>(kv->GetInt());
+			break;
+		case KeyValues::TYPE_FLOAT:
+		{
+			float f = kv->GetFloat();
+			uint32_t bits;
+			memcpy(&bits, &f, sizeof(bits));
+			node.tag = KVBin_Float;
+			node.value = bits;
+			break;
+		}
+		case KeyValues::TYPE_COLOR:
+		{
+			Color color = kv->GetColor();
+			node.tag = KVBin_Color;
+			node.value = static_cast<uint32_t>(color.r()) | (static_cast<uint32_t>(color.g()) << 8) |
+				(static_cast<uint32_t>(color.b()) << 16) | (static_cast<uint32_t>(color.a()) << 24);
+			break;
+		}
+		case KeyValues::TYPE_UINT64:
+			node.tag = KVBin_UInt64;
+			node.value = kv->GetUint64();
+			break;
+		default:
+			node.tag = KVBin_Section;
+			break;
+	}
+	m_Nodes.push_back(node);
+	return true;
+}
+
+static void PutVarint(std::vector<uint8_t> &out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+static void PutFixed(std::vector<uint8_t> &out, uint64_t value, size_t bytes)
+{
+	for (size_t i = 0; i < bytes; i++)
+		out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+}
+
+void KeyValuesSnapshot::Encode(std::vector<uint8_t> &out) const
+{
+	// Map captured strings onto a deduplicated table, in first-use order.
+	std::unordered_map<std::string_view, uint32_t> lookup;
+	std::vector<uint32_t> remap(m_Strings.size());
+	std::vector<std::string_view> table;
+	lookup.reserve(m_Strings.size());
+	for (size_t i = 0; i < m_Strings.size(); i++)
+	{
+		std::string_view str(m_Arena.data() + m_Strings[i].first, m_Strings[i].second);
+		auto result = lookup.emplace(str, static_cast<uint32_t>(table.size()));
+		if (result.second)
+			table.push_back(str);
+		remap[i] = result.first->second;
+	}
+
+	out.clear();
+	out.reserve(8 + m_Arena.size() + m_Nodes.size() * 4);
+	out.insert(out.end(), kMagic, kMagic + sizeof(kMagic));
+	out.push_back(kVersion);
+	PutVarint(out, table.size());
+	for (const std::string_view &str : table)
+	{
+		PutVarint(out, str.size());
+		out.insert(out.end(), str.begin(), str.end());
+	}
+
+	for (const Node &node : m_Nodes)
+	{
+		out.push_back(node.tag);
+		PutVarint(out, remap[node.name]);
+		switch (node.tag)
+		{
+			case KVBin_Section:
+				PutVarint(out, node.value);
+				break;
+			case KVBin_String:
+				PutVarint(out, remap[node.value]);
+				break;
+			case KVBin_Int:
+			case KVBin_Float:
+			case KVBin_Color:
+				PutFixed(out, node.value, 4);
+				break;
+			case KVBin_UInt64:
+				PutFixed(out, node.value, 8);
+				break;
+		}
+	}
+}
+
+class KeyValuesDecoder
+{
+public:
+	KeyValuesDecoder(const uint8_t *data, size_t length)
+	 : m_Pos(data), m_End(data + length)
+	{
+	}
+
+	bool Decode(KeyValues *kv)
+	{
+		if (Remaining() < sizeof(kMagic) + 1 || memcmp(m_Pos, kMagic, sizeof(kMagic)) != 0)
+			return false;
+		m_Pos += sizeof(kMagic);
+		if (*m_Pos++ != kVersion)
+			return false;
+
+		uint64_t count;
+		if (!GetVarint(&count) || count > Remaining())
+			return false;
+		m_Table.reserve(static_cast<size_t>(count));
+		for (uint64_t i = 0; i < count; i++)
+		{
+			uint64_t length;
+			if (!GetVarint(&length) || length > Remaining())
+				return false;
+			m_Table.emplace_back(reinterpret_cast<const char *>(m_Pos), static_cast<size_t>(length));
+			m_Pos += length;
+		}
+
+		kv->Clear();
+		return DecodeNode(kv, 0) && m_Pos == m_End;
+	}
+
+private:
+	size_t Remaining() const
+	{
+		return static_cast<size_t>(m_End - m_Pos);
+	}
+
+	bool GetVarint(uint64_t *value)
+	{
+		uint64_t result = 0;
+		for (unsigned int shift = 0; shift < 64; shift += 7)
+		{
+			if (m_Pos == m_End)
+				return false;
+			uint8_t byte = *m_Pos++;
+			result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+			{
+				*value = result;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool GetFixed(uint64_t *value, size_t bytes)
+	{
+		if (Remaining() < bytes)
+			return false;
+		uint64_t result = 0;
+		for (size_t i = 0; i < bytes; i++)
+			result |= static_cast<uint64_t>(m_Pos[i]) << (i * 8);
+		m_Pos += bytes;
+		*value = result;
+		return true;
+	}
+
+	const char *GetString()
+	{
+		uint64_t index;
+		if (!GetVarint(&index) || index >= m_Table.size())
+			return NULL;
+		return m_Table[static_cast<size_t>(index)].c_str();
+	}
+
+	// Reads one node, including its name, into kv.
+	bool DecodeNode(KeyValues *kv, unsigned int depth)
+	{
+		if (m_Pos == m_End || depth > kMaxDepth)
+			return false;
+		uint8_t tag = *m_Pos++;
+		const char *name = GetString();
+		if (!name)
+			return false;
+		kv->SetName(name);
+
+		uint64_t value;
+		switch (tag)
+		{
+			case KVBin_Section:
+			{
+				if (!GetVarint(&value) || value > Remaining())
+					return false;
+
+				KeyValues *last = NULL;
+				for (uint64_t i = 0; i < value; i++)
+				{
+					KeyValues *sub = new KeyValues("");
+					// Link siblings directly; AddSubKey walks the whole list
+					// on every call, which is quadratic for wide sections.
+					if (last)
+						last->SetNextKey(sub);
+					else
+						kv->AddSubKey(sub);
+					last = sub;
+					if (!DecodeNode(sub, depth + 1))
+						return false;
+				}
+				return true;
+			}
+			case KVBin_String:
+			{
+				const char *str = GetString();
+				if (!str)
+					return false;
+				kv->SetString(NULL, str);
+				return true;
+			}
+			case KVBin_Int:
+				if (!GetFixed(&value, 4))
+					return false;
+				kv->SetInt(NULL, static_cast<int>(static_cast<uint32_t>(value)));
+				return true;
+			case KVBin_Float:
+			{
+				if (!GetFixed(&value, 4))
+					return false;
+				uint32_t bits = static_cast<uint32_t>(value);
+				float f;
+				memcpy(&f, &bits, sizeof(f));
+				kv->SetFloat(NULL, f);
+				return true;
+			}
+			case KVBin_Color:
+			{
+				if (!GetFixed(&value, 4))
+					return false;
+				Color color(value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, (value >> 24) & 0xff);
+				kv->SetColor(NULL, color);
+				return true;
+			}
+			case KVBin_UInt64:
+				if (!GetFixed(&value, 8))
+					return false;
+				kv->SetUint64(NULL, value);
+				return true;
+		}
+		return false;
+	}
+
+private:
+	const uint8_t *m_Pos;
+	const uint8_t *m_End;
+	std::vector<std::string> m_Table;
+};
+
+bool KeyValuesBinary::Decode(KeyValues *kv, const uint8_t *data, size_t length)
+{
+	KeyValuesDecoder decoder(data, length);
+	return decoder.Decode(kv);
+}
+
+bool KeyValuesBinary::ReadFile(const char *path, std::vector<uint8_t> &out)
+{
+	FILE *fp = fopen(path, "rb");
+	if (!fp)
+		return false;
+
+	bool success = fseek(fp, 0, SEEK_END) == 0;
+	long size = success ? ftell(fp) : -1;
+	if (size < 0 || fseek(fp, 0, SEEK_SET) != 0)
+	{
+		fclose(fp);
+		return false;
+	}
+
+	out.resize(static_cast<size_t>(size));
+	success = out.empty() || fread(out.data(), 1, out.size(), fp) == out.size();
+	fclose(fp);
+	return success;
+}
+
+bool KeyValuesBinary::WriteFile(const char *path, const std::vector<uint8_t> &data)
+{
+	std::string tmp_path(path);
+	tmp_path.append(".tmp");
+
+	FILE *fp = fopen(tmp_path.c_str(), "wb");
+	if (!fp)
+		return false;
+
+	bool success = data.empty() || fwrite(data.data(), 1, data.size(), fp) == data.size();
+	if (fclose(fp) != 0)
+		success = false;
+
+#ifdef PLATFORM_WINDOWS
+	if (success && !MoveFileExA(tmp_path.c_str(), path, MOVEFILE_REPLACE_EXISTING))
+#else
+	if (success && rename(tmp_path.c_str(), path) != 0)
+#endif
+	{
+		success = false;
+	}
+
+	if (!success)
+		remove(tmp_path.c_str());
+	return success;
+}
+
+KeyValuesSaveTask::KeyValuesSaveTask(std::unique_ptr<KeyValuesSnapshot> snapshot, const char *path,
+	const char *name, IPluginFunction *callback, cell_t data)
+ : m_Snapshot(std::move(snapshot)), m_Path(path), m_Name(name), m_Callback(callback),
+   m_Data(data), m_Success(false)
+{
+}
+
+void KeyValuesSaveTask::Run()
+{
+	std::vector<uint8_t> data;
+	m_Snapshot->Encode(data);
+	m_Snapshot.reset();
+	m_Success = KeyValuesBinary::WriteFile(m_Path.c_str(), data);
+}
+
+void KeyValuesSaveTask::Complete()
+{
+	if (!m_Callback || !m_Callback->IsRunnable())
+		return;
+	m_Callback->PushCell(m_Success ? 1 : 0);
+	m_Callback->PushString(m_Name.c_str());
+	m_Callback->PushCell(m_Data);
+	m_Callback->Execute(NULL);
+}
+
+KeyValuesLoadTask::KeyValuesLoadTask(const char *path)
+ : m_Path(path), m_Success(false)
+{
+}
+
+void KeyValuesLoadTask::Run()
+{
+	m_Success = KeyValuesBinary::ReadFile(m_Path.c_str(), m_Data);
+}
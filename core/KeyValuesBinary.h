@@ -0,0 +1,179 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod
+ * Copyright (C) 2004-2026 AlliedModders LLC.  All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.  AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>.
+ *
+ * Version: $Id$
+ */
+
+
+#ifndef _INCLUDE_SOURCEMOD_KEYVALUES_BINARY_H_
+#define _INCLUDE_SOURCEMOD_KEYVALUES_BINARY_H_
+
+#include "sm_globals.h"
+#include <IPluginSys.h>
+#include <bridge/include/LogicProvider.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+class KeyValues;
+
+/**
+ * Flat copy of a KeyValues tree. Capturing only walks the tree and copies
+ * names and values, so it is cheap enough to do on the main thread; string
+ * deduplication and encoding happen in Encode(), which does not touch the
+ * original tree and can run on any thread.
+ *
+ * Binary layout (little-endian, "u" = LEB128 varint):
+ *
+ *   "SMKV" u8:version
+ *   u:string_count { u:length bytes }...
+ *   node
+ *
+ *   node := u8:tag u:name_index payload
+ *     KVBin_Section  u:child_count node...
+ *     KVBin_String   u:string_index
+ *     KVBin_Int      i32
+ *     KVBin_Float    f32
+ *     KVBin_Color    u8 r, g, b, a
+ *     KVBin_UInt64   u64
+ *
+ * Wide strings are stored as UTF-8 strings and pointer values are dropped.
+ */
+class KeyValuesSnapshot
+{
+public:
+	/**
+	 * Copies a tree. Fails if it is nested deeper than Decode() accepts, so
+	 * that nothing is written which can't be read back.
+	 */
+	bool Capture(KeyValues *root);
+	void Encode(std::vector<uint8_t> &out) const;
+	size_t NodeCount() const
+	{
+		return m_Nodes.size();
+	}
+
+private:
+	struct Node
+	{
+		uint8_t tag;
+		uint32_t name;
+		uint64_t value;		// child count, string index or raw value bits
+	};
+
+	uint32_t AddString(const char *str);
+	bool CaptureR(KeyValues *kv, unsigned int depth);
+
+private:
+	std::string m_Arena;
+	std::vector<std::pair<uint32_t, uint32_t>> m_Strings;
+	std::vector<Node> m_Nodes;
+};
+
+namespace KeyValuesBinary
+{
+	/**
+	 * Replaces the contents of a KeyValues node with a decoded binary tree.
+	 *
+	 * @param kv		Node to load into. Its name is replaced by the stored root name.
+	 * @param data		Encoded bytes.
+	 * @param length	Number of encoded bytes.
+	 * @return			False if the data is truncated or malformed. The node
+	 *					may be partially filled in that case.
+	 */
+	bool Decode(KeyValues *kv, const uint8_t *data, size_t length);
+
+	bool ReadFile(const char *path, std::vector<uint8_t> &out);
+
+	/**
+	 * Writes to a temporary file next to the target and renames it into
+	 * place, so readers never see a partly written file.
+	 */
+	bool WriteFile(const char *path, const std::vector<uint8_t> &data);
+}
+
+/**
+ * Encodes and writes a snapshot. Queued on logic's async file workers, so
+ * it is ordered against every other file operation on the same path; the
+ * completion callback runs on a later game frame and is dropped if the
+ * plugin unloads first. Writes still queued at shutdown are flushed.
+ */
+class KeyValuesSaveTask : public IFileTask
+{
+public:
+	KeyValuesSaveTask(std::unique_ptr<KeyValuesSnapshot> snapshot, const char *path,
+		const char *name, IPluginFunction *callback, cell_t data);
+
+	void Run() override;
+	void Complete() override;
+
+	bool success() const
+	{
+		return m_Success;
+	}
+
+private:
+	std::unique_ptr<KeyValuesSnapshot> m_Snapshot;
+	std::string m_Path;
+	std::string m_Name;
+	IPluginFunction *m_Callback;
+	cell_t m_Data;
+	bool m_Success;
+};
+
+/**
+ * Reads a file, in order with async saves to the same path.
+ */
+class KeyValuesLoadTask : public IFileTask
+{
+public:
+	explicit KeyValuesLoadTask(const char *path);
+
+	void Run() override;
+	void Complete() override
+	{
+	}
+
+	bool success() const
+	{
+		return m_Success;
+	}
+	const std::vector<uint8_t> &data() const
+	{
+		return m_Data;
+	}
+
+private:
+	std::string m_Path;
+	std::vector<uint8_t> m_Data;
+	bool m_Success;
+};
+
+#endif //_INCLUDE_SOURCEMOD_KEYVALUES_BINARY_H_
@@ -54,6 +54,7 @@
 #include <bridge/include/IExtensionBridge.h>
 #include <bridge/include/IScriptManager.h>
 #include <bridge/include/ILogger.h>
+#include <algorithm>
 
 PlayerManager g_Players;
 bool g_OnMapStarted = false;
@@ -68,6 +69,7 @@ int lifestate_offset = -1;
 List<ICommandTargetProcessor *> target_processors;
 
 ConVar sm_debug_connect("sm_debug_connect", "1", 0, "Log Debug information about potential connection issues.");
+ConVar sm_console_print_budget("sm_console_print_budget", "8192", 0, "Maximum bytes of queued console output sent to each client per frame (0 = no limit, values below 4 act as 4).", true, 0, false, 0);
 
 SH_DECL_HOOK5(IServerGameClients, ClientConnect, SH_NOATTRIB, 0, bool, edict_t *, const char *, const char *, char *, int);
 SH_DECL_HOOK2_void(IServerGameClients, ClientPutInServer, SH_NOATTRIB, 0, edict_t *, const char *);
@@ -148,6 +150,9 @@ PlayerManager::PlayerManager()
 	m_bInCCKVHook = false;
 	m_bAuthstringValidation = true; // use steam auth by default
 
+	m_TargetCacheTick = -1;
+	m_TargetFromProcessor = false;
+
 	m_UserIdLookUp = new int[USHRT_MAX+1];
 	memset(m_UserIdLookUp, 0, sizeof(int) * (USHRT_MAX+1));
 }
@@ -199,6 +204,8 @@ void PlayerManager::OnSourceModAllInitialized()
 
 	sharesys->AddInterface(NULL, this);
 
+	rootmenu->AddRootConsoleCommand3("printqueue", "View queued client console output", this);
+
 	ParamType p1[] = {Param_Cell, Param_String, Param_Cell};
 	ParamType p2[] = {Param_Cell};
 
@@ -257,6 +264,8 @@ void PlayerManager::OnSourceModShutdown()
 #endif
 	SH_REMOVE_HOOK(IVEngineServer, ClientPrintf, engine, SH_MEMBER(this, &PlayerManager::OnClientPrintf), false);
 
+	rootmenu->RemoveRootConsoleCommand("printqueue", this);
+
 	/* Release forwards */
 	forwardsys->ReleaseForward(m_clconnect);
 	forwardsys->ReleaseForward(m_clconnect_post);
@@ -926,14 +935,24 @@ void PlayerManager::OnClientPrintf(edict_t *pEdict, const char *szMsg)
 		RETURN_META(MRES_IGNORED);
 
 	// enqueue msgs if we'd overflow the SVC_Print buffer (+7 as ceil)
-	if (!player.m_PrintfBuffer.empty() || (nNumBitsWritten + NETMSG_TYPE_BITS + 7) / 8 + nMsgLen >= SVC_Print_BufferSize)
+	if (!player.m_PrintfBuffer.Empty() || (nNumBitsWritten + NETMSG_TYPE_BITS + 7) / 8 + nMsgLen >= SVC_Print_BufferSize)
 	{
 		// Don't send any more messages for this player until the buffer is empty.
 		// Queue up a gameframe hook to empty the buffer (if we haven't already)
-		if (player.m_PrintfBuffer.empty())
+		if (player.m_PrintfBuffer.Empty())
 			g_SourceMod.AddFrameAction(PrintfBuffer_FrameAction, (void *)(uintptr_t)player.GetSerial());
 
-		player.m_PrintfBuffer.push_back(szMsg);
+		if (player.m_PrintfBuffer.Push(szMsg, nMsgLen))
+		{
+			player.m_PrintfStats.bytesQueued += nMsgLen;
+			if (player.m_PrintfBuffer.Size() > player.m_PrintfStats.peak)
+				player.m_PrintfStats.peak = player.m_PrintfBuffer.Size();
+		}
+		else
+		{
+			// The client can't keep up with its output, drop it rather than grow forever
+			player.m_PrintfStats.bytesDropped += nMsgLen;
+		}
 
 		RETURN_META(MRES_SUPERCEDE);
 	}
@@ -958,7 +977,14 @@ void PlayerManager::OnPrintfFrameAction(unsigned int serial)
 		return;
 	}
 
-	while (!player.m_PrintfBuffer.empty())
+	char buffer[SVC_Print_BufferSize + 1];
+	size_t budget = (sm_console_print_budget.GetInt() > 0) ? sm_console_print_budget.GetInt() : SIZE_MAX;
+
+	// Peek never splits a UTF-8 character, so a budget smaller than the
+	// longest one could leave the queue stuck forever.
+	budget = std::max(budget, (size_t)4);
+
+	while (!player.m_PrintfBuffer.Empty() && budget > 0)
 	{
 #if SOURCE_ENGINE == SE_EPISODEONE || SOURCE_ENGINE == SE_DARKMESSIAH
 		static const int nNumBitsWritten = 0;
@@ -966,24 +992,56 @@ void PlayerManager::OnPrintfFrameAction(unsigned int serial)
 		int nNumBitsWritten = pNetChan->GetNumBitsWritten(false); // SVC_Print uses unreliable netchan
 #endif
 
-		std::string &string = player.m_PrintfBuffer.front();
-
 		// stop if we'd overflow the SVC_Print buffer  (+7 as ceil)
-		if ((nNumBitsWritten + NETMSG_TYPE_BITS + 7) / 8 + string.length() >= SVC_Print_BufferSize)
+		size_t used = (nNumBitsWritten + NETMSG_TYPE_BITS + 7) / 8;
+		if (used + 1 >= SVC_Print_BufferSize)
 			break;
 
-		SH_CALL(engine, &IVEngineServer::ClientPrintf)(player.m_pEdict, string.c_str());
+		// pack as many queued lines as fit into one SVC_Print
+		size_t len = player.m_PrintfBuffer.Peek(buffer, std::min(SVC_Print_BufferSize - used - 1, budget));
+		if (!len)
+			break;
+		buffer[len] = '\0';
+
+		SH_CALL(engine, &IVEngineServer::ClientPrintf)(player.m_pEdict, buffer);
 
-		player.m_PrintfBuffer.pop_front();
+		player.m_PrintfBuffer.Consume(len);
+		player.m_PrintfStats.bytesSent += len;
+		player.m_PrintfStats.packets++;
+		budget -= len;
 	}
 
-	if (!player.m_PrintfBuffer.empty())
+	if (!player.m_PrintfBuffer.Empty())
 	{
 		// continue processing it on the next gameframe as buffer is not empty
 		g_SourceMod.AddFrameAction(PrintfBuffer_FrameAction, (void *)(uintptr_t)player.GetSerial());
 	}
 }
 
+void PlayerManager::OnRootConsoleCommand(const char *cmdname, const ICommandArgs *command)
+{
+	UTIL_ConsolePrint("[SM] Queued console output by client:");
+	UTIL_ConsolePrint("  %-4.3s %-24.23s %-9.8s %-9.8s %-11.10s %-11.10s %-9.8s %s", "[#]", "[Name]", "[Queued]", "[Peak]", "[Total]", "[Sent]", "[Prints]", "[Dropped]");
+
+	for (int i = 1; i <= m_maxClients; i++)
+	{
+		CPlayer &player = m_Players[i];
+		if (!player.IsConnected() || player.IsFakeClient())
+			continue;
+
+		const PrintfQueueStats &stats = player.m_PrintfStats;
+		UTIL_ConsolePrint("  %-4d %-24.23s %-9u %-9u %-11llu %-11llu %-9u %llu",
+			i,
+			player.GetName(),
+			(unsigned int)player.m_PrintfBuffer.Size(),
+			(unsigned int)stats.peak,
+			(unsigned long long)stats.bytesQueued,
+			(unsigned long long)stats.bytesSent,
+			stats.packets,
+			(unsigned long long)stats.bytesDropped);
+	}
+}
+
 void ClientConsolePrint(edict_t *e, const char *fmt, ...)
 {
 	char buffer[512];
@@ -1494,6 +1552,9 @@ void PlayerManager::ClearAdminId(AdminId id)
 			m_Players[i].DumpAdmin(true);
 		}
 	}
+
+	/* Immunity may have changed even for admins who kept their id */
+	InvalidateTargetCache();
 }
 
 const char *PlayerManager::GetPassInfoVar()
@@ -1530,11 +1591,13 @@ int PlayerManager::FilterCommandTarget(IGamePlayer *pAdmin, IGamePlayer *pTarget
 void PlayerManager::RegisterCommandTargetProcessor(ICommandTargetProcessor *pHandler)
 {
 	target_processors.push_back(pHandler);
+	InvalidateTargetCache();
 }
 
 void PlayerManager::UnregisterCommandTargetProcessor(ICommandTargetProcessor *pHandler)
 {
 	target_processors.remove(pHandler);
+	InvalidateTargetCache();
 }
 
 void PlayerManager::InvalidatePlayer(CPlayer *pPlayer)
@@ -1610,7 +1673,100 @@ int PlayerManager::InternalFilterCommandTarget(CPlayer *pAdmin, CPlayer *pTarget
 	return COMMAND_TARGET_VALID;
 }
 
+void PlayerManager::InvalidateTargetCache()
+{
+	m_TargetCache.clear();
+}
+
+int PlayerManager::GetTargetState(CPlayer *pPlayer)
+{
+	if (!pPlayer->IsConnected())
+	{
+		return 0;
+	}
+
+	IPlayerInfo *info = pPlayer->GetPlayerInfo();
+	int team = info ? info->GetTeamIndex() : 0;
+
+	return 1 | (pPlayer->IsInGame() << 1) | (pPlayer->GetLifeState() << 2) | (team << 4);
+}
+
 void PlayerManager::ProcessCommandTarget(cmd_target_info_t *info)
+{
+	/* A userid, steam id or exact name resolves faster than a cache hit can be
+	 * checked, so these go straight through.
+	 */
+	if (info->max_targets < 1 || info->pattern[0] == '#')
+	{
+		ResolveCommandTarget(info);
+		return;
+	}
+
+	if (m_TargetCacheTick != gpGlobals->tickcount)
+	{
+		m_TargetCache.clear();
+		m_TargetCacheTick = gpGlobals->tickcount;
+	}
+
+	char params[64];
+	ke::SafeSprintf(params, sizeof(params), "%d:%d:%d:%d:", info->admin, info->flags,
+		info->max_targets, (int)info->target_name_maxlength);
+	std::string key(params);
+	key.append(info->pattern);
+
+	auto iter = m_TargetCache.find(key);
+	if (iter != m_TargetCache.end())
+	{
+		CachedTarget &cached = iter->second;
+		bool stale = false;
+		for (size_t i = 0; i < cached.states.size(); i++)
+		{
+			if (cached.states[i] != GetTargetState(&m_Players[i + 1]))
+			{
+				stale = true;
+				break;
+			}
+		}
+
+		if (!stale && (int)cached.states.size() == m_maxClients)
+		{
+			memcpy(info->targets, cached.targets.data(), sizeof(cell_t) * cached.targets.size());
+			info->num_targets = (int)cached.targets.size();
+			info->flags = cached.flags;
+			info->reason = cached.reason;
+			ke::SafeStrcpy(info->target_name, info->target_name_maxlength, cached.target_name.c_str());
+			info->target_name_style = cached.target_name_style;
+			return;
+		}
+		m_TargetCache.erase(iter);
+	}
+
+	m_TargetFromProcessor = false;
+	ResolveCommandTarget(info);
+
+	/* Failed lookups don't always fill in a target name, so only cache successes.
+	 * Target processors (such as plugin multi-target filters) can run arbitrary
+	 * code, like picking a random player, so their results are never replayed.
+	 */
+	if (info->num_targets < 1 || m_TargetFromProcessor)
+	{
+		return;
+	}
+
+	CachedTarget &cached = m_TargetCache[key];
+	cached.targets.assign(info->targets, info->targets + info->num_targets);
+	cached.flags = info->flags;
+	cached.reason = info->reason;
+	cached.target_name = info->target_name;
+	cached.target_name_style = info->target_name_style;
+	cached.states.resize(m_maxClients);
+	for (int i = 1; i <= m_maxClients; i++)
+	{
+		cached.states[i - 1] = GetTargetState(&m_Players[i]);
+	}
+}
+
+void PlayerManager::ResolveCommandTarget(cmd_target_info_t *info)
 {
 	CPlayer *pTarget, *pAdmin;
 	int max_clients, total = 0;
@@ -1898,11 +2054,18 @@ void PlayerManager::ProcessCommandTarget(cmd_target_info_t *info)
 		ICommandTargetProcessor *pProcessor = (*iter);
 		if (pProcessor->ProcessCommandTarget(info))
 		{
+			m_TargetFromProcessor = true;
 			return;
 		}
 	}
 
-	/* Check partial names */
+	/* Check partial names against the lowercased names kept by each player */
+	std::string lower_pattern(info->pattern);
+	for (size_t i = 0; i < lower_pattern.size(); i++)
+	{
+		lower_pattern[i] = tolower((unsigned char)lower_pattern[i]);
+	}
+
 	int found_client = 0;
 	CPlayer *pFoundClient = NULL;
 	for (int i = 1; i <= max_clients; i++)
@@ -1912,7 +2075,7 @@ void PlayerManager::ProcessCommandTarget(cmd_target_info_t *info)
 			continue;
 		}
 
-		if (logicore.stristr(pTarget->GetName(), info->pattern) != NULL)
+		if (strstr(pTarget->m_LowerName.c_str(), lower_pattern.c_str()) != NULL)
 		{
 			if (found_client)
 			{
@@ -2244,6 +2407,7 @@ void CPlayer::Disconnect()
 	m_IsInGame = false;
 	m_IsAuthorized = false;
 	m_Name.clear();
+	m_LowerName.clear();
 	m_Ip.clear();
 	m_AuthID = "";
 	m_SteamId = k_steamIDNil;
@@ -2263,12 +2427,83 @@ void CPlayer::Disconnect()
 	m_LanguageCookie = InvalidQueryCvarCookie;
 #endif
 	ClearNetchannelQueue();
+
+	g_Players.InvalidateTargetCache();
 }
 
 void CPlayer::ClearNetchannelQueue(void)
 {
-	while (!m_PrintfBuffer.empty())
-		m_PrintfBuffer.pop_front();
+	m_PrintfBuffer.Clear();
+	m_PrintfStats.Reset();
+}
+
+bool PrintfQueue::Grow(size_t needed)
+{
+	if (needed > MaxSize)
+		return false;
+
+	size_t capacity = m_Data.empty() ? InitialSize : m_Data.size();
+	while (capacity < needed)
+		capacity *= 2;
+	if (capacity > MaxSize)
+		capacity = MaxSize;
+
+	// unwrap the ring into the new storage
+	std::vector<char> data(capacity);
+	for (size_t i = 0; i < m_Size; i++)
+		data[i] = At(i);
+
+	m_Data.swap(data);
+	m_Head = 0;
+	return true;
+}
+
+bool PrintfQueue::Push(const char *msg, size_t len)
+{
+	if (m_Size + len > m_Data.size() && !Grow(m_Size + len))
+		return false;
+
+	size_t tail = (m_Head + m_Size) % m_Data.size();
+	size_t first = std::min(len, m_Data.size() - tail);
+	memcpy(&m_Data[tail], msg, first);
+	memcpy(&m_Data[0], msg + first, len - first);
+	m_Size += len;
+	return true;
+}
+
+size_t PrintfQueue::Peek(char *buffer, size_t maxlength) const
+{
+	size_t len = std::min(m_Size, maxlength);
+	for (size_t i = 0; i < len; i++)
+		buffer[i] = At(i);
+
+	if (len == m_Size)
+		return len;
+
+	// prefer ending on a line break, otherwise don't split a UTF-8 character
+	for (size_t i = len; i > 0; i--)
+	{
+		if (buffer[i - 1] == '\n')
+			return i;
+	}
+	while (len > 0 && (At(len) & 0xC0) == 0x80)
+		len--;
+	return len;
+}
+
+void PrintfQueue::Consume(size_t len)
+{
+	m_Head = (m_Head + len) % m_Data.size();
+	m_Size -= len;
+	if (!m_Size)
+		m_Head = 0;
+}
+
+void PrintfQueue::Clear()
+{
+	// keep the storage around, the client will likely overflow again
+	m_Head = 0;
+	m_Size = 0;
 }
 
 void CPlayer::SetName(const char *name)
@@ -2297,6 +2532,14 @@ void CPlayer::SetName(const char *name)
 	}
 
 	m_Name.assign(szNewName);
+
+	m_LowerName.assign(szNewName);
+	for (size_t j = 0; j < m_LowerName.size(); j++)
+	{
+		m_LowerName[j] = tolower((unsigned char)m_LowerName[j]);
+	}
+
+	g_Players.InvalidateTargetCache();
 }
 
 const char *CPlayer::GetName()
@@ -2440,6 +2683,8 @@ void CPlayer::SetAdminId(AdminId id, bool temporary)
 
 	m_Admin = id;
 	m_TempAdmin = temporary;
+
+	g_Players.InvalidateTargetCache();
 }
 
 AdminId CPlayer::GetAdminId()
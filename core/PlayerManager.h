@@ -44,6 +44,10 @@
 #include <sh_vector.h>
 #include <am-string.h>
 #include <am-deque.h>
+#include <IRootConsoleMenu.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "ConVarManager.h"
 
 #include <steam/steamclientpublic.h>
@@ -68,6 +72,64 @@ union serial_t
 	} bits;
 };
 
+/* Console output held back until a client's netchannel has room for it.
+ * Bytes live in one growable ring so queued lines don't each need an
+ * allocation and can be packed into as few SVC_Prints as possible.
+ */
+class PrintfQueue
+{
+public:
+	static const size_t InitialSize = 4096;
+	static const size_t MaxSize = 1024 * 1024; // beyond this, output is dropped
+public:
+	PrintfQueue() : m_Head(0), m_Size(0)
+	{
+	}
+	bool Push(const char *msg, size_t len);
+	size_t Peek(char *buffer, size_t maxlength) const;
+	void Consume(size_t len);
+	void Clear();
+	inline size_t Size() const
+	{
+		return m_Size;
+	}
+	inline bool Empty() const
+	{
+		return m_Size == 0;
+	}
+private:
+	inline char At(size_t i) const
+	{
+		return m_Data[(m_Head + i) % m_Data.size()];
+	}
+	bool Grow(size_t needed);
+private:
+	std::vector<char> m_Data;
+	size_t m_Head;
+	size_t m_Size;
+};
+
+struct PrintfQueueStats
+{
+	PrintfQueueStats()
+	{
+		Reset();
+	}
+	void Reset()
+	{
+		bytesQueued = 0;
+		bytesSent = 0;
+		bytesDropped = 0;
+		packets = 0;
+		peak = 0;
+	}
+	uint64_t bytesQueued;
+	uint64_t bytesSent;
+	uint64_t bytesDropped;
+	unsigned int packets;
+	size_t peak;
+};
+
 class CPlayer : public IGamePlayer
 {
 	friend class PlayerManager;
@@ -132,6 +194,7 @@ private:
 	bool m_IsAuthorized = false;
 	bool m_bIsInKickQueue = false;
 	String m_Name;
+	std::string m_LowerName; // for partial, case insensitive target matching
 	String m_Ip;
 	String m_IpNoPort;
 	std::string m_AuthID;
@@ -156,12 +219,14 @@ private:
 #if SOURCE_ENGINE == SE_CSGO || SOURCE_ENGINE == SE_BLADE || SOURCE_ENGINE == SE_MCV
 	QueryCvarCookie_t m_LanguageCookie = InvalidQueryCvarCookie;
 #endif
-	std::deque<std::string> m_PrintfBuffer;
+	PrintfQueue m_PrintfBuffer;
+	PrintfQueueStats m_PrintfStats;
 };
 
 class PlayerManager : 
 	public SMGlobalClass,
-	public IPlayerManager
+	public IPlayerManager,
+	public IRootConsoleCommand
 {
 	friend class CPlayer;
 public:
@@ -174,6 +239,8 @@ public: //SMGlobalClass
 	void OnSourceModLevelEnd();
 	ConfigResult OnSourceModConfigChanged(const char *key, const char *value, ConfigSource source, char *error, size_t maxlength);
 	void OnSourceModMaxPlayersChanged(int newvalue);
+public: //IRootConsoleCommand
+	void OnRootConsoleCommand(const char *cmdname, const ICommandArgs *command) override;
 public:
 	CPlayer *GetPlayerByIndex(int client) const;
 	void RunAuthChecks();
@@ -241,6 +308,7 @@ public:
 	unsigned int GetReplyTo();
 	unsigned int SetReplyTo(unsigned int reply);
 	void MaxPlayersChanged(int newvalue = -1);
+	void InvalidateTargetCache();
 	inline bool InClientCommandKeyValuesHook()
 	{
 		return m_bInCCKVHook;
@@ -251,6 +319,27 @@ public:
 private:
 	void OnServerActivate(edict_t *pEdictList, int edictCount, int clientMax);
 	void InvalidatePlayer(CPlayer *pPlayer);
+	void ResolveCommandTarget(cmd_target_info_t *info);
+	int GetTargetState(CPlayer *pPlayer);
+private:
+	/**
+	 * Successful target resolutions for the current tick, keyed by pattern, admin
+	 * and filters. The state of every player at the time is kept so entries can be
+	 * thrown out when a team or life state changes within the tick. Patterns
+	 * starting with '#' and anything resolved by a target processor are not kept.
+	 */
+	struct CachedTarget
+	{
+		std::vector<cell_t> targets;
+		int flags;
+		int reason;
+		std::string target_name;
+		int target_name_style;
+		std::vector<int> states;
+	};
+	std::unordered_map<std::string, CachedTarget> m_TargetCache;
+	int m_TargetCacheTick;
+	bool m_TargetFromProcessor;
 private:
 	List<IClientListener *> m_hooks;
 	IForward *m_clconnect;
@@ -32,6 +32,7 @@
 #include "UserMessages.h"
 #include "sm_stringutil.h"
 #include "logic_bridge.h"
+#include "sourcemod.h"
 
 #if SOURCE_ENGINE == SE_CSGO
 #include <cstrike15_usermessage_helpers.h>
@@ -68,6 +69,9 @@ UserMessages::UserMessages()
 	m_InHook = false;
 	m_CurFlags = 0;
 	m_CurId = INVALID_MESSAGE_ID;
+	memset(m_HookedSent, 0, sizeof(m_HookedSent));
+	memset(m_PassedSent, 0, sizeof(m_PassedSent));
+	memset(m_DispatchDepth, 0, sizeof(m_DispatchDepth));
 }
 
 UserMessages::~UserMessages()
@@ -91,6 +95,8 @@ void UserMessages::OnSourceModStartup(bool late)
 void UserMessages::OnSourceModAllInitialized()
 {
 	sharesys->AddInterface(NULL, this);
+
+	rootmenu->AddRootConsoleCommand3("usermsgs", "View user message hook statistics", this);
 }
 
 void UserMessages::OnSourceModAllShutdown()
@@ -108,6 +114,46 @@ void UserMessages::OnSourceModAllShutdown()
 #endif
 	}
 	m_HookCount = 0;
+
+	rootmenu->RemoveRootConsoleCommand("usermsgs", this);
+}
+
+void UserMessages::OnRootConsoleCommand(const char *cmdname, const ICommandArgs *command)
+{
+	if (command->ArgC() >= 3 && strcmp(command->Arg(2), "reset") == 0)
+	{
+		memset(m_HookedSent, 0, sizeof(m_HookedSent));
+		memset(m_PassedSent, 0, sizeof(m_PassedSent));
+		UTIL_ConsolePrint("[SM] User message statistics have been reset.");
+		return;
+	}
+
+	UTIL_ConsolePrint("[SM] User messages sent while hooks were active:");
+	UTIL_ConsolePrint("  %-4.3s %-32.31s %-6.5s %-6.5s %-10.9s %s", "[Id]", "[Name]", "[Hks]", "[Ints]", "[Hooked]", "[Passed]");
+
+	for (int i = 0; i < MAX_USERMESSAGES; i++)
+	{
+		if (!m_HookedSent[i] && !m_PassedSent[i] && m_msgHooks[i].empty() && m_msgIntercepts[i].empty())
+		{
+			continue;
+		}
+
+		char name[64];
+		if (!GetMessageName(i, name, sizeof(name)))
+		{
+			ke::SafeStrcpy(name, sizeof(name), "<unknown>");
+		}
+
+		UTIL_ConsolePrint("  %-4d %-32.31s %-6u %-6u %-10u %u",
+			i,
+			name,
+			(unsigned int)m_msgHooks[i].size(),
+			(unsigned int)m_msgIntercepts[i].size(),
+			m_HookedSent[i],
+			m_PassedSent[i]);
+	}
+
+	UTIL_ConsolePrint("  Use \"sm usermsgs reset\" to clear the counters.");
 }
 
 int UserMessages::GetMessageIndex(const char *msg)
@@ -196,7 +242,7 @@ bf_write *UserMessages::StartBitBufMessage(int msg_id, const cell_t players[], u
 	{
 		return NULL;
 	}
-	if (msg_id < 0 || msg_id >= 255)
+	if (msg_id < 0 || msg_id >= MAX_USERMESSAGES)
 	{
 		return NULL;
 	}
@@ -245,7 +291,7 @@ google::protobuf::Message *UserMessages::StartProtobufMessage(int msg_id, const
 	{
 		return NULL;
 	}
-	if (msg_id < 0 || msg_id >= 255)
+	if (msg_id < 0 || msg_id >= MAX_USERMESSAGES)
 	{
 		return NULL;
 	}
@@ -403,7 +449,7 @@ bool UserMessages::InternalHook(int msg_id, IProtobufUserMessageListener *pListe
 bool UserMessages::InternalHook(int msg_id, IBitBufUserMessageListener *pListener, bool intercept, bool isNew)
 #endif
 {
-	if (msg_id < 0 || msg_id >= 255)
+	if (msg_id < 0 || msg_id >= MAX_USERMESSAGES)
 	{
 		return false;
 	}
@@ -442,9 +488,24 @@ bool UserMessages::InternalHook(int msg_id, IBitBufUserMessageListener *pListene
 		m_msgHooks[msg_id].push_back(pInfo);
 	}
 
+	m_HookedIds.set(msg_id);
+
 	return true;
 }
 
+void UserMessages::UpdateHookedState(int msg_id)
+{
+	m_HookedIds.set(msg_id, !m_msgHooks[msg_id].empty() || !m_msgIntercepts[msg_id].empty());
+}
+
+void UserMessages::FreeListener(int msg_id, MsgList *pList, size_t index)
+{
+	m_FreeListeners.push(pList->at(index));
+	pList->erase(pList->begin() + index);
+	UpdateHookedState(msg_id);
+	_DecRefCounter();
+}
+
 #ifdef USE_PROTOBUF_USERMESSAGES
 const protobuf::Message *UserMessages::GetMessagePrototype(int msg_type)
 {
@@ -465,38 +526,33 @@ bool UserMessages::InternalUnhook(int msg_id, IBitBufUserMessageListener *pListe
 #endif
 {
 	MsgList *pList;
-	MsgIter iter;
 	ListenerInfo *pInfo;
-	bool deleted = false;
 
-	if (msg_id < 0 || msg_id >= 255)
+	if (msg_id < 0 || msg_id >= MAX_USERMESSAGES)
 	{
 		return false;
 	}
 
 	pList = (intercept) ? &m_msgIntercepts[msg_id] : &m_msgHooks[msg_id];
-	for (iter=pList->begin(); iter!=pList->end(); iter++)
+	for (size_t i = 0; i < pList->size(); i++)
 	{
-		pInfo = (*iter);
-		if (pInfo->Callback == pListener && pInfo->IsNew == isNew)
+		pInfo = pList->at(i);
+		if (pInfo->Callback == pListener && pInfo->IsNew == isNew && !pInfo->KillMe)
 		{
-			if (pInfo->IsHooked)
+			/* Erasing would shift the listeners of a message being dispatched,
+			 * so the dispatch loops free it when they reach it instead.
+			 */
+			if (pInfo->IsHooked || m_DispatchDepth[msg_id])
 			{
 				pInfo->KillMe = true;
 				return true;
 			}
-			pList->erase(iter);
-			deleted = true;
-			break;
+			FreeListener(msg_id, pList, i);
+			return true;
 		}
 	}
 
-	if (deleted)
-	{
-		_DecRefCounter();
-	}
-
-	return deleted;
+	return false;
 }
 
 void UserMessages::_DecRefCounter()
@@ -518,6 +574,18 @@ void UserMessages::_DecRefCounter()
 #if SOURCE_ENGINE == SE_CSGO || SOURCE_ENGINE == SE_BLADE || SOURCE_ENGINE == SE_MCV
 void UserMessages::OnSendUserMessage_Pre(IRecipientFilter &filter, int msg_type, const protobuf::Message &msg)
 {
+	if (!IsMessageHooked(msg_type))
+	{
+		/* Nobody listens to this message, skip the name lookup and buffer tracking */
+		if (msg_type >= 0 && msg_type < MAX_USERMESSAGES)
+		{
+			m_PassedSent[msg_type]++;
+		}
+		m_InHook = false;
+		m_FakeMetaRes = MRES_IGNORED;
+		RETURN_META(MRES_IGNORED);
+	}
+
 #if SOURCE_ENGINE == SE_CSGO
 	const char *pszName = g_Cstrike15UsermessageHelpers.GetName(msg_type);
 #elif SOURCE_ENGINE == SE_BLADE
@@ -580,16 +648,20 @@ bf_write *UserMessages::OnStartMessage_Pre(IRecipientFilter *filter, int msg_typ
 bf_write *UserMessages::OnStartMessage_Pre(IRecipientFilter *filter, int msg_type)
 #endif
 {
-	bool is_intercept_empty = m_msgIntercepts[msg_type].empty();
-	bool is_hook_empty = m_msgHooks[msg_type].empty();
-
-	if ((is_intercept_empty && is_hook_empty)
+	if (!IsMessageHooked(msg_type)
 		|| (m_InExec && (m_CurFlags & USERMSG_BLOCKHOOKS)))
 	{
+		if (msg_type >= 0 && msg_type < MAX_USERMESSAGES)
+		{
+			m_PassedSent[msg_type]++;
+		}
 		m_InHook = false;
 		UM_RETURN_META_VALUE(MRES_IGNORED, NULL);
 	}
 
+	bool is_intercept_empty = m_msgIntercepts[msg_type].empty();
+
+	m_HookedSent[msg_type]++;
 	m_CurId = msg_type;
 	m_CurRecFilter = filter;
 	m_InHook = true;
@@ -645,17 +717,25 @@ void UserMessages::OnMessageEnd_Post()
 	}
 
 	MsgList *pList;
-	MsgIter iter;
 	ListenerInfo *pInfo;
 
 	m_InHook = false;
 
+	int msg_id = m_CurId;
+	m_DispatchDepth[msg_id]++;
+
 	pList = &m_msgIntercepts[m_CurId];
-	for (iter=pList->begin(); iter!=pList->end(); )
+	for (size_t i = 0; i < pList->size(); )
 	{
-		pInfo = (*iter);
+		pInfo = pList->at(i);
+		if (pInfo->KillMe)
+		{
+			FreeListener(m_CurId, pList, i);
+			continue;
+		}
 		if (m_BlockEndPost && !pInfo->IsNew)
 		{
+			i++;
 			continue;
 		}
 		pInfo->IsHooked = true;
@@ -667,22 +747,26 @@ void UserMessages::OnMessageEnd_Post()
 
 		if (pInfo->KillMe)
 		{
-			iter = pList->erase(iter);
-			m_FreeListeners.push(pInfo);
-			_DecRefCounter();
+			FreeListener(m_CurId, pList, i);
 			continue;
 		}
 
 		pInfo->IsHooked = false;
-		iter++;
+		i++;
 	}
 
 	pList = &m_msgHooks[m_CurId];
-	for (iter=pList->begin(); iter!=pList->end(); )
+	for (size_t i = 0; i < pList->size(); )
 	{
-		pInfo = (*iter);
+		pInfo = pList->at(i);
+		if (pInfo->KillMe)
+		{
+			FreeListener(m_CurId, pList, i);
+			continue;
+		}
 		if (m_BlockEndPost && !pInfo->IsNew)
 		{
+			i++;
 			continue;
 		}
 		pInfo->IsHooked = true;
@@ -694,15 +778,15 @@ void UserMessages::OnMessageEnd_Post()
 
 		if (pInfo->KillMe)
 		{
-			iter = pList->erase(iter);
-			m_FreeListeners.push(pInfo);
-			_DecRefCounter();
+			FreeListener(m_CurId, pList, i);
 			continue;
 		}
 
 		pInfo->IsHooked = false;
-		iter++;
+		i++;
 	}
+
+	m_DispatchDepth[msg_id]--;
 }
 
 void UserMessages::OnMessageEnd_Pre()
@@ -713,17 +797,24 @@ void UserMessages::OnMessageEnd_Pre()
 	}
 
 	MsgList *pList;
-	MsgIter iter;
 	ListenerInfo *pInfo;
 
 	ResultType res;
 	bool intercepted = false;
 	bool handled = false;
+	int msg_id = m_CurId;
+
+	m_DispatchDepth[msg_id]++;
 
 	pList = &m_msgIntercepts[m_CurId];
-	for (iter=pList->begin(); iter!=pList->end(); )
+	for (size_t i = 0; i < pList->size(); )
 	{
-		pInfo = (*iter);
+		pInfo = pList->at(i);
+		if (pInfo->KillMe)
+		{
+			FreeListener(m_CurId, pList, i);
+			continue;
+		}
 		pInfo->IsHooked = true;
 #ifdef USE_PROTOBUF_USERMESSAGES
 		res = pInfo->Callback->InterceptUserMessage(m_CurId, m_InterceptBuffer, m_CurRecFilter);
@@ -739,12 +830,13 @@ void UserMessages::OnMessageEnd_Pre()
 			{
 				if (pInfo->KillMe)
 				{
-					pList->erase(iter);
-					m_FreeListeners.push(pInfo);
-					_DecRefCounter();
-					goto supercede;
+					FreeListener(m_CurId, pList, i);
+				}
+				else
+				{
+					pInfo->IsHooked = false;
 				}
-				pInfo->IsHooked = false;
+				m_DispatchDepth[msg_id]--;
 				goto supercede;
 			}
 		case Pl_Handled:
@@ -752,9 +844,7 @@ void UserMessages::OnMessageEnd_Pre()
 				handled = true;
 				if (pInfo->KillMe)
 				{
-					iter = pList->erase(iter);
-					m_FreeListeners.push(pInfo);
-					_DecRefCounter();
+					FreeListener(m_CurId, pList, i);
 					continue;
 				}
 				break;
@@ -763,16 +853,14 @@ void UserMessages::OnMessageEnd_Pre()
 			{
 				if (pInfo->KillMe)
 				{
-					iter = pList->erase(iter);
-					m_FreeListeners.push(pInfo);
-					_DecRefCounter();
+					FreeListener(m_CurId, pList, i);
 					continue;
 				}
 				break;
 			}
 		}
 		pInfo->IsHooked = false;
-		iter++;
+		i++;
 	}
 
 	if (!handled && intercepted)
@@ -805,22 +893,25 @@ void UserMessages::OnMessageEnd_Pre()
 #endif
 
 		pList = &m_msgHooks[m_CurId];
-		for (iter=pList->begin(); iter!=pList->end(); )
+		for (size_t i = 0; i < pList->size(); )
 		{
-			pInfo = (*iter);
+			pInfo = pList->at(i);
+			if (pInfo->KillMe)
+			{
+				FreeListener(m_CurId, pList, i);
+				continue;
+			}
 			pInfo->IsHooked = true;
 			pInfo->Callback->OnUserMessage(m_CurId, pTempMsg, m_CurRecFilter);
 
 			if (pInfo->KillMe)
 			{
-				iter = pList->erase(iter);
-				m_FreeListeners.push(pInfo);
-				_DecRefCounter();
+				FreeListener(m_CurId, pList, i);
 				continue;
 			}
 
 			pInfo->IsHooked = false;
-			iter++;
+			i++;
 		}
 
 #if SOURCE_ENGINE == SE_CSGO || SOURCE_ENGINE == SE_BLADE || SOURCE_ENGINE == SE_MCV
@@ -828,6 +919,8 @@ void UserMessages::OnMessageEnd_Pre()
 #endif
 	}
 
+	m_DispatchDepth[msg_id]--;
+
 	UM_RETURN_META((intercepted) ? MRES_SUPERCEDE : MRES_IGNORED);
 supercede:
 	m_BlockEndPost = true;
@@ -40,6 +40,9 @@
 #include "sm_globals.h"
 #include <sh_list.h>
 #include <sh_stack.h>
+#include <IRootConsoleMenu.h>
+#include <vector>
+#include <bitset>
 
 using namespace SourceHook;
 using namespace SourceMod;
@@ -72,12 +75,14 @@ struct ListenerInfo
 	bool IsNew;
 };
 
-typedef List<ListenerInfo *> MsgList;
-typedef List<ListenerInfo *>::iterator MsgIter;
+typedef std::vector<ListenerInfo *> MsgList;
+
+#define MAX_USERMESSAGES 255
 
 class UserMessages : 
 	public IUserMessages,
-	public SMGlobalClass
+	public SMGlobalClass,
+	public IRootConsoleCommand
 {
 public:
 	UserMessages();
@@ -86,6 +91,8 @@ public: //SMGlobalClass
 	void OnSourceModStartup(bool late);
 	void OnSourceModAllInitialized();
 	void OnSourceModAllShutdown();
+public: //IRootConsoleCommand
+	void OnRootConsoleCommand(const char *cmdname, const ICommandArgs *command) override;
 public: //IUserMessages
 	int GetMessageIndex(const char *msg);
 	bool GetMessageName(int msgid, char *buffer, size_t maxlength) const;
@@ -119,9 +126,11 @@ public:
 #endif
 	void OnMessageEnd_Pre();
 	void OnMessageEnd_Post();
-private:
 #ifdef USE_PROTOBUF_USERMESSAGES
 	const protobuf::Message *GetMessagePrototype(int msg_type);
+#endif
+private:
+#ifdef USE_PROTOBUF_USERMESSAGES
 	bool InternalHook(int msg_id, IProtobufUserMessageListener *pListener, bool intercept, bool isNew);
 	bool InternalUnhook(int msg_id, IProtobufUserMessageListener *pListener, bool intercept, bool isNew);
 #else
@@ -129,9 +138,21 @@ private:
 	bool InternalUnhook(int msg_id, IBitBufUserMessageListener *pListener, bool intercept, bool isNew);
 #endif
 	void _DecRefCounter();
+	void FreeListener(int msg_id, MsgList *pList, size_t index);
+	void UpdateHookedState(int msg_id);
+	inline bool IsMessageHooked(int msg_id) const
+	{
+		return msg_id >= 0 && msg_id < MAX_USERMESSAGES && m_HookedIds.test(msg_id);
+	}
 private:
-	List<ListenerInfo *> m_msgHooks[255];
-	List<ListenerInfo *> m_msgIntercepts[255];
+	MsgList m_msgHooks[MAX_USERMESSAGES];
+	MsgList m_msgIntercepts[MAX_USERMESSAGES];
+	std::bitset<MAX_USERMESSAGES> m_HookedIds;
+	/* Messages sent while user message hooks were active, by id */
+	unsigned int m_HookedSent[MAX_USERMESSAGES];
+	unsigned int m_PassedSent[MAX_USERMESSAGES];
+	/* Listener lists currently being walked, which must not be erased from */
+	unsigned int m_DispatchDepth[MAX_USERMESSAGES];
 	CStack<ListenerInfo *> m_FreeListeners;
 	IRecipientFilter *m_CurRecFilter;
 #ifndef USE_PROTOBUF_USERMESSAGES
@@ -36,13 +36,25 @@
 #include <string.h>
 #include <ICellArray.h>
 #include <amtl/am-bits.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 extern HandleType_t htCellArray;
 
 class CellArray : public ICellArray
 {
 public:
-	CellArray(size_t blocksize) : m_Data(NULL), m_BlockSize(blocksize), m_AllocSize(0), m_Size(0)
+	enum IndexType
+	{
+		Index_None,
+		Index_String,
+		Index_Cell,
+	};
+
+	CellArray(size_t blocksize) : m_Data(NULL), m_BlockSize(blocksize), m_AllocSize(0), m_Size(0),
+		m_IndexType(Index_None), m_IndexBlock(0)
 	{
 	}
 
@@ -105,6 +117,7 @@ public:
 	void clear()
 	{
 		m_Size = 0;
+		invalidate_index();
 	}
 
 	bool swap(size_t item1, size_t item2)
@@ -125,6 +138,9 @@ public:
 		memcpy(pri, alt, sizeof(cell_t) * m_BlockSize);
 		memcpy(alt, temp, sizeof(cell_t) * m_BlockSize);
 
+		reindex(item1);
+		reindex(item2);
+
 		return true;
 	}
 
@@ -133,10 +149,19 @@ public:
 		/* If we're at the end, take the easy way out */
 		if (index == m_Size - 1)
 		{
+			TruncateIndex(index);
 			m_Size--;
 			return;
 		}
 
+		/* Every indexed item after this one moves down */
+		if (index < m_IndexKeys.size())
+		{
+			Unindex(index);
+			m_IndexKeys.erase(m_IndexKeys.begin() + index);
+			ShiftIndex(index, false);
+		}
+
 		/* Otherwise, it's time to move stuff! */
 		size_t remaining_indexes = (m_Size - 1) - index;
 		cell_t *src = at(index + 1);
@@ -154,6 +179,15 @@ public:
 			return NULL;
 		}
 
+		/* The new item starts out as a copy of the one it displaces */
+		if (index < m_IndexKeys.size())
+		{
+			std::string key = m_IndexKeys[index];
+			ShiftIndex(index, true);
+			AddToIndex(index, key);
+			m_IndexKeys.insert(m_IndexKeys.begin() + index, std::move(key));
+		}
+
 		/* move everything up */
 		cell_t *src = at(index);
 		cell_t *dst = at(index + 1);
@@ -168,6 +202,7 @@ public:
 	{
 		if (count <= m_Size)
 		{
+			TruncateIndex(count);
 			m_Size = count;
 			return true;
 		}
@@ -194,6 +229,10 @@ public:
 		}
 		
 		memcpy(array->m_Data, m_Data, sizeof(cell_t) * m_BlockSize * m_Size);
+
+		/* The clone rebuilds its own index on first lookup */
+		array->m_IndexType = m_IndexType;
+		array->m_IndexBlock = m_IndexBlock;
 		return array;
 	}
 
@@ -207,6 +246,178 @@ public:
 		return m_AllocSize * m_BlockSize * sizeof(cell_t);
 	}
 
+	// Lookup index
+public:
+	/**
+	* @brief Starts maintaining a hash index over one block of every item,
+	* so exact match lookups on that block don't have to scan the array.
+	* Items appended to the array are indexed lazily on the next lookup.
+	*
+	* @param type		Index_String to index the string starting at the
+	*					block, Index_Cell to index the cell itself, or
+	*					Index_None to drop the index.
+	* @param block		Block to index. Must be less than blocksize().
+	*/
+	void set_index(IndexType type, size_t block)
+	{
+		m_IndexType = type;
+		m_IndexBlock = block;
+		invalidate_index();
+	}
+
+	IndexType index_type() const
+	{
+		return m_IndexType;
+	}
+
+	size_t index_block() const
+	{
+		return m_IndexBlock;
+	}
+
+	/**
+	* @brief Updates the index after an item was written through at() or
+	* base(). Changes made by the other ICellArray calls are tracked
+	* automatically.
+	*
+	* @param item		Index of the item that changed.
+	*/
+	void reindex(size_t item)
+	{
+		if (item >= m_IndexKeys.size())
+		{
+			return;
+		}
+
+		std::string key = IndexKey(item);
+		if (key == m_IndexKeys[item])
+		{
+			return;
+		}
+
+		Unindex(item);
+		AddToIndex(item, key);
+		m_IndexKeys[item] = std::move(key);
+	}
+
+	/**
+	* @brief Discards the index so it's rebuilt on the next lookup. Must be
+	* called after items are reordered directly in memory (e.g. sorting).
+	*/
+	void invalidate_index()
+	{
+		m_Index.clear();
+		m_IndexKeys.clear();
+	}
+
+	/**
+	* @brief Finds an item through the index.
+	*
+	* @param key		String (Index_String) or cell (Index_Cell) to find.
+	* @param start		When searching forward, the first item to consider.
+	*					When searching in reverse, one past the last item.
+	* @param reverse	Whether to return the last match instead of the first.
+	* @return			Item index, or -1 if there is no match.
+	*/
+	int find_indexed(const char *key, size_t start, bool reverse)
+	{
+		return FindIndexed(std::string(key), start, reverse);
+	}
+
+	int find_indexed(cell_t key, size_t start, bool reverse)
+	{
+		return FindIndexed(std::string((const char *)&key, sizeof(key)), start, reverse);
+	}
+
+private:
+	std::string IndexKey(size_t item) const
+	{
+		const char *data = (const char *)(at(item) + m_IndexBlock);
+		if (m_IndexType == Index_String)
+		{
+			/* Strings filling the rest of the item aren't terminated */
+			return std::string(data, strnlen(data, (m_BlockSize - m_IndexBlock) * sizeof(cell_t)));
+		}
+		return std::string(data, sizeof(cell_t));
+	}
+
+	void AddToIndex(size_t item, const std::string &key)
+	{
+		std::vector<size_t> &items = m_Index[key];
+		items.insert(std::lower_bound(items.begin(), items.end(), item), item);
+	}
+
+	void Unindex(size_t item)
+	{
+		auto iter = m_Index.find(m_IndexKeys[item]);
+		if (iter == m_Index.end())
+		{
+			return;
+		}
+
+		std::vector<size_t> &items = iter->second;
+		auto pos = std::lower_bound(items.begin(), items.end(), item);
+		if (pos != items.end() && *pos == item)
+		{
+			items.erase(pos);
+		}
+		if (items.empty())
+		{
+			m_Index.erase(iter);
+		}
+	}
+
+	/* Moves every indexed position at or after first up or down by one. */
+	void ShiftIndex(size_t first, bool up)
+	{
+		for (auto iter = m_Index.begin(); iter != m_Index.end(); ++iter)
+		{
+			std::vector<size_t> &items = iter->second;
+			for (auto pos = std::lower_bound(items.begin(), items.end(), first); pos != items.end(); ++pos)
+			{
+				if (up)
+					(*pos)++;
+				else
+					(*pos)--;
+			}
+		}
+	}
+
+	/* Drops items [count, size) from the index. */
+	void TruncateIndex(size_t count)
+	{
+		while (m_IndexKeys.size() > count)
+		{
+			Unindex(m_IndexKeys.size() - 1);
+			m_IndexKeys.pop_back();
+		}
+	}
+
+	int FindIndexed(const std::string &key, size_t start, bool reverse)
+	{
+		/* Catch up with items appended since the last lookup */
+		while (m_IndexKeys.size() < m_Size)
+		{
+			size_t item = m_IndexKeys.size();
+			m_IndexKeys.push_back(IndexKey(item));
+			AddToIndex(item, m_IndexKeys.back());
+		}
+
+		auto iter = m_Index.find(key);
+		if (iter == m_Index.end())
+		{
+			return -1;
+		}
+
+		const std::vector<size_t> &items = iter->second;
+		auto pos = std::lower_bound(items.begin(), items.end(), start);
+		if (reverse)
+		{
+			return (pos == items.begin()) ? -1 : (int)*(pos - 1);
+		}
+		return (pos == items.end()) ? -1 : (int)*pos;
+	}
+
 private:
 	bool GrowIfNeeded(size_t count)
 	{
@@ -249,6 +460,11 @@ private:
 	size_t m_BlockSize;
 	size_t m_AllocSize;
 	size_t m_Size;
+	IndexType m_IndexType;
+	size_t m_IndexBlock;
+	/* Key of every indexed item. Items past the end haven't been indexed yet. */
+	std::vector<std::string> m_IndexKeys;
+	std::unordered_map<std::string, std::vector<size_t>> m_Index;
 };
 
 #endif /* _INCLUDE_SOURCEMOD_CELLARRAY_H_ */
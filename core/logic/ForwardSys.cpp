@@ -31,6 +31,7 @@
 #include "ForwardSys.h"
 #include "DebugReporter.h"
 #include "common_logic.h"
+#include "ProfileTools.h"
 #include <bridge/include/IScriptManager.h>
 #include <amtl/am-string.h>
 #include <ReentrantList.h>
@@ -285,6 +286,7 @@ int CForward::Execute(const sp::CallArgs& in_args, cell_t *result, IForwardFilte
 	}
 
 	m_ExecDepth++;
+	g_ProfileToolManager.EnterScope("forwards", m_name[0] ? m_name : "<private>");
 
 	for (FuncIter iter(m_functions); !iter.done(); iter.next())
 	{
@@ -351,6 +353,7 @@ int CForward::Execute(const sp::CallArgs& in_args, cell_t *result, IForwardFilte
 	 * plugin deletes its own private forward from within one of its own
 	 * callbacks), the actual delete is deferred to here so we don't touch
 	 * freed memory by continuing to use "this" above. */
+	g_ProfileToolManager.LeaveScope();
 	if (--m_ExecDepth == 0 && m_deleted)
 	{
 		g_Forwards.ReleaseForward(this);
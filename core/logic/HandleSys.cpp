@@ -1255,3 +1255,40 @@ void HandleSystem::Dump(const HandleReporter &fn)
 	}
 	rep(fn, "-- Approximately %d bytes of memory are in use by Handles.\n", total_size);
 }
+
+void HandleSystem::ReportUsage(const HandleUsageReporter &reporter)
+{
+	for (unsigned int i = 1; i <= m_HandleTail; i++)
+	{
+		const QHandle &Handle = m_Handles[i];
+		if (Handle.set != HandleSet_Used)
+		{
+			continue;
+		}
+
+		QHandleType *pType = &m_Types[Handle.type];
+		const char *type = pType->name ? pType->name->c_str() : "ANON";
+		unsigned int size = 0;
+
+		if (pType->dispatch->GetDispatchVersion() >= HANDLESYS_MEMUSAGE_MIN_VERSION)
+		{
+			unsigned int parentIdx = Handle.clone;
+			if (parentIdx == 0)
+			{
+				if (!pType->dispatch->GetHandleApproxSize(Handle.type, Handle.object, &size))
+				{
+					size = 0;
+				}
+			}
+			else if (m_Handles[parentIdx].refcount == 0)
+			{
+				if (!pType->dispatch->GetHandleApproxSize(m_Handles[parentIdx].type, m_Handles[parentIdx].object, &size))
+				{
+					size = 0;
+				}
+			}
+		}
+
+		reporter(Handle.owner, type, size);
+	}
+}
@@ -124,6 +124,7 @@ struct QHandleType
 };
 
 typedef ke::Function<void(const char *)> HandleReporter;
+typedef ke::Function<void(IdentityToken_t *owner, const char *type, unsigned int size)> HandleUsageReporter;
 
 class HandleSystem : 
 	public IHandleSys
@@ -177,6 +178,13 @@ public: //IHandleSystem
 
 	void Dump(const HandleReporter &reporter);
 
+	/**
+	 * Reports the owner, type name and approximate size of every live
+	 * Handle. Clones of a live Handle report a size of 0, as does any type
+	 * that cannot compute its size.
+	 */
+	void ReportUsage(const HandleUsageReporter &reporter);
+
 	/* Bypasses security checks. */
 	Handle_t FastCloneHandle(Handle_t hndl);
 protected:
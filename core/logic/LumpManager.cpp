@@ -31,8 +31,10 @@
 
 #include "LumpManager.h"
 
-#include <iomanip>
-#include <sstream>
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+#include <tuple>
 
 EntityLumpParseResult::operator bool() const {
 	return m_Status == Status_OK;
@@ -40,23 +42,36 @@ EntityLumpParseResult::operator bool() const {
 
 EntityLumpParseResult EntityLumpManager::Parse(const char* pMapEntities) {
 	m_Entities.clear();
+	m_Strings.clear();
 	
-	std::istringstream mapEntities(pMapEntities);
+	// Keys and values point into our own copy of the lump, so nothing else is allocated per string.
+	m_Lump.assign(pMapEntities);
 	
+	const char* base = m_Lump.c_str();
+	m_Entities.reserve(std::count(m_Lump.begin(), m_Lump.end(), '{'));
+	m_Strings.reserve(std::count(m_Lump.begin(), m_Lump.end(), '"') / 2);
+	
+	auto unexpected = [base](const char* pos) {
+		return EntityLumpParseResult {
+			Status_UnexpectedChar, pos - base
+		};
+	};
+	
+	const char* pos = base;
 	for (;;) {
-		std::string token;
-		mapEntities >> std::ws >> token >> std::ws;
+		while (isspace(static_cast<unsigned char>(*pos))) {
+			pos++;
+		}
 		
 		// Assert that we're at the start of a new block, otherwise we're done parsing
-		if (token != "{") {
-			if (token == "\0") {
+		if (*pos != '{') {
+			if (*pos == '\0') {
 				break;
 			} else {
-				return EntityLumpParseResult {
-					Status_UnexpectedChar, mapEntities.tellg()
-				};
+				return unexpected(pos);
 			}
 		}
+		pos++;
 		
 		/**
 		 * Parse key / value pairs until we reach a closing brace.  We currently assume there
@@ -64,53 +79,121 @@ EntityLumpParseResult EntityLumpManager::Parse(const char* pMapEntities) {
 		 *
 		 * The SDK suggests that there are cases that could use non-quoted symbols and nested
 		 * braces (`shared/mapentities_shared.cpp::MapEntity_ParseToken`), but I haven't seen
-		 * those in practice.
+		 * those in practice.  Like the engine, backslashes within quotes are not escapes.
 		 */
-		EntityLumpEntry entry;
-		while (mapEntities.peek() != '}') {
-			std::string key, value;
-			
-			if (mapEntities.peek() != '"') {
-				return EntityLumpParseResult {
-					Status_UnexpectedChar, mapEntities.tellg()
-				};
+		LumpEntity entity { m_Strings.size(), 0, nullptr };
+		for (;;) {
+			while (isspace(static_cast<unsigned char>(*pos))) {
+				pos++;
 			}
-			mapEntities >> quoted(key) >> std::ws;
-			
-			if (mapEntities.peek() != '"') {
-				return EntityLumpParseResult {
-					Status_UnexpectedChar, mapEntities.tellg()
-				};
+			if (*pos == '}') {
+				break;
 			}
-			mapEntities >> quoted(value) >> std::ws;
 			
-			entry.emplace_back(key, value);
+			// key, then value
+			for (int i = 0; i < 2; i++) {
+				while (isspace(static_cast<unsigned char>(*pos))) {
+					pos++;
+				}
+				if (*pos != '"') {
+					return unexpected(pos);
+				}
+				
+				const char* start = ++pos;
+				const char* end = strchr(start, '"');
+				if (!end) {
+					return unexpected(start + strlen(start));
+				}
+				m_Strings.push_back(LumpString {
+					static_cast<uint32_t>(start - base), static_cast<uint32_t>(end - start)
+				});
+				pos = end + 1;
+			}
+			entity.m_NumPairs++;
 		}
-		mapEntities.get();
-		m_Entities.push_back(std::make_shared<EntityLumpEntry>(entry));
+		pos++;
+		m_Entities.push_back(std::move(entity));
 	}
 	
 	return EntityLumpParseResult{};
 }
 
+const std::shared_ptr<EntityLumpEntry>& EntityLumpManager::Materialize(size_t index) {
+	LumpEntity& entity = m_Entities[index];
+	if (!entity.m_Entry) {
+		auto entry = std::make_shared<EntityLumpEntry>();
+		entry->reserve(entity.m_NumPairs);
+		
+		const char* base = m_Lump.c_str();
+		for (size_t i = 0; i < entity.m_NumPairs; i++) {
+			const LumpString& key = m_Strings[entity.m_FirstString + i * 2];
+			const LumpString& value = m_Strings[entity.m_FirstString + i * 2 + 1];
+			entry->emplace_back(std::piecewise_construct,
+					std::forward_as_tuple(base + key.m_Offset, key.m_Length),
+					std::forward_as_tuple(base + value.m_Offset, value.m_Length));
+		}
+		entity.m_Entry = std::move(entry);
+	}
+	return entity.m_Entry;
+}
+
 std::string EntityLumpManager::Dump() {
-	std::ostringstream stream;
-	for (const auto& entry : m_Entities) {
+	const char* base = m_Lump.c_str();
+	
+	// "key" "value"\n
+	const size_t kPairOverhead = 6;
+	
+	// Size the output up front so it's built with a single allocation.
+	size_t length = 0;
+	for (const auto& entity : m_Entities) {
+		if (entity.m_Entry) {
+			for (const auto& pair : *entity.m_Entry) {
+				length += pair.first.size() + pair.second.size() + kPairOverhead;
+			}
+		} else {
+			for (size_t i = 0; i < entity.m_NumPairs * 2; i++) {
+				length += m_Strings[entity.m_FirstString + i].m_Length;
+			}
+			length += entity.m_NumPairs * kPairOverhead;
+		}
+		length += 4; // "{\n" and "}\n"
+	}
+	
+	std::string result;
+	result.reserve(length);
+	
+	auto append_pair = [&result](const char* key, size_t keylen, const char* value, size_t valuelen) {
+		result += '"';
+		result.append(key, keylen);
+		result += "\" \"";
+		result.append(value, valuelen);
+		result += "\"\n";
+	};
+	
+	for (const auto& entity : m_Entities) {
 		// ignore empty entries
-		if (entry->empty()) {
+		if (entity.m_Entry ? entity.m_Entry->empty() : !entity.m_NumPairs) {
 			continue;
 		}
-		stream << "{\n";
-		for (const auto& pair : *entry) {
-			stream << '"' << pair.first << "\" \"" << pair.second << '"' << '\n';
+		result += "{\n";
+		if (entity.m_Entry) {
+			for (const auto& pair : *entity.m_Entry) {
+				append_pair(pair.first.c_str(), pair.first.size(), pair.second.c_str(), pair.second.size());
+			}
+		} else {
+			for (size_t i = 0; i < entity.m_NumPairs; i++) {
+				const LumpString& key = m_Strings[entity.m_FirstString + i * 2];
+				const LumpString& value = m_Strings[entity.m_FirstString + i * 2 + 1];
+				append_pair(base + key.m_Offset, key.m_Length, base + value.m_Offset, value.m_Length);
+			}
 		}
-		stream << "}\n";
+		result += "}\n";
 	}
-	return stream.str();
+	return result;
 }
 
 std::weak_ptr<EntityLumpEntry> EntityLumpManager::Get(size_t index) {
-	return m_Entities[index];
+	return Materialize(index);
 }
 
 void EntityLumpManager::Erase(size_t index) {
@@ -118,11 +201,11 @@ void EntityLumpManager::Erase(size_t index) {
 }
 
 void EntityLumpManager::Insert(size_t index) {
-	m_Entities.emplace(m_Entities.begin() + index, std::make_shared<EntityLumpEntry>());
+	m_Entities.emplace(m_Entities.begin() + index, LumpEntity { 0, 0, std::make_shared<EntityLumpEntry>() });
 }
 
 size_t EntityLumpManager::Append() {
-	auto it = m_Entities.emplace(m_Entities.end(), std::make_shared<EntityLumpEntry>());
+	auto it = m_Entities.emplace(m_Entities.end(), LumpEntity { 0, 0, std::make_shared<EntityLumpEntry>() });
 	return std::distance(m_Entities.begin(), it);
 }
 
@@ -35,6 +35,7 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <stdint.h>
 
 /**
  * Entity lump manager.  Provides a list that stores a list of key / value pairs and the
@@ -86,6 +87,7 @@ public:
 
 	/**
 	 * @brief Returns a weak reference to an EntityLumpEntry.  Used for handles on the scripting side.
+	 * The entry's keys and values are copied out of the parsed lump the first time it is requested.
 	 */
 	std::weak_ptr<EntityLumpEntry> Get(size_t index);
 
@@ -110,7 +112,29 @@ public:
 	size_t Length();
 
 private:
-	std::vector<std::shared_ptr<EntityLumpEntry>> m_Entities;
+	/**
+	 * @brief Location of a key or value within m_Lump.
+	 */
+	struct LumpString {
+		uint32_t m_Offset;
+		uint32_t m_Length;
+	};
+
+	/**
+	 * @brief An entity is either still the span of key / value pairs it was parsed from, or, once a
+	 * handle has been requested for it, an EntityLumpEntry that may have been modified.
+	 */
+	struct LumpEntity {
+		size_t m_FirstString;
+		size_t m_NumPairs;
+		std::shared_ptr<EntityLumpEntry> m_Entry;
+	};
+
+	const std::shared_ptr<EntityLumpEntry>& Materialize(size_t index);
+
+	std::string m_Lump;
+	std::vector<LumpString> m_Strings;
+	std::vector<LumpEntity> m_Entities;
 };
 
 #endif // _INCLUDE_LUMPMANAGER_H_
@@ -0,0 +1,290 @@
+// vim: set ts=4 sw=4 tw=99 noet :
+// =============================================================================
+// SourceMod
+// Copyright (C) 2004-2026 AlliedModders LLC.  All rights reserved.
+// =============================================================================
+
+// This program is free software; you can redistribute it and/or modify it under
+// the terms of the GNU General Public License, version 3.0, as published by the
+// Free Software Foundation.
+// 
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// As a special exception, AlliedModders LLC gives you permission to link the
+// code of this program (as well as its derivative works) to "Half-Life 2," the
+// "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+// by the Valve Corporation.  You must obey the GNU General Public License in
+// all respects for all other code used.  Additionally, AlliedModders LLC grants
+// this exception to all derivative works.  AlliedModders LLC defines further
+// exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+// or <http://www.sourcemod.net/license.php>.
+#include "PluginMemory.h"
+#include "PluginSys.h"
+#include "HandleSys.h"
+#include "common_logic.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include <amtl/am-string.h>
+#include <bridge/include/CoreProvider.h>
+
+namespace SourceMod {
+
+PluginMemoryTracker g_PluginMemory;
+
+// Number of Handle types listed per plugin in the summary.
+static const size_t kSummaryTypes = 3;
+
+void PluginMemoryTracker::OnSourceModAllInitialized()
+{
+	const char *value = bridge->GetCoreConfigValue("PluginMemorySampleInterval");
+	float interval = value ? static_cast<float>(atof(value)) : 0.0f;
+	if (interval > 0.0f)
+		timer_ = timersys->CreateTimer(this, interval, nullptr, TIMER_FLAG_REPEAT);
+}
+
+void PluginMemoryTracker::OnSourceModShutdown()
+{
+	if (timer_)
+	{
+		timersys->KillTimer(timer_);
+		timer_ = nullptr;
+	}
+}
+
+ResultType PluginMemoryTracker::OnTimer(ITimer *pTimer, void *pData)
+{
+	PluginMemorySample sample;
+	Sample(sample);
+	baseline_ = std::move(sample);
+	return Pl_Continue;
+}
+
+void PluginMemoryTracker::OnTimerEnd(ITimer *pTimer, void *pData)
+{
+	timer_ = nullptr;
+}
+
+void PluginMemoryTracker::Sample(PluginMemorySample &sample)
+{
+	sample.time = time(nullptr);
+
+	std::unordered_map<IdentityToken_t *, PluginMemoryUsage *> owners;
+	IPluginIterator *iter = g_PluginSys.GetPluginIterator();
+	for (; iter->MorePlugins(); iter->NextPlugin())
+	{
+		CPlugin *pl = static_cast<CPlugin *>(iter->GetPlugin());
+		if (!pl->GetIdentity())
+			continue;
+
+		PluginMemoryUsage &usage = sample.plugins[pl->GetFilename()];
+		usage.plugin = pl->CalcMemUsage();
+		if (IPluginRuntime *runtime = pl->GetRuntime())
+			usage.vm = runtime->GetMemUsage();
+		owners[pl->GetIdentity()] = &usage;
+	}
+	iter->Release();
+
+	g_HandleSys.ReportUsage([&](IdentityToken_t *owner, const char *type, unsigned int size) {
+		auto iter = owners.find(owner);
+		PluginMemoryUsage &usage = iter != owners.end() ? *iter->second : sample.other;
+		PluginMemoryType &entry = usage.types[type];
+		entry.count++;
+		entry.bytes += size;
+		usage.handle_count++;
+		usage.handles += size;
+	});
+}
+
+static const char *FormatBytes(char *buffer, size_t maxlength, int64_t bytes, bool sign = false)
+{
+	const char *prefix = (bytes < 0) ? "-" : (sign ? "+" : "");
+	uint64_t magnitude = static_cast<uint64_t>(bytes < 0 ? -bytes : bytes);
+	if (magnitude >= 1024 * 1024)
+		ke::SafeSprintf(buffer, maxlength, "%s%.1fM", prefix, magnitude / (1024.0 * 1024.0));
+	else if (magnitude >= 1024)
+		ke::SafeSprintf(buffer, maxlength, "%s%.1fK", prefix, magnitude / 1024.0);
+	else
+		ke::SafeSprintf(buffer, maxlength, "%s%uB", prefix, static_cast<unsigned int>(magnitude));
+	return buffer;
+}
+
+static int64_t Delta(uint64_t now, uint64_t before)
+{
+	return static_cast<int64_t>(now) - static_cast<int64_t>(before);
+}
+
+const char *PluginMemoryTracker::FormatDelta(char *buffer, size_t maxlength, uint64_t now, uint64_t before)
+{
+	if (!baseline_.time)
+	{
+		ke::SafeStrcpy(buffer, maxlength, "-");
+		return buffer;
+	}
+	return FormatBytes(buffer, maxlength, Delta(now, before), true);
+}
+
+static std::vector<std::pair<std::string, PluginMemoryType>> SortTypes(const PluginMemoryUsage &usage)
+{
+	std::vector<std::pair<std::string, PluginMemoryType>> types(usage.types.begin(), usage.types.end());
+	std::stable_sort(types.begin(), types.end(), [](const auto &a, const auto &b) {
+		return a.second.bytes != b.second.bytes
+			? a.second.bytes > b.second.bytes
+			: a.second.count > b.second.count;
+	});
+	return types;
+}
+
+void PluginMemoryTracker::OnRootConsoleCommand(const ICommandArgs *command)
+{
+	PluginMemorySample now;
+	Sample(now);
+
+	if (baseline_.time)
+	{
+		rootmenu->ConsolePrint("[SM] Plugin memory (approximate); deltas are since the sample taken %d seconds ago:",
+			static_cast<int>(now.time - baseline_.time));
+	}
+	else
+	{
+		rootmenu->ConsolePrint("[SM] Plugin memory (approximate); this is the first sample:");
+	}
+
+	if (command->ArgC() >= 4)
+		PrintPlugin(now, command->Arg(3));
+	else
+		PrintSummary(now);
+
+	// Without periodic sampling, deltas are measured between uses of the command.
+	if (!timer_)
+		baseline_ = std::move(now);
+}
+
+void PluginMemoryTracker::PrintSummary(const PluginMemorySample &now)
+{
+	std::vector<std::pair<const std::string *, const PluginMemoryUsage *>> plugins;
+	for (const auto &iter : now.plugins)
+		plugins.emplace_back(&iter.first, &iter.second);
+	std::stable_sort(plugins.begin(), plugins.end(), [](const auto &a, const auto &b) {
+		return a.second->total() > b.second->total();
+	});
+
+	char total[16], delta[16], vm[16], plugin[16], handles[16];
+	rootmenu->ConsolePrint("  %8s %8s %8s %8s %8s %7s  %s", "total", "delta", "vm", "plugin", "handles", "count", "file");
+
+	uint64_t sum = 0, sum_before = 0;
+	for (const auto &iter : plugins)
+	{
+		const PluginMemoryUsage &usage = *iter.second;
+		auto before = baseline_.plugins.find(*iter.first);
+		uint64_t total_before = before != baseline_.plugins.end() ? before->second.total() : 0;
+		sum += usage.total();
+		sum_before += total_before;
+
+		rootmenu->ConsolePrint("  %8s %8s %8s %8s %8s %7u  %s",
+			FormatBytes(total, sizeof(total), usage.total()),
+			FormatDelta(delta, sizeof(delta), usage.total(), total_before),
+			FormatBytes(vm, sizeof(vm), usage.vm),
+			FormatBytes(plugin, sizeof(plugin), usage.plugin),
+			FormatBytes(handles, sizeof(handles), usage.handles),
+			usage.handle_count,
+			iter.first->c_str());
+
+		auto types = SortTypes(usage);
+		for (size_t i = 0; i < types.size() && i < kSummaryTypes; i++)
+		{
+			const PluginMemoryType &type = types[i].second;
+			uint64_t type_before = 0;
+			if (before != baseline_.plugins.end())
+			{
+				auto prev = before->second.types.find(types[i].first);
+				if (prev != before->second.types.end())
+					type_before = prev->second.bytes;
+			}
+			rootmenu->ConsolePrint("  %8s %8s %26s %7u    %s",
+				FormatBytes(total, sizeof(total), type.bytes),
+				FormatDelta(delta, sizeof(delta), type.bytes, type_before),
+				"", type.count, types[i].first.c_str());
+		}
+	}
+
+	rootmenu->ConsolePrint("  %8s %8s %26s %7u  %s",
+		FormatBytes(total, sizeof(total), now.other.handles),
+		FormatDelta(delta, sizeof(delta), now.other.handles, baseline_.other.handles),
+		"", now.other.handle_count, "<core and extensions>");
+	rootmenu->ConsolePrint("  %8s %8s  plugins total",
+		FormatBytes(total, sizeof(total), sum),
+		FormatDelta(delta, sizeof(delta), sum, sum_before));
+}
+
+void PluginMemoryTracker::PrintPlugin(const PluginMemorySample &now, const char *arg)
+{
+	std::string file;
+	char *end;
+	int id = strtol(arg, &end, 10);
+	if (*end == '\0')
+	{
+		CPlugin *pl = g_PluginSys.GetPluginByOrder(id);
+		if (!pl)
+		{
+			rootmenu->ConsolePrint("[SM] Plugin index %d not found.", id);
+			return;
+		}
+		file = pl->GetFilename();
+	}
+	else
+	{
+		file = arg;
+		if (!now.plugins.count(file))
+			file += ".smx";
+	}
+
+	auto iter = now.plugins.find(file);
+	if (iter == now.plugins.end())
+	{
+		rootmenu->ConsolePrint("[SM] Plugin %s is not loaded.", arg);
+		return;
+	}
+
+	const PluginMemoryUsage &usage = iter->second;
+	auto before = baseline_.plugins.find(file);
+	const PluginMemoryUsage empty;
+	const PluginMemoryUsage &prev = before != baseline_.plugins.end() ? before->second : empty;
+
+	char size[16], delta[16];
+	rootmenu->ConsolePrint("  %s", file.c_str());
+	rootmenu->ConsolePrint("  %8s %8s %7s  %s", "size", "delta", "count", "type");
+	rootmenu->ConsolePrint("  %8s %8s %7s  %s",
+		FormatBytes(size, sizeof(size), usage.vm),
+		FormatDelta(delta, sizeof(delta), usage.vm, prev.vm),
+		"", "<vm image, heap and stack>");
+	rootmenu->ConsolePrint("  %8s %8s %7s  %s",
+		FormatBytes(size, sizeof(size), usage.plugin),
+		FormatDelta(delta, sizeof(delta), usage.plugin, prev.plugin),
+		"", "<plugin>");
+	for (const auto &type : SortTypes(usage))
+	{
+		auto old = prev.types.find(type.first);
+		uint64_t type_before = old != prev.types.end() ? old->second.bytes : 0;
+		unsigned int count_before = old != prev.types.end() ? old->second.count : 0;
+		rootmenu->ConsolePrint("  %8s %8s %7u  %s (%+d)",
+			FormatBytes(size, sizeof(size), type.second.bytes),
+			FormatDelta(delta, sizeof(delta), type.second.bytes, type_before),
+			type.second.count, type.first.c_str(),
+			static_cast<int>(type.second.count) - static_cast<int>(count_before));
+	}
+	rootmenu->ConsolePrint("  %8s %8s %7u  total",
+		FormatBytes(size, sizeof(size), usage.total()),
+		FormatDelta(delta, sizeof(delta), usage.total(), prev.total()),
+		usage.handle_count);
+}
+
+} // namespace SourceMod
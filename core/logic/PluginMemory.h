@@ -0,0 +1,105 @@
+// vim: set ts=4 sw=4 tw=99 noet :
+// =============================================================================
+// SourceMod
+// Copyright (C) 2004-2026 AlliedModders LLC.  All rights reserved.
+// =============================================================================
+
+// This program is free software; you can redistribute it and/or modify it under
+// the terms of the GNU General Public License, version 3.0, as published by the
+// Free Software Foundation.
+// 
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// As a special exception, AlliedModders LLC gives you permission to link the
+// code of this program (as well as its derivative works) to "Half-Life 2," the
+// "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+// by the Valve Corporation.  You must obey the GNU General Public License in
+// all respects for all other code used.  Additionally, AlliedModders LLC grants
+// this exception to all derivative works.  AlliedModders LLC defines further
+// exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+// or <http://www.sourcemod.net/license.php>.
+#ifndef _include_sourcemod_logic_plugin_memory_h_
+#define _include_sourcemod_logic_plugin_memory_h_
+
+#include <stdint.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <IRootConsoleMenu.h>
+#include <ITimerSystem.h>
+#include "common_logic.h"
+
+namespace SourceMod {
+
+struct PluginMemoryType
+{
+	unsigned int count = 0;
+	uint64_t bytes = 0;
+};
+
+struct PluginMemoryUsage
+{
+	uint64_t vm = 0;		// Runtime image, including the data, heap and stack reservation.
+	uint64_t plugin = 0;	// Plugin system bookkeeping (CPlugin::CalcMemUsage).
+	uint64_t handles = 0;
+	unsigned int handle_count = 0;
+	std::map<std::string, PluginMemoryType> types;
+
+	uint64_t total() const {
+		return vm + plugin + handles;
+	}
+};
+
+struct PluginMemorySample
+{
+	time_t time = 0;
+	// Keyed by plugin filename so that samples line up across reloads.
+	std::map<std::string, PluginMemoryUsage> plugins;
+	// Handles owned by core and extensions.
+	PluginMemoryUsage other;
+};
+
+// Samples approximate memory held by each plugin: its VM image, plugin
+// bookkeeping, and every live Handle it owns, grouped by Handle type. "sm
+// plugins mem" takes a fresh sample and compares it with a baseline, so the
+// deltas show which plugins are growing. If PluginMemorySampleInterval is set
+// in core.cfg, the baseline is a periodic sample and the command leaves it
+// alone; otherwise each use of the command becomes the next baseline.
+//
+// Sampling walks every Handle, and KeyValues Handles walk their whole tree,
+// so periodic sampling is off by default.
+class PluginMemoryTracker :
+	public SMGlobalClass,
+	public ITimedEvent
+{
+public: // SMGlobalClass
+	void OnSourceModAllInitialized() override;
+	void OnSourceModShutdown() override;
+public: // ITimedEvent
+	ResultType OnTimer(ITimer *pTimer, void *pData) override;
+	void OnTimerEnd(ITimer *pTimer, void *pData) override;
+public:
+	void Sample(PluginMemorySample &sample);
+	void OnRootConsoleCommand(const ICommandArgs *command);
+
+private:
+	void PrintSummary(const PluginMemorySample &now);
+	void PrintPlugin(const PluginMemorySample &now, const char *arg);
+	const char *FormatDelta(char *buffer, size_t maxlength, uint64_t now, uint64_t before);
+
+private:
+	PluginMemorySample baseline_;
+	ITimer *timer_ = nullptr;
+};
+
+extern PluginMemoryTracker g_PluginMemory;
+
+} // namespace SourceMod
+
+#endif // _include_sourcemod_logic_plugin_memory_h_
@@ -31,7 +31,9 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <chrono>
 #include "PluginSys.h"
+#include "PluginMemory.h"
 #include "ShareSys.h"
 #include <ILibrarySys.h>
 #include <ISourceMod.h>
@@ -55,6 +57,12 @@ CPluginManager g_PluginSys;
 HandleType_t g_PluginType = 0;
 IdentityType_t g_PluginIdent = 0;
 
+static inline int64_t MicrosecondsSince(std::chrono::steady_clock::time_point start)
+{
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
 CPlugin::CPlugin(const char *file)
  : m_serial(0),
    m_status(Plugin_Uncompiled),
@@ -80,6 +88,7 @@ CPlugin::CPlugin(const char *file)
 	ke::SafeStrcpy(m_filename, sizeof(m_filename), file);
 
 	memset(&m_info, 0, sizeof(m_info));
+	memset(&m_LoadTimes, 0, sizeof(m_LoadTimes));
 
 	m_pPhrases.reset(g_Translator.CreatePhraseCollection());
 }
@@ -487,7 +496,14 @@ bool CPlugin::TryCompile()
 	g_pSM->BuildPath(Path_SM, fullpath, sizeof(fullpath), "plugins/%s", m_filename);
 
 	char loadmsg[255];
+
+	// The VM only loads plugins from a path: reading, decompressing, verifying
+	// and compiling all happen inside LoadBinaryFromFile, on this thread. An
+	// image inflated or checked elsewhere can't be handed to it, so this stays
+	// serial and is timed as a single phase.
+	auto start = std::chrono::steady_clock::now();
 	m_pRuntime.reset(g_pPawnEnv->LoadBinaryFromFile(fullpath, loadmsg, sizeof(loadmsg)));
+	m_LoadTimes.compile = MicrosecondsSince(start);
 	if (!m_pRuntime) {
 		EvictWithError(Plugin_BadLoad, "Unable to load plugin (%s)", loadmsg);
 		return false;
@@ -961,7 +977,10 @@ LoadRes CPluginManager::LoadPlugin(CPlugin **aResult, const char *path, bool deb
 	if (plugin->GetStatus() != Plugin_Created)
 		return LoadRes_Failure;
 
-	if (plugin->AskPluginLoad() != APLRes_Success)
+	auto start = std::chrono::steady_clock::now();
+	APLRes res = plugin->AskPluginLoad();
+	plugin->LoadTimes().askload = MicrosecondsSince(start);
+	if (res != APLRes_Success)
 		return LoadRes_Failure;
 
 	LoadExtensions(plugin);
@@ -1344,7 +1363,10 @@ bool CPluginManager::RunSecondPass(CPlugin *pPlugin)
 		(*iter)->OnPluginLoaded(pPlugin);
 
 	// Tell this plugin to finish initializing itself.
-	if (!pPlugin->OnPluginStart())
+	auto start = std::chrono::steady_clock::now();
+	bool started = pPlugin->OnPluginStart();
+	pPlugin->LoadTimes().start = MicrosecondsSince(start);
+	if (!started)
 		return false;
 
 	// Now, if we have fake natives, go through all plugins that might need rebinding.
@@ -1983,6 +2005,51 @@ void CPluginManager::OnRootConsoleCommand(const char *cmdname, const ICommandArg
 			}
 			return;
 		}
+		else if (strcmp(cmd, "load_times") == 0)
+		{
+			if (!GetPluginCount())
+			{
+				rootmenu->ConsolePrint("[SM] No plugins loaded");
+				return;
+			}
+
+			rootmenu->ConsolePrint("[SM] Plugin load times (ms):");
+			rootmenu->ConsolePrint("  %-4s %8s %8s %8s %8s  %s", "#", "compile", "askload", "start", "total", "file");
+
+			PluginLoadTimes sum;
+			memset(&sum, 0, sizeof(sum));
+
+			unsigned int id = 1;
+			for (PluginIter iter(m_plugins); !iter.done(); iter.next(), id++) {
+				CPlugin *pl = (*iter);
+				const PluginLoadTimes &t = pl->LoadTimes();
+				int64_t total = t.compile + t.askload + t.start;
+				rootmenu->ConsolePrint("  %-4d %8.2f %8.2f %8.2f %8.2f  %s",
+					id,
+					t.compile / 1000.0,
+					t.askload / 1000.0,
+					t.start / 1000.0,
+					total / 1000.0,
+					pl->GetFilename());
+
+				sum.compile += t.compile;
+				sum.askload += t.askload;
+				sum.start += t.start;
+			}
+
+			rootmenu->ConsolePrint("  %-4s %8.2f %8.2f %8.2f %8.2f",
+				"",
+				sum.compile / 1000.0,
+				sum.askload / 1000.0,
+				sum.start / 1000.0,
+				(sum.compile + sum.askload + sum.start) / 1000.0);
+			return;
+		}
+		else if (strcmp(cmd, "mem") == 0)
+		{
+			g_PluginMemory.OnRootConsoleCommand(command);
+			return;
+		}
 		else if (strcmp(cmd, "refresh") == 0)
 		{
 			RefreshAll();
@@ -2061,7 +2128,9 @@ void CPluginManager::OnRootConsoleCommand(const char *cmdname, const ICommandArg
 	rootmenu->DrawGenericOption("list", "Show loaded plugins");
 	rootmenu->DrawGenericOption("load", "Load a plugin");
 	rootmenu->DrawGenericOption("load_lock", "Prevents any more plugins from being loaded");
+	rootmenu->DrawGenericOption("load_times", "Show how long each plugin took to load");
 	rootmenu->DrawGenericOption("load_unlock", "Re-enables plugin loading");
+	rootmenu->DrawGenericOption("mem", "Show approximate memory held by each plugin");
 	rootmenu->DrawGenericOption("refresh", "Reloads/refreshes all plugins in the plugins folder");
 	rootmenu->DrawGenericOption("reload", "Reloads a plugin");
 	rootmenu->DrawGenericOption("unload", "Unload a plugin");
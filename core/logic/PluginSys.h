@@ -95,6 +95,14 @@ enum class PluginState
 	WaitingToUnloadAndReload,
 };
 
+// Time spent in each phase of loading a plugin, in microseconds.
+struct PluginLoadTimes
+{
+	int64_t compile;	// Loading the image into the VM
+	int64_t askload;	// AskPluginLoad
+	int64_t start;		// OnPluginStart
+};
+
 class CPlugin : 
 	public SMPlugin,
 	public CNativeOwner
@@ -244,6 +252,10 @@ public:
 	bool TryCompile();
 	void BindFakeNativesTo(CPlugin *other);
 
+	PluginLoadTimes &LoadTimes() {
+		return m_LoadTimes;
+	}
+
 protected:
 	void DependencyDropped(CPlugin *pOwner);
 
@@ -285,6 +297,7 @@ private:
 	time_t m_LastFileModTime;
 	Handle_t m_handle;
 	char m_DateTime[256];
+	PluginLoadTimes m_LoadTimes;
 
 	// Cached.
 	sm_plugininfo_t m_info;
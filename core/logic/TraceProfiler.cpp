@@ -0,0 +1,324 @@
+// vim: set ts=4 sw=4 tw=99 noet :
+// =============================================================================
+// SourceMod
+// Copyright (C) 2004-2026 AlliedModders LLC.  All rights reserved.
+// =============================================================================
+//
+// This program is free software; you can redistribute it and/or modify it under
+// the terms of the GNU General Public License, version 3.0, as published by the
+// Free Software Foundation.
+// 
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// As a special exception, AlliedModders LLC gives you permission to link the
+// code of this program (as well as its derivative works) to "Half-Life 2," the
+// "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+// by the Valve Corporation.  You must obey the GNU General Public License in
+// all respects for all other code used.  Additionally, AlliedModders LLC grants
+// this exception to all derivative works.  AlliedModders LLC defines further
+// exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+// or <http://www.sourcemod.net/license.php>.
+#include "TraceProfiler.h"
+#include "ProfileTools.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <map>
+#include <ISourceMod.h>
+#include <IRootConsoleMenu.h>
+
+// 1M events, 16MB. Older events are overwritten once the buffer is full.
+static const size_t kMaxEvents = 1 << 20;
+
+TraceProfiler g_TraceProfiler;
+
+TraceProfiler::TraceProfiler()
+	: active_(false),
+	  recorded_(0)
+{
+}
+
+void
+TraceProfiler::OnSourceModAllInitialized()
+{
+	g_ProfileToolManager.RegisterTool(this);
+}
+
+void
+TraceProfiler::OnSourceModShutdown()
+{
+	active_ = false;
+	events_ = std::vector<Event>();
+}
+
+const char *
+TraceProfiler::Name()
+{
+	return "trace";
+}
+
+const char *
+TraceProfiler::Description()
+{
+	return "Records native, function and forward calls for offline analysis";
+}
+
+bool
+TraceProfiler::Start()
+{
+	events_.resize(kMaxEvents);
+	recorded_ = 0;
+	start_ = std::chrono::steady_clock::now();
+	active_ = true;
+	return true;
+}
+
+void
+TraceProfiler::Stop(void (*render)(const char *fmt, ...))
+{
+	active_ = false;
+
+	uint64_t kept = recorded_ < events_.size() ? recorded_ : events_.size();
+	render("Recorded %llu events (%llu kept).", (unsigned long long)recorded_, (unsigned long long)kept);
+	RenderHelp(render);
+}
+
+bool
+TraceProfiler::IsActive()
+{
+	return active_;
+}
+
+bool
+TraceProfiler::IsAttached()
+{
+	return true;
+}
+
+uint32_t
+TraceProfiler::InternScope(const char *group, const char *name)
+{
+	if (!group)
+		group = "";
+
+	// Names are usually owned by a plugin or forward, so the pointer is only
+	// a hint: check the text too in case the memory was reused.
+	auto iter = scope_ptrs_.find(name);
+	if (iter != scope_ptrs_.end()) {
+		const Scope &scope = scopes_[iter->second];
+		if (scope.name == name && scope.group == group)
+			return iter->second;
+	}
+
+	std::string key(group);
+	key.push_back('\0');
+	key.append(name);
+
+	uint32_t id;
+	auto known = scope_ids_.find(key);
+	if (known != scope_ids_.end()) {
+		id = known->second;
+	} else {
+		id = (uint32_t)scopes_.size();
+		scopes_.push_back(Scope{group, name});
+		scope_ids_.emplace(key, id);
+	}
+	scope_ptrs_[name] = id;
+	return id;
+}
+
+void
+TraceProfiler::Record(uint32_t scope)
+{
+	auto elapsed = std::chrono::steady_clock::now() - start_;
+
+	Event &event = events_[recorded_ % events_.size()];
+	event.time = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+	event.scope = scope;
+	recorded_++;
+}
+
+void
+TraceProfiler::EnterScope(const char *group, const char *name)
+{
+	if (!active_ || !name)
+		return;
+	Record(InternScope(group, name));
+}
+
+void
+TraceProfiler::LeaveScope()
+{
+	if (!active_)
+		return;
+	Record(kLeave);
+}
+
+// Replays the retained events as balanced scopes. Leaves whose enter was
+// overwritten are dropped, and scopes still open at the end are closed at
+// the last timestamp.
+struct TraceFrame {
+	uint32_t scope;
+	int64_t start;
+	int64_t children;
+};
+
+template <typename T>
+void
+TraceProfiler::ForEachEvent(const T &callback)
+{
+	if (events_.empty())
+		return;
+
+	uint64_t count = recorded_ < events_.size() ? recorded_ : events_.size();
+	uint64_t first = recorded_ - count;
+
+	std::vector<TraceFrame> stack;
+	int64_t last = 0;
+	for (uint64_t i = first; i < recorded_; i++) {
+		const Event &event = events_[i % events_.size()];
+		last = event.time;
+
+		if (event.scope != kLeave) {
+			stack.push_back(TraceFrame{event.scope, event.time, 0});
+			callback(stack, event.time, true);
+			continue;
+		}
+
+		if (stack.empty())
+			continue;
+		callback(stack, event.time, false);
+		int64_t total = event.time - stack.back().start;
+		stack.pop_back();
+		if (!stack.empty())
+			stack.back().children += total;
+	}
+
+	while (!stack.empty()) {
+		callback(stack, last, false);
+		int64_t total = last - stack.back().start;
+		stack.pop_back();
+		if (!stack.empty())
+			stack.back().children += total;
+	}
+}
+
+static void
+WriteJsonString(FILE *fp, const std::string &str)
+{
+	fputc('"', fp);
+	for (size_t i = 0; i < str.size(); i++) {
+		unsigned char c = str[i];
+		if (c == '"' || c == '\\')
+			fprintf(fp, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(fp, "\\u%04x", c);
+		else
+			fputc(c, fp);
+	}
+	fputc('"', fp);
+}
+
+bool
+TraceProfiler::WriteChromeTrace(const char *path)
+{
+	FILE *fp = fopen(path, "wt");
+	if (!fp)
+		return false;
+
+	bool first = true;
+	fprintf(fp, "{\"traceEvents\":[\n");
+	ForEachEvent([&](const std::vector<TraceFrame> &stack, int64_t time, bool enter) -> void {
+		const Scope &scope = scopes_[stack.back().scope];
+		fprintf(fp, "%s{\"ph\":\"%c\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"name\":",
+			first ? "" : ",\n",
+			enter ? 'B' : 'E',
+			time / 1000.0);
+		WriteJsonString(fp, scope.name);
+		fprintf(fp, ",\"cat\":");
+		WriteJsonString(fp, scope.group);
+		fputc('}', fp);
+		first = false;
+	});
+	fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	fclose(fp);
+	return true;
+}
+
+bool
+TraceProfiler::WriteFoldedStacks(const char *path)
+{
+	// Self time in nanoseconds for each unique call stack. Summed before
+	// converting so that sub-microsecond calls still add up.
+	std::map<std::string, int64_t> stacks;
+	ForEachEvent([&](const std::vector<TraceFrame> &stack, int64_t time, bool enter) -> void {
+		if (enter)
+			return;
+
+		std::string key;
+		for (size_t i = 0; i < stack.size(); i++) {
+			const Scope &scope = scopes_[stack[i].scope];
+			if (i)
+				key.push_back(';');
+			if (!scope.group.empty()) {
+				key.append(scope.group);
+				key.append("::");
+			}
+			key.append(scope.name);
+		}
+
+		const TraceFrame &frame = stack.back();
+		stacks[key] += time - frame.start - frame.children;
+	});
+
+	FILE *fp = fopen(path, "wt");
+	if (!fp)
+		return false;
+
+	for (auto iter = stacks.begin(); iter != stacks.end(); iter++)
+		fprintf(fp, "%s %lld\n", iter->first.c_str(), (long long)(iter->second / 1000));
+
+	fclose(fp);
+	return true;
+}
+
+void
+TraceProfiler::Dump()
+{
+	if (!recorded_) {
+		rootmenu->ConsolePrint("No trace events have been recorded.");
+		return;
+	}
+
+	char date[32];
+	time_t t = time(nullptr);
+	strftime(date, sizeof(date), "%Y%m%d_%H%M%S", localtime(&t));
+
+	char path[PLATFORM_MAX_PATH];
+	g_pSM->BuildPath(Path_SM, path, sizeof(path), "logs/trace_%s.json", date);
+	if (WriteChromeTrace(path))
+		rootmenu->ConsolePrint("Wrote Chrome trace to %s", path);
+	else
+		rootmenu->ConsolePrint("Could not open %s for writing.", path);
+
+	g_pSM->BuildPath(Path_SM, path, sizeof(path), "logs/trace_%s.folded", date);
+	if (WriteFoldedStacks(path))
+		rootmenu->ConsolePrint("Wrote folded stacks to %s", path);
+	else
+		rootmenu->ConsolePrint("Could not open %s for writing.", path);
+}
+
+void
+TraceProfiler::RenderHelp(void (*render)(const char *fmt, ...))
+{
+	render("Use 'sm prof dump trace' to write the session to logs/. The .json file can be");
+	render("loaded in chrome://tracing or Perfetto, and the .folded file can be passed to");
+	render("flamegraph.pl or speedscope.");
+}
@@ -0,0 +1,98 @@
+// vim: set ts=4 sw=4 tw=99 noet :
+// =============================================================================
+// SourceMod
+// Copyright (C) 2004-2026 AlliedModders LLC.  All rights reserved.
+// =============================================================================
+//
+// This program is free software; you can redistribute it and/or modify it under
+// the terms of the GNU General Public License, version 3.0, as published by the
+// Free Software Foundation.
+// 
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// As a special exception, AlliedModders LLC gives you permission to link the
+// code of this program (as well as its derivative works) to "Half-Life 2," the
+// "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+// by the Valve Corporation.  You must obey the GNU General Public License in
+// all respects for all other code used.  Additionally, AlliedModders LLC grants
+// this exception to all derivative works.  AlliedModders LLC defines further
+// exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+// or <http://www.sourcemod.net/license.php>.
+#ifndef _include_sourcemod_logic_trace_profiler_h_
+#define _include_sourcemod_logic_trace_profiler_h_
+
+#include <sp_vm_api.h>
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "common_logic.h"
+
+using namespace SourcePawn;
+
+// Records every profiling scope (natives, plugin functions, forwards) into a
+// ring buffer with high resolution timestamps, so a session can be exported
+// and analyzed offline as a Chrome trace or as folded stacks for flamegraphs.
+class TraceProfiler
+	: public IProfilingTool,
+	  public SMGlobalClass
+{
+public:
+	TraceProfiler();
+
+	// IProfilingTool
+	const char *Name() override;
+	const char *Description() override;
+	bool Start() override;
+	void Stop(void (*render)(const char *fmt, ...)) override;
+	void Dump() override;
+	bool IsActive() override;
+	bool IsAttached() override;
+	void EnterScope(const char *group, const char *name) override;
+	void LeaveScope() override;
+	void RenderHelp(void (*render)(const char *fmt, ...)) override;
+
+	// SMGlobalClass
+	void OnSourceModAllInitialized() override;
+	void OnSourceModShutdown() override;
+
+private:
+	struct Event {
+		int64_t time;		// Nanoseconds since the session started.
+		uint32_t scope;		// Index into scopes_, or kLeave.
+	};
+	struct Scope {
+		std::string group;
+		std::string name;
+	};
+
+	uint32_t InternScope(const char *group, const char *name);
+	void Record(uint32_t scope);
+	bool WriteChromeTrace(const char *path);
+	bool WriteFoldedStacks(const char *path);
+
+	template <typename T>
+	void ForEachEvent(const T &callback);
+
+private:
+	static const uint32_t kLeave = 0xffffffff;
+
+	bool active_;
+	std::chrono::steady_clock::time_point start_;
+	std::vector<Event> events_;
+	uint64_t recorded_;
+	std::vector<Scope> scopes_;
+	std::unordered_map<std::string, uint32_t> scope_ids_;
+	std::unordered_map<const char *, uint32_t> scope_ptrs_;
+};
+
+extern TraceProfiler g_TraceProfiler;
+
+#endif // _include_sourcemod_logic_trace_profiler_h_
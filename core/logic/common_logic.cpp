@@ -148,6 +148,8 @@ static const char* GetEntityLumpString()
 
 // Defined in smn_filesystem.cpp.
 extern bool OnLogPrint(const char *msg);
+extern bool QueueFileTask(const char *path, IdentityToken_t *owner, IFileTask *task);
+extern void RunFileTaskNow(const char *path, IFileTask *task);
 
 class ProviderCallbackListener : public IProviderCallbacks
 {
@@ -230,6 +232,8 @@ static sm_logic_t logic =
 	logic_shutdown,
 	logic_SetJitEnabled,
 	logic_SetDebugMetadataFlags,
+	QueueFileTask,
+	RunFileTaskNow,
 	&g_PluginSys,
 	&g_ShareSys,
 	&g_Extensions,
@@ -382,6 +382,8 @@ static cell_t SetArrayCell(IPluginContext *pContext, const cell_t *params)
 		*((char *)blk + idx) = (char)params[3];
 	}
 
+	array->reindex((size_t)params[2]);
+
 	return 1;
 }
 
@@ -426,7 +428,10 @@ static cell_t SetArrayString(IPluginContext *pContext, const cell_t *params)
 		maxlength = (size_t)params[4];
 	}
 
-	return strncopy((char*)blk, str, maxlength);
+	size_t written = strncopy((char*)blk, str, maxlength);
+	array->reindex(idx);
+
+	return written;
 }
 
 static cell_t SetArrayArray(IPluginContext *pContext, const cell_t *params)
@@ -470,6 +475,7 @@ static cell_t SetArrayArray(IPluginContext *pContext, const cell_t *params)
 	pContext->LocalToPhysAddr(params[3], &addr);
 
 	memcpy(blk, addr, sizeof(cell_t) * indexes);
+	array->reindex(idx);
 
 	return indexes;
 }
@@ -575,6 +581,23 @@ static cell_t CloneArray(IPluginContext *pContext, const cell_t *params)
 	return hndl;
 }
 
+// Same start index rules as the linear searches below.
+template <typename T>
+static cell_t FindIndexed(CellArray *array, T key, int startidx, bool reverse)
+{
+	size_t start;
+	if (reverse)
+	{
+		start = (startidx < 0) ? array->size() : (size_t)startidx;
+	}
+	else
+	{
+		start = (startidx < -1) ? 0 : (size_t)(startidx + 1);
+	}
+
+	return array->find_indexed(key, start, reverse);
+}
+
 static cell_t FindStringInArray(IPluginContext *pContext, const cell_t *params)
 {
 	CellArray *array;
@@ -616,11 +639,19 @@ static cell_t FindStringInArray(IPluginContext *pContext, const cell_t *params)
 	}
 
 	typedef int (*STRCOMPARE)(const char *, const char *);
-	STRCOMPARE comparefn = (params[0] < 6 || params[6]) ? strcmp : strcasecmp;
+	bool caseSensitive = (params[0] < 6 || params[6]);
+	STRCOMPARE comparefn = caseSensitive ? strcmp : strcasecmp;
 
 	char *str;
 	pContext->LocalToString(params[2], &str);
 
+	if (caseSensitive
+		&& array->index_type() == CellArray::Index_String
+		&& array->index_block() == blocknumber)
+	{
+		return FindIndexed(array, str, startidx, reverse);
+	}
+
 	if (reverse)
 	{
 		if (startidx < 0)
@@ -695,6 +726,11 @@ static cell_t FindValueInArray(IPluginContext *pContext, const cell_t *params)
 		reverse = params[5];
 	}
 
+	if (array->index_type() == CellArray::Index_Cell && array->index_block() == blocknumber)
+	{
+		return FindIndexed(array, params[2], startidx, reverse);
+	}
+
 	if (reverse)
 	{
 		if (startidx < 0)
@@ -729,6 +765,48 @@ static cell_t FindValueInArray(IPluginContext *pContext, const cell_t *params)
 	return -1;
 }
 
+static cell_t SetArrayIndex(IPluginContext *pContext, const cell_t *params, CellArray::IndexType type)
+{
+	CellArray *array;
+	HandleError err;
+	HandleSecurity sec(pContext->GetIdentity(), g_pCoreIdent);
+
+	if ((err = handlesys->ReadHandle(params[1], htCellArray, &sec, (void **)&array))
+		!= HandleError_None)
+	{
+		return pContext->ThrowNativeError("Invalid Handle %x (error: %d)", params[1], err);
+	}
+
+	size_t blocknumber = 0;
+	if (type != CellArray::Index_None)
+	{
+		blocknumber = (size_t)params[2];
+		if (blocknumber >= array->blocksize())
+		{
+			return pContext->ThrowNativeError("Invalid block %d (blocksize: %d)", blocknumber, array->blocksize());
+		}
+	}
+
+	array->set_index(type, blocknumber);
+
+	return 1;
+}
+
+static cell_t IndexArrayStrings(IPluginContext *pContext, const cell_t *params)
+{
+	return SetArrayIndex(pContext, params, CellArray::Index_String);
+}
+
+static cell_t IndexArrayValues(IPluginContext *pContext, const cell_t *params)
+{
+	return SetArrayIndex(pContext, params, CellArray::Index_Cell);
+}
+
+static cell_t ClearArrayIndex(IPluginContext *pContext, const cell_t *params)
+{
+	return SetArrayIndex(pContext, params, CellArray::Index_None);
+}
+
 static cell_t GetArrayBlockSize(IPluginContext *pContext, const cell_t *params)
 {
 	CellArray *array;
@@ -788,6 +866,9 @@ REGISTER_NATIVES(cellArrayNatives)
 	{"ArrayList.FindString",		FindStringInArray},
 	{"ArrayList.FindValue",			FindValueInArray},
 	{"ArrayList.BlockSize.get",		GetArrayBlockSize},
+	{"ArrayList.IndexStrings",		IndexArrayStrings},
+	{"ArrayList.IndexValues",		IndexArrayValues},
+	{"ArrayList.ClearIndex",		ClearArrayIndex},
 
 	{NULL,							NULL},
 };
@@ -29,6 +29,7 @@
  * Version: $Id$
  */
 
+#include <algorithm>
 #include <assert.h>
 #include <atomic>
 #include <condition_variable>
@@ -38,6 +39,7 @@
 #include <string.h>
 #include <filesystem>
 #include <limits>
+#include <list>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -58,6 +60,9 @@
 #include "handle_helpers.h"
 #include <bridge/include/IFileSystemBridge.h>
 #include <bridge/include/CoreProvider.h>
+#include <bridge/include/LogicProvider.h>
+
+#include "CellArray.h"
 
 #if defined PLATFORM_WINDOWS
 #include <io.h>
@@ -71,8 +76,19 @@
 #define FPERM_O_READ		0x0004	/* Anyone can read. */
 #define FPERM_O_WRITE		0x0002	/* Anyone can write. */
 #define FPERM_O_EXEC		0x0001	/* Anyone can exec. */
+#elif defined PLATFORM_POSIX
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
+// Largest stdio buffer a plugin can ask OpenFile() for.
+static const cell_t kMaxFileBufferSize = 16 * 1024 * 1024;
+
+// On POSIX, "m" files up to this size are copied into memory; larger ones are
+// read through stdio with a buffer of kMappedFallbackBufferSize.
+static const size_t kMaxMappedCopySize = 16 * 1024 * 1024;
+static const size_t kMappedFallbackBufferSize = 1024 * 1024;
+
 HandleType_t g_FileType;
 HandleType_t g_DirType;
 HandleType_t g_ValveDirType;
@@ -190,7 +206,7 @@ public:
 		Close();
 	}
 
-	static SystemFile *Open(const char *path, const char *mode) {
+	static SystemFile *Open(const char *path, const char *mode, size_t buffer_size = 0) {
 #if defined(_WIN32)
 		static thread_local bool invalid_fopen = false;
 		static auto handler = [](const wchar_t*, const wchar_t*, const wchar_t*, unsigned int, uintptr_t) { invalid_fopen = true; };
@@ -206,6 +222,8 @@ public:
 
 		if (!fp)
 			return NULL;
+		if (buffer_size)
+			setvbuf(fp, NULL, _IOFBF, buffer_size);
 		return new SystemFile(fp);
 	}
 
@@ -278,6 +296,187 @@ private:
 	FILE *fp_;
 };
 
+// Read-only file held in memory as a whole, so reads are plain copies
+// instead of stdio calls.
+//
+// On Windows the file is mapped; the OS refuses to truncate a file while a
+// view of it exists. On POSIX another process may truncate a mapped file, and
+// touching the lost pages raises SIGBUS, so the file is instead read into a
+// private copy when it is opened. Files larger than kMaxMappedCopySize fall
+// back to a SystemFile with a large buffer.
+class MappedFile : public FileObject
+{
+public:
+	~MappedFile() {
+		Close();
+	}
+
+	static FileObject *Open(const char *path, const char *sysmode) {
+		MappedFile *file = new MappedFile();
+#if defined PLATFORM_WINDOWS
+		HANDLE hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hFile == INVALID_HANDLE_VALUE) {
+			delete file;
+			return NULL;
+		}
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(hFile, &size) || size.QuadPart > std::numeric_limits<int>::max()) {
+			CloseHandle(hFile);
+			delete file;
+			return NULL;
+		}
+
+		file->size_ = (size_t)size.QuadPart;
+		if (file->size_) {
+			HANDLE hMap = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (hMap)
+				file->data_ = (const char *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+			if (hMap)
+				CloseHandle(hMap);
+		}
+		CloseHandle(hFile);
+#elif defined PLATFORM_POSIX
+		int fd = open(path, O_RDONLY);
+		if (fd == -1) {
+			delete file;
+			return NULL;
+		}
+
+		struct stat s;
+		if (fstat(fd, &s) != 0 || !S_ISREG(s.st_mode) || s.st_size > std::numeric_limits<int>::max()) {
+			close(fd);
+			delete file;
+			return NULL;
+		}
+
+		if ((size_t)s.st_size > kMaxMappedCopySize) {
+			close(fd);
+			delete file;
+			return SystemFile::Open(path, sysmode, kMappedFallbackBufferSize);
+		}
+
+		file->copy_.resize((size_t)s.st_size);
+		while (file->size_ < file->copy_.size()) {
+			ssize_t got = read(fd, &file->copy_[file->size_], file->copy_.size() - file->size_);
+			if (got < 0 && errno == EINTR)
+				continue;
+			if (got <= 0)
+				break;
+			file->size_ += (size_t)got;
+		}
+		close(fd);
+
+		// The file may have shrunk since fstat(); keep what was read.
+		if (file->size_)
+			file->data_ = file->copy_.data();
+#endif
+
+		if (file->size_ && !file->data_) {
+			delete file;
+			return NULL;
+		}
+		return file;
+	}
+
+	size_t Size() override {
+		return size_;
+	}
+	size_t Read(void *pOut, int size) override {
+		if (size <= 0)
+			return 0;
+		size_t count = std::min((size_t)size, Remaining());
+		if (count)
+			memcpy(pOut, data_ + pos_, count);
+		pos_ += count;
+		if (count < (size_t)size)
+			eof_ = true;
+		return count;
+	}
+	char *ReadLine(char *pOut, int size) override {
+		// Same contract as fgets().
+		if (size <= 0)
+			return NULL;
+		if (!Remaining()) {
+			eof_ = true;
+			return NULL;
+		}
+
+		size_t count = std::min((size_t)size - 1, Remaining());
+		const char *newline = (const char *)memchr(data_ + pos_, '\n', count);
+		if (newline)
+			count = newline - (data_ + pos_) + 1;
+
+		memcpy(pOut, data_ + pos_, count);
+		pOut[count] = '\0';
+		pos_ += count;
+		return pOut;
+	}
+	size_t Write(const void *pData, int size) override {
+		error_ = true;
+		return 0;
+	}
+	bool Seek(int pos, int seek_type) override {
+		int64_t base;
+		if (seek_type == SEEK_SET)
+			base = 0;
+		else if (seek_type == SEEK_CUR)
+			base = (int64_t)pos_;
+		else if (seek_type == SEEK_END)
+			base = (int64_t)size_;
+		else
+			return false;
+
+		if (base + pos < 0)
+			return false;
+		pos_ = (size_t)(base + pos);
+		eof_ = false;
+		return true;
+	}
+	int Tell() override {
+		return (int)pos_;
+	}
+	bool Flush() override {
+		return true;
+	}
+	bool HasError() override {
+		return error_;
+	}
+	bool EndOfFile() override {
+		return eof_;
+	}
+	void Close() override {
+		if (!data_)
+			return;
+#if defined PLATFORM_WINDOWS
+		UnmapViewOfFile(data_);
+#elif defined PLATFORM_POSIX
+		std::vector<char>().swap(copy_);
+#endif
+		data_ = nullptr;
+		size_ = 0;
+		pos_ = 0;
+	}
+
+private:
+	MappedFile() = default;
+
+	size_t Remaining() const {
+		return pos_ < size_ ? size_ - pos_ : 0;
+	}
+
+private:
+	const char *data_ = nullptr;
+#if defined PLATFORM_POSIX
+	std::vector<char> copy_;
+#endif
+	size_t size_ = 0;
+	size_t pos_ = 0;
+	bool eof_ = false;
+	bool error_ = false;
+};
+
 enum FileAsyncResult
 {
 	FileAsync_Success = 0,
@@ -298,6 +497,16 @@ enum FileAsyncOperation
 	FileAsync_Read,
 	FileAsync_Write,
 	FileAsync_OpenDirectory,
+	FileAsync_External,
+};
+
+// Reads and metadata queries usually gate something a plugin is waiting on,
+// so they are started ahead of writes, which go ahead of bulk copies.
+enum FileAsyncPriority
+{
+	FileAsyncPriority_Low,
+	FileAsyncPriority_Normal,
+	FileAsyncPriority_High,
 };
 
 enum FileAsyncCallback
@@ -373,6 +582,20 @@ public:
 	   contents_(std::move(contents)), append_(append), cancelled_(false), valve_(valve),
 	   pathID_(pathID ? pathID : ""), other_pathID_(other_pathID ? other_pathID : "")
 	{
+		keys_.push_back(PathKey(realpath_));
+		if (!other_realpath_.empty())
+		{
+			std::string other = PathKey(other_realpath_);
+			if (other != keys_[0])
+				keys_.push_back(std::move(other));
+		}
+	}
+
+	// Wraps work queued by core; the task takes ownership of it.
+	FileAsyncTask(IFileTask *external, IdentityToken_t *owner, const char *realpath)
+	 : FileAsyncTask(FileAsync_External, FileAsync_ResultCallback, nullptr, owner, realpath, realpath, 0)
+	{
+		external_.reset(external);
 	}
 
 	void Run()
@@ -422,6 +645,10 @@ public:
 				case FileAsync_OpenDirectory:
 					OpenDirectory();
 					break;
+				case FileAsync_External:
+					external_->Run();
+					result_ = FileAsync_Success;
+					break;
 			}
 		}
 		catch (...)
@@ -433,6 +660,12 @@ public:
 
 	void Deliver()
 	{
+		if (external_)
+		{
+			if (!cancelled_)
+				external_->Complete();
+			return;
+		}
 		if (cancelled_ || !function_->IsRunnable())
 			return;
 
@@ -474,6 +707,57 @@ public:
 		cancelled_ = true;
 	}
 
+	bool external() const
+	{
+		return !!external_;
+	}
+
+	// Paths this task touches. Tasks whose keys overlap (the same path, or one
+	// beneath the other) run in submission order.
+	const std::vector<std::string> &keys() const
+	{
+		return keys_;
+	}
+
+	FileAsyncPriority priority() const
+	{
+		switch (operation_)
+		{
+			case FileAsync_FileExists:
+			case FileAsync_DirExists:
+			case FileAsync_FileSize:
+			case FileAsync_Read:
+			case FileAsync_OpenDirectory:
+				return FileAsyncPriority_High;
+			case FileAsync_Copy:
+				return FileAsyncPriority_Low;
+			default:
+				return FileAsyncPriority_Normal;
+		}
+	}
+
+	// Normalizes separators so that keys can be compared as path prefixes.
+	static std::string PathKey(const std::string &path)
+	{
+		std::string key;
+		key.reserve(path.size());
+		for (char ch : path)
+		{
+#ifdef PLATFORM_WINDOWS
+			if (ch == '\\')
+				ch = '/';
+			else
+				ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+#endif
+			if (ch == '/' && !key.empty() && key.back() == '/')
+				continue;
+			key.push_back(ch);
+		}
+		while (key.size() > 1 && key.back() == '/')
+			key.pop_back();
+		return key;
+	}
+
 private:
 	static FileAsyncResult ResultFromErrno()
 	{
@@ -791,14 +1075,21 @@ private:
 	bool valve_;
 	std::string pathID_;
 	std::string other_pathID_;
+	std::vector<std::string> keys_;
+	std::unique_ptr<IFileTask> external_;
 };
 
+// Number of threads servicing non-Valve and Valve-worker async tasks. Tasks
+// touching the same path still run one at a time, in submission order.
+static const size_t kFileAsyncWorkers = 4;
+
 class FileAsyncWorker
 {
 public:
 	void Start()
 	{
-		thread_ = ke::NewThread("SM File Async", [this] { ThreadMain(); });
+		for (size_t i = 0; i < kFileAsyncWorkers; i++)
+			threads_.push_back(ke::NewThread("SM File Async", [this] { ThreadMain(); }));
 	}
 
 	void Shutdown()
@@ -809,11 +1100,17 @@ public:
 			for (FileAsyncTask *task : tasks_)
 				task->Cancel();
 		}
-		condition_.notify_one();
-		if (thread_)
+		condition_.notify_all();
+		for (auto &thread : threads_)
+			thread->join();
+		threads_.clear();
+
+		// Work from core, such as KeyValues saves, must still reach the disk.
+		// Running it here, in order, keeps the per-path ordering.
+		for (FileAsyncTask *task : pending_)
 		{
-			thread_->join();
-			thread_.reset();
+			if (task->external())
+				task->Run();
 		}
 
 		std::lock_guard<std::mutex> lock(mutex_);
@@ -822,6 +1119,7 @@ public:
 		tasks_.clear();
 		pending_.clear();
 		completed_.clear();
+		busy_.clear();
 	}
 
 	bool Enqueue(FileAsyncTask *task)
@@ -835,6 +1133,31 @@ public:
 		return true;
 	}
 
+	// Runs a task on the calling thread once every earlier task on an
+	// overlapping path has finished, and holds back later ones until it is
+	// done. Used by core for synchronous reads and writes.
+	void RunNow(const char *realpath, IFileTask *task)
+	{
+		std::string key = FileAsyncTask::PathKey(realpath);
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			condition_.wait(lock, [this, &key] {
+				return stopping_ || (!OverlapsAny(key, busy_) && !PendingOverlaps(key));
+			});
+			busy_.push_back(key);
+		}
+
+		task->Run();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto iter = std::find(busy_.begin(), busy_.end(), key);
+			if (iter != busy_.end())
+				busy_.erase(iter);
+		}
+		condition_.notify_all();
+	}
+
 	void ProcessCompleted()
 	{
 		std::deque<FileAsyncTask *> completed;
@@ -870,27 +1193,106 @@ private:
 			FileAsyncTask *task;
 			{
 				std::unique_lock<std::mutex> lock(mutex_);
-				condition_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+				auto next = pending_.end();
+				condition_.wait(lock, [this, &next] {
+					if (stopping_)
+						return true;
+					next = NextRunnable();
+					return next != pending_.end();
+				});
 				if (stopping_)
 					return;
-				task = pending_.front();
-				pending_.pop_front();
+				task = *next;
+				pending_.erase(next);
+				for (const std::string &key : task->keys())
+					busy_.push_back(key);
 			}
 
 			task->Run();
 
-			std::lock_guard<std::mutex> lock(mutex_);
-			completed_.push_back(task);
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				for (const std::string &key : task->keys())
+					busy_.erase(std::find(busy_.begin(), busy_.end(), key));
+				completed_.push_back(task);
+			}
+			condition_.notify_all();
+		}
+	}
+
+	// True if the paths are the same or one lies beneath the other, so that
+	// creating, removing or renaming a directory is ordered against every
+	// task on a path inside it.
+	static bool PathsOverlap(const std::string &a, const std::string &b)
+	{
+		const std::string &shorter = a.size() <= b.size() ? a : b;
+		const std::string &longer = a.size() <= b.size() ? b : a;
+		if (longer.compare(0, shorter.size(), shorter) != 0)
+			return false;
+		return longer.size() == shorter.size()
+			|| longer[shorter.size()] == '/'
+			|| (!shorter.empty() && shorter.back() == '/');
+	}
+
+	static bool OverlapsAny(const std::string &key, const std::vector<std::string> &keys)
+	{
+		for (const std::string &other : keys)
+		{
+			if (PathsOverlap(key, other))
+				return true;
 		}
+		return false;
+	}
+
+	bool PendingOverlaps(const std::string &key)
+	{
+		for (FileAsyncTask *task : pending_)
+		{
+			if (OverlapsAny(key, task->keys()))
+				return true;
+		}
+		return false;
+	}
+
+	// Picks the highest priority pending task that can start now. A task is
+	// held back while an earlier task on an overlapping path is pending or
+	// running.
+	std::list<FileAsyncTask *>::iterator NextRunnable()
+	{
+		auto best = pending_.end();
+
+		std::vector<std::string> blocked;
+		for (auto iter = pending_.begin(); iter != pending_.end(); ++iter)
+		{
+			FileAsyncTask *task = *iter;
+
+			bool runnable = true;
+			for (const std::string &key : task->keys())
+			{
+				if (OverlapsAny(key, busy_) || OverlapsAny(key, blocked))
+					runnable = false;
+			}
+			blocked.insert(blocked.end(), task->keys().begin(), task->keys().end());
+			if (!runnable)
+				continue;
+			if (best == pending_.end() || task->priority() > (*best)->priority())
+			{
+				best = iter;
+				if (task->priority() == FileAsyncPriority_High)
+					break;
+			}
+		}
+		return best;
 	}
 
 private:
 	std::mutex mutex_;
 	std::condition_variable condition_;
-	std::unique_ptr<std::thread> thread_;
-	std::deque<FileAsyncTask *> pending_;
+	std::vector<std::unique_ptr<std::thread>> threads_;
+	std::list<FileAsyncTask *> pending_;
 	std::deque<FileAsyncTask *> completed_;
 	std::unordered_set<FileAsyncTask *> tasks_;
+	std::vector<std::string> busy_;
 	bool stopping_ = false;
 };
 
@@ -1161,6 +1563,10 @@ public:
 	{
 		return m_AsyncWorker.Enqueue(task);
 	}
+	void RunAsyncTaskNow(const char *path, IFileTask *task)
+	{
+		m_AsyncWorker.RunNow(path, task);
+	}
 	bool EnqueueValveAsyncTask(ValveFileAsyncTask *task, const char *pathID, bool append = false)
 	{
 		return m_ValveAsyncQueue.Enqueue(task, pathID, append);
@@ -1176,6 +1582,22 @@ bool OnLogPrint(const char *msg)
 	return s_FileNatives.LogPrint(msg);
 }
 
+// Takes ownership of the task, which is deleted if it can't be queued.
+bool QueueFileTask(const char *path, IdentityToken_t *owner, IFileTask *task)
+{
+	FileAsyncTask *wrapper = new FileAsyncTask(task, owner, path);
+	if (s_FileNatives.EnqueueAsyncTask(wrapper))
+		return true;
+
+	delete wrapper;
+	return false;
+}
+
+void RunFileTaskNow(const char *path, IFileTask *task)
+{
+	s_FileNatives.RunAsyncTaskNow(path, task);
+}
+
 static cell_t sm_OpenDirectory(IPluginContext *pContext, const cell_t *params)
 {
 	char *path;
@@ -1350,11 +1772,37 @@ static cell_t sm_OpenFile(IPluginContext *pContext, const cell_t *params)
 		return pContext->ThrowNativeError("File open mode is invalid \"%s\"!", mode);
 	}
 
+	// 'm' after "r" maps the whole file read-only instead of using stdio.
+	char sysmode[8];
+	bool mapped = false;
+	size_t modelen = 0;
+	for (const char *c = mode; *c && modelen < sizeof(sysmode) - 1; c++) {
+		if (*c == 'm')
+			mapped = true;
+		else
+			sysmode[modelen++] = *c;
+	}
+	sysmode[modelen] = '\0';
+
+	if (mapped && (mode[0] != 'r' || strchr(mode, '+'))) {
+		return pContext->ThrowNativeError("Mapped files can only be opened for reading (mode \"%s\")", mode);
+	}
+
+	cell_t buffer_size = (params[0] >= 5) ? params[5] : 0;
+	if (buffer_size < 0 || buffer_size > kMaxFileBufferSize) {
+		return pContext->ThrowNativeError("Invalid buffer size %d (max: %d)", buffer_size, kMaxFileBufferSize);
+	}
+
 	FileObject *file = NULL;
 	if (params[0] <= 2 || !params[3]) {
 		char realpath[PLATFORM_MAX_PATH];
 		g_pSM->BuildPath(Path_Game, realpath, sizeof(realpath), "%s", name);
-		file = SystemFile::Open(realpath, mode);
+		if (mapped)
+			file = MappedFile::Open(realpath, sysmode);
+		else
+			file = SystemFile::Open(realpath, sysmode, (size_t)buffer_size);
+	} else if (mapped) {
+		return pContext->ThrowNativeError("Mapped files are not supported by the Valve file system");
 	} else {
 		char *pathID;
 		pContext->LocalToStringNULL(params[4], &pathID);
@@ -1700,6 +2148,64 @@ static cell_t sm_ReadFileLine(IPluginContext *pContext, const cell_t *params)
 	return file->ReadLine(buf, params[3]) == NULL ? 0 : 1;
 }
 
+static cell_t File_ReadLines(IPluginContext *pContext, const cell_t *params)
+{
+	OpenHandle<FileObject> file(pContext, params[1], g_FileType);
+	if (!file.Ok())
+		return 0;
+
+	CellArray *array;
+	HandleError err;
+	HandleSecurity sec(pContext->GetIdentity(), g_pCoreIdent);
+	if ((err = handlesys->ReadHandle(params[2], htCellArray, &sec, (void **)&array))
+		!= HandleError_None)
+	{
+		return pContext->ThrowNativeError("Invalid Handle %x (error: %d)", params[2], err);
+	}
+
+	cell_t max_lines = params[3];
+	size_t maxlength = array->blocksize() * sizeof(cell_t);
+
+	// Room for the terminator fgets() always writes, plus one byte to tell
+	// whether the line fit in an array item.
+	std::vector<char> line(maxlength + 1);
+	std::vector<char> rest(1024);
+
+	cell_t count = 0;
+	while (max_lines < 0 || count < max_lines)
+	{
+		if (!file->ReadLine(line.data(), (int)line.size()))
+			break;
+
+		size_t len = strlen(line.data());
+		bool complete = (len && line[len - 1] == '\n');
+
+		// Drop the rest of a line that is longer than an array item.
+		while (!complete && len == line.size() - 1)
+		{
+			if (!file->ReadLine(rest.data(), (int)rest.size()))
+				break;
+			size_t restlen = strlen(rest.data());
+			complete = (restlen && rest[restlen - 1] == '\n') || restlen < rest.size() - 1;
+		}
+
+		while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			len--;
+		if (len > maxlength - 1)
+			len = maxlength - 1;
+
+		cell_t *blk = array->push();
+		if (!blk)
+			return pContext->ThrowNativeError("Failed to grow array");
+
+		memcpy(blk, line.data(), len);
+		((char *)blk)[len] = '\0';
+		count++;
+	}
+
+	return count;
+}
+
 static cell_t sm_IsEndOfFile(IPluginContext *pContext, const cell_t *params)
 {
 	OpenHandle<FileObject> file(pContext, params[1], g_FileType);
@@ -2483,6 +2989,7 @@ REGISTER_NATIVES(filesystem)
 	{"GetFilePermissions",		sm_GetFilePermissions},
 
 	{"File.ReadLine",			sm_ReadFileLine},
+	{"File.ReadLines",			File_ReadLines},
 	{"File.Read",				sm_ReadFile},
 	{"File.ReadString",			sm_ReadFileString},
 	{"File.Write",				sm_WriteFile},
@@ -103,6 +103,9 @@ public:
 			playerhelpers->RegisterCommandTargetProcessor(this);
 			filterEnabled = true;
 		}
+
+		/* A cached name match may now be claimed by this filter. */
+		bridge->InvalidateTargetCache();
 	}
 
 	void RemoveMultiTargetFilter(const char *pattern, IPluginFunction *fun)
@@ -113,6 +116,7 @@ public:
 			if ((*iter)->fun == fun && strcmp((*iter)->pattern.c_str(), pattern) == 0) {
 				delete (*iter);
 				iter = simpleMultis.erase(iter);
+				bridge->InvalidateTargetCache();
 				break;
 			}
 			iter++;
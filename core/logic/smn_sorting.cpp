@@ -32,11 +32,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <algorithm>
 #include <memory>
+#include <vector>
 #include "common_logic.h"
 #include "CellArray.h"
 #include <IHandleSys.h>
-#include <amtl/am-raii.h>
 
 /***********************************
  *   About the double array hack   *
@@ -194,29 +195,48 @@ static cell_t sm_SortFloats(IPluginContext *pContext, const cell_t *params)
 	return 1;
 }
 
-static cell_t *g_CurStringArray = NULL;
-static cell_t *g_CurRebaseMap = NULL;
-
-int sort_strings_asc_legacy(const void *blk1, const void *blk2)
+/**
+ * Bottom-up merge sort over cells with a qsort-style comparator.
+ *
+ * Unlike qsort, all state lives in the comparator object, so a sort can be
+ * started from inside another sort's callback. It is also stable, and never
+ * reads out of bounds even when a plugin comparator is inconsistent.
+ */
+template <typename Compare>
+static void sort_cells(cell_t *array, size_t count, const Compare &compare)
 {
-	cell_t reloc1 = *(cell_t *)blk1;
-	cell_t reloc2 = *(cell_t *)blk2;
-	
-	char *str1 = ((char *)(&g_CurStringArray[reloc1]) + g_CurRebaseMap[reloc1]);
-	char *str2 = ((char *)(&g_CurStringArray[reloc2]) + g_CurRebaseMap[reloc2]);
-
-	return strcmp(str1, str2);
-}
+	if (count < 2)
+		return;
 
-int sort_strings_desc_legacy(const void *blk1, const void *blk2)
-{
-	cell_t reloc1 = *(cell_t *)blk1;
-	cell_t reloc2 = *(cell_t *)blk2;
+	std::vector<cell_t> temp(count);
+	cell_t *src = array;
+	cell_t *dest = temp.data();
 
-	char *str1 = ((char *)(&g_CurStringArray[reloc1]) + g_CurRebaseMap[reloc1]);
-	char *str2 = ((char *)(&g_CurStringArray[reloc2]) + g_CurRebaseMap[reloc2]);
+	for (size_t width = 1; width < count; width *= 2)
+	{
+		for (size_t lo = 0; lo < count; lo += width * 2)
+		{
+			size_t mid = std::min(lo + width, count);
+			size_t hi = std::min(lo + width * 2, count);
+			size_t left = lo, right = mid, out = lo;
+
+			while (left < mid && right < hi)
+			{
+				if (compare(src[left], src[right]) > 0)
+					dest[out++] = src[right++];
+				else
+					dest[out++] = src[left++];
+			}
+			while (left < mid)
+				dest[out++] = src[left++];
+			while (right < hi)
+				dest[out++] = src[right++];
+		}
+		std::swap(src, dest);
+	}
 
-	return strcmp(str2, str1);
+	if (src != array)
+		memcpy(array, src, sizeof(cell_t) * count);
 }
 
 static cell_t sm_SortStrings_Legacy(IPluginContext *pContext, const cell_t *params)
@@ -229,9 +249,7 @@ static cell_t sm_SortStrings_Legacy(IPluginContext *pContext, const cell_t *para
 
 	/** HACKHACK - back up the old indices, replace the indices with something easier */
 	auto phys_addr = std::make_unique<cell_t[]>(array_size);
-
-	g_CurStringArray = array;
-	g_CurRebaseMap = phys_addr.get();
+	cell_t *rebase = phys_addr.get();
 
 	for (int i=0; i<array_size; i++)
 	{
@@ -239,13 +257,21 @@ static cell_t sm_SortStrings_Legacy(IPluginContext *pContext, const cell_t *para
 		array[i] = i;
 	}
 
+	auto compare = [array, rebase](cell_t reloc1, cell_t reloc2) -> int {
+		char *str1 = ((char *)(&array[reloc1]) + rebase[reloc1]);
+		char *str2 = ((char *)(&array[reloc2]) + rebase[reloc2]);
+		return strcmp(str1, str2);
+	};
+
 	if (type == Sort_Ascending)
 	{
-		qsort(array, array_size, sizeof(cell_t), sort_strings_asc_legacy);
+		sort_cells(array, array_size, compare);
 	}
 	else if (type == Sort_Descending)
 	{
-		qsort(array, array_size, sizeof(cell_t), sort_strings_desc_legacy);
+		sort_cells(array, array_size, [&compare](cell_t reloc1, cell_t reloc2) -> int {
+			return compare(reloc2, reloc1);
+		});
 	}
 	else
 	{
@@ -263,54 +289,9 @@ static cell_t sm_SortStrings_Legacy(IPluginContext *pContext, const cell_t *para
 		array[i] = ((char *)&array[array[i]] + phys_addr[array[i]]) - (char *)&array[i];
 	}
 
-	g_CurStringArray = NULL;
-	g_CurRebaseMap = NULL;
-
 	return 1;
 }
 
-static IPluginContext* sSortContext = nullptr;
-
-int sort_strings_asc(const void *blk1, const void *blk2)
-{
-	cell_t str_addr1 = *(cell_t *)blk1;
-	cell_t str_addr2 = *(cell_t *)blk2;
-
-	ARRAY_PTR h1, h2;
-	if (sSortContext->LocalToArrayPtr(str_addr1, &h1) != SP_ERROR_NONE ||
-		sSortContext->LocalToArrayPtr(str_addr2, &h2) != SP_ERROR_NONE)
-	{
-		return 0;
-	}
-	char *str1 = (char *)sSortContext->GetArrayData(h1);
-	char *str2 = (char *)sSortContext->GetArrayData(h2);
-
-	if (!str1 || !str2)
-		return 0;
-
-	return strcmp(str1, str2);
-}
-
-int sort_strings_desc(const void *blk1, const void *blk2)
-{
-	cell_t str_addr1 = *(cell_t *)blk1;
-	cell_t str_addr2 = *(cell_t *)blk2;
-
-	ARRAY_PTR h1, h2;
-	if (sSortContext->LocalToArrayPtr(str_addr1, &h1) != SP_ERROR_NONE ||
-		sSortContext->LocalToArrayPtr(str_addr2, &h2) != SP_ERROR_NONE)
-	{
-		return 0;
-	}
-	char *str1 = (char *)sSortContext->GetArrayData(h1);
-	char *str2 = (char *)sSortContext->GetArrayData(h2);
-
-	if (!str1 || !str2)
-		return 0;
-
-	return strcmp(str2, str1);
-}
-
 static cell_t sm_SortStrings(IPluginContext *pContext, const cell_t *params)
 {
 	auto rt = pContext->GetRuntime();
@@ -325,15 +306,31 @@ static cell_t sm_SortStrings(IPluginContext *pContext, const cell_t *params)
 	cell_t array_size = params[2];
 	cell_t type = params[3];
 
-	ke::SaveAndSet<IPluginContext*> set_context(&sSortContext, pContext);
+	auto compare = [pContext](cell_t str_addr1, cell_t str_addr2) -> int {
+		ARRAY_PTR h1, h2;
+		if (pContext->LocalToArrayPtr(str_addr1, &h1) != SP_ERROR_NONE ||
+			pContext->LocalToArrayPtr(str_addr2, &h2) != SP_ERROR_NONE)
+		{
+			return 0;
+		}
+		char *str1 = (char *)pContext->GetArrayData(h1);
+		char *str2 = (char *)pContext->GetArrayData(h2);
+
+		if (!str1 || !str2)
+			return 0;
+
+		return strcmp(str1, str2);
+	};
 
 	if (type == Sort_Ascending)
 	{
-		qsort(array, array_size, sizeof(cell_t), sort_strings_asc);
+		sort_cells(array, array_size, compare);
 	}
 	else if (type == Sort_Descending)
 	{
-		qsort(array, array_size, sizeof(cell_t), sort_strings_desc);
+		sort_cells(array, array_size, [&compare](cell_t str_addr1, cell_t str_addr2) -> int {
+			return compare(str_addr2, str_addr1);
+		});
 	}
 	else
 	{
@@ -342,36 +339,32 @@ static cell_t sm_SortStrings(IPluginContext *pContext, const cell_t *params)
 	return 1;
 }
 
-struct sort_info
+/**
+ * Calls a plugin comparator. Once the callback has thrown, every pair
+ * compares equal so the sort finishes quickly.
+ */
+struct sort_callback
 {
 	IPluginFunction *pFunc;
+	cell_t array;
 	Handle_t hndl;
-	cell_t array_addr;
-	cell_t *array_base;
-	cell_t *array_remap;
 	ExceptionHandler *eh;
-};
-
-sort_info g_SortInfo;
-
-int sort1d_amx_custom(const void *elem1, const void *elem2)
-{
-	if (g_SortInfo.eh->HasException())
-		return 0;
 
-	cell_t c1 = *(cell_t *)elem1;
-	cell_t c2 = *(cell_t *)elem2;
+	int operator()(cell_t elem1, cell_t elem2) const
+	{
+		if (eh->HasException())
+			return 0;
 
-	cell_t result = 0;
-	IPluginFunction *pf = g_SortInfo.pFunc;
-	pf->PushCell(c1);
-	pf->PushCell(c2);
-	pf->PushCell(g_SortInfo.array_addr);
-	pf->PushCell(g_SortInfo.hndl);
-	pf->Invoke(&result);
+		cell_t result = 0;
+		pFunc->PushCell(elem1);
+		pFunc->PushCell(elem2);
+		pFunc->PushCell(array);
+		pFunc->PushCell(hndl);
+		pFunc->Invoke(&result);
 
-	return result;
-}
+		return result;
+	}
+};
 
 static cell_t sm_SortCustom1D(IPluginContext *pContext, const cell_t *params)
 {
@@ -386,46 +379,17 @@ static cell_t sm_SortCustom1D(IPluginContext *pContext, const cell_t *params)
 
 	pContext->LocalToPhysAddr(params[1], &array);
 
-	sort_info oldinfo = g_SortInfo;
-
 	DetectExceptions eh(pContext);
-	g_SortInfo.hndl = params[4];
-	g_SortInfo.array_addr = params[1];
-	g_SortInfo.array_remap = NULL;
-	g_SortInfo.array_base = NULL;
-	g_SortInfo.pFunc = pFunction;
-	g_SortInfo.eh = &eh;
-
-	qsort(array, array_size, sizeof(cell_t), sort1d_amx_custom);
-
-	g_SortInfo = oldinfo;
-	return 1;
-}
-
-static int sort2d_amx_custom_legacy(const void *elem1, const void *elem2)
-{
-	if (g_SortInfo.eh->HasException())
-		return 0;
-
-	cell_t c1 = *(cell_t *)elem1;
-	cell_t c2 = *(cell_t *)elem2;
+	sort_callback callback = {pFunction, params[1], params[4], &eh};
 
-	cell_t c1_addr = g_SortInfo.array_addr + (c1 * sizeof(cell_t)) + g_SortInfo.array_remap[c1];
-	cell_t c2_addr = g_SortInfo.array_addr + (c2 * sizeof(cell_t)) + g_SortInfo.array_remap[c2];
+	/* Sort a copy, so the callback always sees the original array. */
+	std::vector<cell_t> values(array, array + array_size);
+	sort_cells(values.data(), values.size(), callback);
 
-	IPluginContext *pContext = g_SortInfo.pFunc->GetParentContext();
-	cell_t *c1_r, *c2_r;
-	pContext->LocalToPhysAddr(c1_addr, &c1_r);
-	pContext->LocalToPhysAddr(c2_addr, &c2_r);
+	if (!eh.HasException())
+		memcpy(array, values.data(), sizeof(cell_t) * values.size());
 
-	cell_t result = 0;
-	g_SortInfo.pFunc->PushCell(c1_addr);
-	g_SortInfo.pFunc->PushCell(c2_addr);
-	g_SortInfo.pFunc->PushCell(g_SortInfo.array_addr);
-	g_SortInfo.pFunc->PushCell(g_SortInfo.hndl);
-	g_SortInfo.pFunc->Invoke(&result);
-
-	return result;
+	return 1;
 }
 
 static cell_t sm_SortCustom2D_Legacy(IPluginContext *pContext, const cell_t *params)
@@ -441,61 +405,43 @@ static cell_t sm_SortCustom2D_Legacy(IPluginContext *pContext, const cell_t *par
 		return pContext->ThrowNativeError("Function %x is not a valid function", params[3]);
 	}
 
-	/** back up the old indices, replace the indices with something easier */
-	auto phys_addr = std::make_unique<cell_t[]>(array_size);
-
-	sort_info oldinfo = g_SortInfo;
-
-	DetectExceptions eh(pContext);
-	g_SortInfo.pFunc = pFunction;
-	g_SortInfo.hndl = params[4];
-	g_SortInfo.array_addr = params[1];
-	g_SortInfo.eh = &eh;
-	
-	/** Same process as in strings, back up the old indices for later fixup */
-	g_SortInfo.array_base = array;
-	g_SortInfo.array_remap = phys_addr.get();
-	
+	/* Sort row indexes rather than the array itself, so the callback always
+	 * sees the original array and nothing is changed if it throws.
+	 */
+	std::vector<cell_t> order(array_size);
 	for (int i=0; i<array_size; i++)
 	{
-		phys_addr[i] = array[i];
-		array[i] = i;
+		order[i] = i;
 	}
 
-	qsort(array, array_size, sizeof(cell_t), sort2d_amx_custom_legacy);
+	DetectExceptions eh(pContext);
+	sort_callback callback = {pFunction, params[1], params[4], &eh};
+	cell_t array_addr = params[1];
+
+	/** Same process as in strings, the callback gets the original addresses */
+	sort_cells(order.data(), order.size(), [&callback, array_addr, array](cell_t c1, cell_t c2) -> int {
+		cell_t c1_addr = array_addr + (c1 * sizeof(cell_t)) + array[c1];
+		cell_t c2_addr = array_addr + (c2 * sizeof(cell_t)) + array[c2];
+		return callback(c1_addr, c2_addr);
+	});
+
+	if (eh.HasException())
+		return 1;
 
 	/** Fixup process! */
+	std::vector<cell_t> offsets(array_size);
 	for (int i=0; i<array_size; i++)
 	{
 		/* Compute the final address of the old array and subtract the new location.
 		 * This is the fixed up distance.
 		 */
-		array[i] = ((char *)&array[array[i]] + phys_addr[array[i]]) - (char *)&array[i];
+		offsets[i] = ((char *)&array[order[i]] + array[order[i]]) - (char *)&array[i];
 	}
+	memcpy(array, offsets.data(), sizeof(cell_t) * offsets.size());
 
-	g_SortInfo = oldinfo;
-	
 	return 1;
 }
 
-static int sort2d_amx_custom(const void *elem1, const void *elem2)
-{
-	if (g_SortInfo.eh->HasException())
-		return 0;
-
-	cell_t iv1 = *(cell_t *)elem1;
-	cell_t iv2 = *(cell_t *)elem2;
-
-	cell_t result = 0;
-	g_SortInfo.pFunc->PushCell(iv1);
-	g_SortInfo.pFunc->PushCell(iv2);
-	g_SortInfo.pFunc->PushCell(g_SortInfo.array_addr);
-	g_SortInfo.pFunc->PushCell(g_SortInfo.hndl);
-	g_SortInfo.pFunc->Invoke(&result);
-
-	return result;
-}
-
 static cell_t sm_SortCustom2D(IPluginContext *pContext, const cell_t *params)
 {
 	auto rt = pContext->GetRuntime();
@@ -515,17 +461,16 @@ static cell_t sm_SortCustom2D(IPluginContext *pContext, const cell_t *params)
 		return pContext->ThrowNativeError("Function %x is not a valid function", params[3]);
 	}
 
-	sort_info oldinfo = g_SortInfo;
-
 	DetectExceptions eh(pContext);
-	g_SortInfo.pFunc = pFunction;
-	g_SortInfo.hndl = params[4];
-	g_SortInfo.array_addr = params[1];
-	g_SortInfo.eh = &eh;
-	
-	qsort(array, array_size, sizeof(cell_t), sort2d_amx_custom);
+	sort_callback callback = {pFunction, params[1], params[4], &eh};
+
+	/* Sort a copy, so the callback always sees the original array. */
+	std::vector<cell_t> rows(array, array + array_size);
+	sort_cells(rows.data(), rows.size(), callback);
+
+	if (!eh.HasException())
+		memcpy(array, rows.data(), sizeof(cell_t) * rows.size());
 
-	g_SortInfo = oldinfo;
 	return 1;
 }
 
@@ -536,26 +481,121 @@ enum SortType
 	Sort_String,
 };
 
-int sort_adtarray_strings_asc(const void *str1, const void *str2)
+void sort_adt_random(CellArray *cArray)
 {
-	return strcmp((char *) str1, (char *) str2);
+	size_t arraysize = cArray->size();
+
+	for (int i = arraysize-1; i > 0; i--)
+	{
+        int n = rand() % (i + 1);
+
+		cArray->swap(i, n);
+	}
+}
+
+/* Moves the items of an ADT array into the given order, a permutation of 0..size-1. */
+static void sort_adt_apply(CellArray *cArray, const std::vector<cell_t> &order)
+{
+	size_t blocksize = cArray->blocksize();
+	std::vector<cell_t> sorted(order.size() * blocksize);
+
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		memcpy(&sorted[i * blocksize], cArray->at(order[i]), sizeof(cell_t) * blocksize);
+	}
+	memcpy(cArray->base(), sorted.data(), sizeof(cell_t) * sorted.size());
+
+	cArray->invalidate_index();
 }
 
-int sort_adtarray_strings_desc(const void *str1, const void *str2)
+/* Maps an int or float to an unsigned key with the same ordering. */
+static inline uint32_t sort_radix_key(cell_t value, cell_t type)
 {
-	return strcmp((char *) str2, (char *) str1);
+	uint32_t bits = (uint32_t)value;
+	if (type == Sort_Float)
+	{
+		/* Negative floats order backwards by their bits; NaNs end up at either end. */
+		return (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
+	}
+	return bits ^ 0x80000000;
 }
 
-void sort_adt_random(CellArray *cArray)
+/**
+ * Stable sort of an ADT array by the int, float or string at one block of
+ * each item. Keys are extracted once, so no comparison goes through the VM:
+ * numbers use an LSD radix sort, strings a merge sort over item indexes.
+ */
+static void sort_adt_by_block(CellArray *cArray, size_t block, cell_t order, cell_t type)
 {
 	size_t arraysize = cArray->size();
+	if (arraysize < 2)
+		return;
 
-	for (int i = arraysize-1; i > 0; i--)
+	std::vector<cell_t> items(arraysize);
+	if (type == Sort_String)
 	{
-        int n = rand() % (i + 1);
+		size_t maxlen = (cArray->blocksize() - block) * sizeof(cell_t);
+		auto compare = [cArray, block, maxlen](cell_t item1, cell_t item2) -> int {
+			return strncmp((char *)(cArray->at(item1) + block), (char *)(cArray->at(item2) + block), maxlen);
+		};
 
-		cArray->swap(i, n);
+		for (size_t i = 0; i < arraysize; i++)
+			items[i] = (cell_t)i;
+
+		if (order == Sort_Descending)
+		{
+			sort_cells(items.data(), arraysize, [&compare](cell_t item1, cell_t item2) -> int {
+				return compare(item2, item1);
+			});
+		}
+		else
+		{
+			sort_cells(items.data(), arraysize, compare);
+		}
+
+		sort_adt_apply(cArray, items);
+		return;
 	}
+
+	std::vector<uint32_t> keys(arraysize), keys_temp(arraysize);
+	std::vector<cell_t> items_temp(arraysize);
+	for (size_t i = 0; i < arraysize; i++)
+	{
+		keys[i] = sort_radix_key(cArray->at(i)[block], type);
+		if (order == Sort_Descending)
+			keys[i] = ~keys[i];
+		items[i] = (cell_t)i;
+	}
+
+	for (unsigned int shift = 0; shift < 32; shift += 8)
+	{
+		size_t offsets[256] = {0};
+		for (size_t i = 0; i < arraysize; i++)
+			offsets[(keys[i] >> shift) & 0xff]++;
+
+		/* Every key has the same byte here, nothing would move. */
+		if (offsets[(keys[0] >> shift) & 0xff] == arraysize)
+			continue;
+
+		size_t total = 0;
+		for (size_t i = 0; i < 256; i++)
+		{
+			size_t count = offsets[i];
+			offsets[i] = total;
+			total += count;
+		}
+
+		for (size_t i = 0; i < arraysize; i++)
+		{
+			size_t pos = offsets[(keys[i] >> shift) & 0xff]++;
+			keys_temp[pos] = keys[i];
+			items_temp[pos] = items[i];
+		}
+		keys.swap(keys_temp);
+		items.swap(items_temp);
+	}
+
+	sort_adt_apply(cArray, items);
 }
 
 static cell_t sm_SortADTArray(IPluginContext *pContext, const cell_t *params)
@@ -580,73 +620,49 @@ static cell_t sm_SortADTArray(IPluginContext *pContext, const cell_t *params)
 	}
 
 	cell_t type = params[3];
-	size_t arraysize = cArray->size();
-	size_t blocksize = cArray->blocksize();
-	cell_t *array = cArray->base();
-
-	if (type == Sort_Integer)
+	if (type == Sort_Integer || type == Sort_Float || type == Sort_String)
 	{
-		if (order == Sort_Ascending)
-		{
-			qsort(array, arraysize, blocksize * sizeof(cell_t), sort_ints_asc);
-		}
-		else
-		{
-			qsort(array, arraysize, blocksize * sizeof(cell_t), sort_ints_desc);
-		}
-	}
-	else if (type == Sort_Float)
-	{
-		if (order == Sort_Ascending)
-		{
-			qsort(array, arraysize, blocksize * sizeof(cell_t), sort_floats_asc);
-		}
-		else
-		{
-			qsort(array, arraysize, blocksize * sizeof(cell_t), sort_floats_desc);
-		}
-	}
-	else if (type == Sort_String)
-	{
-		if (order == Sort_Ascending)
-		{
-			qsort(array, arraysize, blocksize * sizeof(cell_t), sort_adtarray_strings_asc);
-		}
-		else
-		{
-			qsort(array, arraysize, blocksize * sizeof(cell_t), sort_adtarray_strings_desc);
-		}
+		sort_adt_by_block(cArray, 0, order, type);
 	}
 
 	return 1;
 }
 
-struct sort_infoADT
+static cell_t sm_SortADTArrayByBlock(IPluginContext *pContext, const cell_t *params)
 {
-	IPluginFunction *pFunc;
-	cell_t *array_base;
-	cell_t array_bsize;
-	Handle_t array_hndl;
-	Handle_t hndl;
-	ExceptionHandler *eh;
-};
+	CellArray *cArray;
+	HandleError err;
+	HandleSecurity sec(pContext->GetIdentity(), g_pCoreIdent);
 
-sort_infoADT g_SortInfoADT;
+	if ((err = handlesys->ReadHandle(params[1], htCellArray, &sec, (void **)&cArray))
+		!= HandleError_None)
+	{
+		return pContext->ThrowNativeError("Invalid Handle %x (error: %d)", params[1], err);
+	}
 
-int sort_adtarray_custom(const void *elem1, const void *elem2)
-{
-	if (g_SortInfoADT.eh->HasException())
-		return 0;
+	size_t block = (size_t)params[2];
+	if (block >= cArray->blocksize())
+	{
+		return pContext->ThrowNativeError("Invalid block %d (blocksize: %d)", block, cArray->blocksize());
+	}
 
-	cell_t result = 0;
-	IPluginFunction *pf = g_SortInfoADT.pFunc;
-	pf->PushCell(((cell_t) ((cell_t *) elem1 - g_SortInfoADT.array_base)) / g_SortInfoADT.array_bsize);
-	pf->PushCell(((cell_t) ((cell_t *) elem2 - g_SortInfoADT.array_base)) / g_SortInfoADT.array_bsize);
-	pf->PushCell(g_SortInfoADT.array_hndl);
-	pf->PushCell(g_SortInfoADT.hndl);
-	pf->Invoke(&result);
+	cell_t type = params[3];
+	if (type != Sort_Integer && type != Sort_Float && type != Sort_String)
+	{
+		return pContext->ThrowNativeError("Invalid sort type %d", type);
+	}
 
-	return result;
+	cell_t order = params[4];
+	if (order == Sort_Random)
+	{
+		sort_adt_random(cArray);
+	}
+	else
+	{
+		sort_adt_by_block(cArray, block, order, type);
+	}
+
+	return 1;
 }
 
 static cell_t sm_SortADTArrayCustom(IPluginContext *pContext, const cell_t *params)
@@ -668,22 +684,26 @@ static cell_t sm_SortADTArrayCustom(IPluginContext *pContext, const cell_t *para
 	}
 
 	size_t arraysize = cArray->size();
-	size_t blocksize = cArray->blocksize();
-	cell_t *array = cArray->base();
 
-	sort_infoADT oldinfo = g_SortInfoADT;
+	/* Sort item indexes rather than the items, so the callback always
+	 * reads the array as it was before the sort started. */
+	std::vector<cell_t> items(arraysize);
+	for (size_t i = 0; i < arraysize; i++)
+		items[i] = (cell_t)i;
 
 	DetectExceptions eh(pContext);
-	g_SortInfoADT.pFunc = pFunction;
-	g_SortInfoADT.array_base = array;
-	g_SortInfoADT.array_bsize = (cell_t) blocksize;
-	g_SortInfoADT.array_hndl = params[1];
-	g_SortInfoADT.hndl = params[3];
-	g_SortInfoADT.eh = &eh;
-	
-	qsort(array, arraysize, blocksize * sizeof(cell_t), sort_adtarray_custom);
+	sort_callback callback = {pFunction, params[1], params[3], &eh};
+	sort_cells(items.data(), arraysize, callback);
+
+	if (eh.HasException())
+		return 1;
+
+	if (cArray->size() != arraysize)
+	{
+		return pContext->ThrowNativeError("Array was resized during sort (from %d to %d)", arraysize, cArray->size());
+	}
 
-	g_SortInfoADT = oldinfo;
+	sort_adt_apply(cArray, items);
 
 	return 1;
 }
@@ -699,6 +719,7 @@ REGISTER_NATIVES(sortNatives)
 	{"SortADTArrayCustom",      sm_SortADTArrayCustom},
 	
 	{"ArrayList.Sort",          sm_SortADTArray},
+	{"ArrayList.SortByBlock",   sm_SortADTArrayByBlock},
 	{"ArrayList.SortCustom",    sm_SortADTArrayCustom},
 	
 	{NULL,                      NULL},
@@ -440,6 +440,11 @@ static int get_global_target()
 	return g_SourceMod.GetGlobalTarget();
 }
 
+static void invalidate_target_cache()
+{
+	g_Players.InvalidateTargetCache();
+}
+
 void UTIL_ConsolePrintVa(const char *fmt, va_list ap)
 {
 	char buffer[512];
@@ -541,6 +546,7 @@ CoreProviderImpl::CoreProviderImpl()
 	this->UpdateAdminCmdFlags = update_admin_cmd_flags;
 	this->LookForCommandAdminFlags = look_for_cmd_admin_flags;
 	this->GetGlobalTarget = get_global_target;
+	this->InvalidateTargetCache = invalidate_target_cache;
 	this->gamesuffix = GAMEFIX;
 	this->serverGlobals = &::serverGlobals;
 	this->listeners = nullptr;
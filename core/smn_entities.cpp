@@ -37,6 +37,7 @@
 #include <IGameConfigs.h>
 #include "sm_stringutil.h"
 #include "logic_bridge.h"
+#include "EntityClassIndex.h"
 
 // These values need to mirror the values in entity_prop_stocks
 #define ENTFLAG_ONGROUND		(1 << 0)
@@ -2824,6 +2825,168 @@ static cell_t GetEntityAddress(IPluginContext *pContext, const cell_t *params)
 	return reinterpret_cast<uintptr_t>(pEntity);
 }
 
+static cell_t WriteEntityRefs(IPluginContext *pContext, cell_t addr, cell_t maxEntities, const std::vector<CBaseEntity *> &found)
+{
+	cell_t *entities;
+	pContext->LocalToPhysAddr(addr, &entities);
+
+	cell_t count = 0;
+	for (size_t i = 0; i < found.size() && count < maxEntities; i++)
+	{
+		entities[count++] = g_HL2.EntityToBCompatRef(found[i]);
+	}
+
+	return count;
+}
+
+static cell_t FindEntitiesByClassname(IPluginContext *pContext, const cell_t *params)
+{
+	char *classname;
+	pContext->LocalToString(params[1], &classname);
+
+	if (params[3] < 0)
+	{
+		return pContext->ThrowNativeError("Invalid maximum entity count (%d)", params[3]);
+	}
+
+	std::vector<CBaseEntity *> found;
+	g_EntityClassIndex.FindByClassname(classname, found);
+
+	return WriteEntityRefs(pContext, params[2], params[3], found);
+}
+
+static cell_t FindEntitiesByNetClass(IPluginContext *pContext, const cell_t *params)
+{
+	char *netclass;
+	pContext->LocalToString(params[1], &netclass);
+
+	if (params[3] < 0)
+	{
+		return pContext->ThrowNativeError("Invalid maximum entity count (%d)", params[3]);
+	}
+
+	std::vector<CBaseEntity *> found;
+
+	/* Only edicts can be networked, so there's no need to look past them. */
+	for (int i = 0; i < gpGlobals->maxEntities && (cell_t)found.size() < params[3]; i++)
+	{
+		CBaseEntity *pEntity = g_HL2.ReferenceToEntity(i);
+		if (!pEntity)
+		{
+			continue;
+		}
+
+		ServerClass *pClass = g_HL2.FindEntityServerClass(pEntity);
+		if (pClass && strcmp(pClass->GetName(), netclass) == 0)
+		{
+			found.push_back(pEntity);
+		}
+	}
+
+	return WriteEntityRefs(pContext, params[2], params[3], found);
+}
+
+static cell_t FindEntitiesByDataField(IPluginContext *pContext, const cell_t *params)
+{
+	char *classname, *prop;
+	pContext->LocalToString(params[1], &classname);
+	pContext->LocalToString(params[2], &prop);
+
+	if (params[5] < 0)
+	{
+		return pContext->ThrowNativeError("Invalid maximum entity count (%d)", params[5]);
+	}
+
+	std::vector<CBaseEntity *> candidates;
+	g_EntityClassIndex.FindByClassname(classname, candidates);
+
+	std::vector<CBaseEntity *> found;
+
+	/* Entities matched by a classname pattern mostly share a few datamaps,
+	 * so only look the field up again when the datamap changes.
+	 */
+	datamap_t *pLastMap = NULL;
+	typedescription_t *td = NULL;
+	int offset = 0;
+	int bit_count = 0;
+
+	for (size_t i = 0; i < candidates.size() && (cell_t)found.size() < params[5]; i++)
+	{
+		CBaseEntity *pEntity = candidates[i];
+
+		datamap_t *pMap = CBaseEntity_GetDataDescMap(pEntity);
+		if (!pMap)
+		{
+			continue;
+		}
+
+		if (pMap != pLastMap)
+		{
+			pLastMap = pMap;
+
+			sm_datatable_info_t info;
+			if (!g_HL2.FindDataMapInfo(pMap, prop, &info))
+			{
+				td = NULL;
+				continue;
+			}
+
+			td = info.prop;
+			offset = info.actual_offset;
+
+			if (td->fieldType == FIELD_FLOAT || td->fieldType == FIELD_TIME)
+			{
+				bit_count = 0;
+			}
+			else if (td->fieldType == FIELD_CUSTOM
+				|| (bit_count = MatchTypeDescAsInteger(td->fieldType, td->flags)) == 0)
+			{
+				return pContext->ThrowNativeError("Data field %s is not an integer or float (%d)",
+					prop,
+					td->fieldType);
+			}
+		}
+
+		if (!td)
+		{
+			continue;
+		}
+
+		uint8_t *pData = (uint8_t *)pEntity + offset;
+		bool match;
+		if (bit_count == 0)
+		{
+			match = *(float *)pData == sp_ctof(params[3]);
+		}
+		else if (bit_count >= 17)
+		{
+			match = *(int32_t *)pData == params[3];
+		}
+		else if (bit_count >= 9)
+		{
+			/* Compare the low bits only, so both the signed value GetEntProp
+			 * returns and the unsigned one a plugin may expect will match.
+			 */
+			match = *(uint16_t *)pData == (uint16_t)params[3];
+		}
+		else if (bit_count >= 2)
+		{
+			match = *(uint8_t *)pData == (uint8_t)params[3];
+		}
+		else
+		{
+			match = (*(bool *)pData ? 1 : 0) == (params[3] ? 1 : 0);
+		}
+
+		if (match)
+		{
+			found.push_back(pEntity);
+		}
+	}
+
+	return WriteEntityRefs(pContext, params[4], params[5], found);
+}
+
 REGISTER_NATIVES(entityNatives)
 {
 	{"ChangeEdictState",		ChangeEdictState},
@@ -2869,6 +3032,9 @@ REGISTER_NATIVES(entityNatives)
 	{"SetEntPropVector",		SetEntPropVector},
 	{"GetEntityAddress",		GetEntityAddress},
 	{"FindDataMapInfo",		FindDataMapInfo},
+	{"FindEntitiesByClassname",	FindEntitiesByClassname},
+	{"FindEntitiesByNetClass",	FindEntitiesByNetClass},
+	{"FindEntitiesByDataField",	FindEntitiesByDataField},
 	{"LoadEntityFromHandleAddress",	LoadEntityFromHandleAddress},
 	{"StoreEntityToHandleAddress",	StoreEntityToHandleAddress},
 	{NULL,						NULL}
@@ -77,6 +77,37 @@ static cell_t sm_HookEventEx(IPluginContext *pContext, const cell_t *params)
 	return 1;
 }
 
+static cell_t sm_HookEventFiltered(IPluginContext *pContext, const cell_t *params)
+{
+	char *name;
+	IPluginFunction *pFunction;
+	Handle_t hndl = static_cast<Handle_t>(params[3]);
+	HandleError err;
+	EventFilter *pFilter;
+	HandleSecurity sec(pContext->GetIdentity(), g_pCoreIdent);
+
+	pContext->LocalToString(params[1], &name);
+	pFunction = pContext->GetFunctionById(params[2]);
+
+	if (!pFunction)
+	{
+		return pContext->ThrowNativeError("Invalid function id (%X)", params[2]);
+	}
+
+	if ((err=handlesys->ReadHandle(hndl, g_EventManager.GetFilterHandleType(), &sec, (void **)&pFilter))
+		!= HandleError_None)
+	{
+		return pContext->ThrowNativeError("Invalid event filter handle %x (error %d)", hndl, err);
+	}
+
+	if (g_EventManager.HookFilteredEvent(name, pFunction, *pFilter, static_cast<EventHookMode>(params[4])) == EventHookErr_InvalidEvent)
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
 static cell_t sm_UnhookEvent(IPluginContext *pContext, const cell_t *params)
 {
 	char *name;
@@ -103,6 +134,178 @@ static cell_t sm_UnhookEvent(IPluginContext *pContext, const cell_t *params)
 	return 1;
 }
 
+static EventFilter *ReadEventFilter(IPluginContext *pContext, Handle_t hndl)
+{
+	HandleError err;
+	EventFilter *pFilter;
+	HandleSecurity sec(pContext->GetIdentity(), g_pCoreIdent);
+
+	if ((err=handlesys->ReadHandle(hndl, g_EventManager.GetFilterHandleType(), &sec, (void **)&pFilter))
+		!= HandleError_None)
+	{
+		pContext->ThrowNativeError("Invalid event filter handle %x (error %d)", hndl, err);
+		return NULL;
+	}
+
+	return pFilter;
+}
+
+static EventFilterRule *AddEventFilterRule(IPluginContext *pContext, const cell_t *params, EventFilterType type)
+{
+	EventFilter *pFilter = ReadEventFilter(pContext, params[1]);
+	if (!pFilter)
+	{
+		return NULL;
+	}
+
+	char *field;
+	pContext->LocalToString(params[2], &field);
+
+	pFilter->rules.push_back(EventFilterRule());
+
+	EventFilterRule *pRule = &pFilter->rules.back();
+	pRule->type = type;
+	pRule->field = field;
+	pRule->min = 0;
+	pRule->max = 0;
+	pRule->fmin = 0.0f;
+	pRule->fmax = 0.0f;
+	pRule->flag = false;
+
+	return pRule;
+}
+
+static cell_t sm_CreateEventFilter(IPluginContext *pContext, const cell_t *params)
+{
+	EventFilter *pFilter = new EventFilter();
+	Handle_t hndl = handlesys->CreateHandle(g_EventManager.GetFilterHandleType(), pFilter, pContext->GetIdentity(), g_pCoreIdent, NULL);
+
+	if (!hndl)
+	{
+		delete pFilter;
+	}
+
+	return hndl;
+}
+
+static cell_t sm_EventFilterIntEquals(IPluginContext *pContext, const cell_t *params)
+{
+	EventFilterRule *pRule = AddEventFilterRule(pContext, params, EventFilter_IntRange);
+	if (!pRule)
+	{
+		return 0;
+	}
+
+	pRule->min = params[3];
+	pRule->max = params[3];
+
+	return 1;
+}
+
+static cell_t sm_EventFilterIntRange(IPluginContext *pContext, const cell_t *params)
+{
+	if (params[3] > params[4])
+	{
+		return pContext->ThrowNativeError("Invalid range [%d, %d]", params[3], params[4]);
+	}
+
+	EventFilterRule *pRule = AddEventFilterRule(pContext, params, EventFilter_IntRange);
+	if (!pRule)
+	{
+		return 0;
+	}
+
+	pRule->min = params[3];
+	pRule->max = params[4];
+
+	return 1;
+}
+
+static cell_t sm_EventFilterIntInSet(IPluginContext *pContext, const cell_t *params)
+{
+	if (params[4] < 1)
+	{
+		return pContext->ThrowNativeError("Invalid number of values (%d)", params[4]);
+	}
+
+	EventFilterRule *pRule = AddEventFilterRule(pContext, params, EventFilter_IntSet);
+	if (!pRule)
+	{
+		return 0;
+	}
+
+	cell_t *values;
+	pContext->LocalToPhysAddr(params[3], &values);
+	pRule->values.assign(values, values + params[4]);
+
+	return 1;
+}
+
+static cell_t sm_EventFilterFloatRange(IPluginContext *pContext, const cell_t *params)
+{
+	float min = sp_ctof(params[3]);
+	float max = sp_ctof(params[4]);
+
+	if (min > max)
+	{
+		return pContext->ThrowNativeError("Invalid range [%f, %f]", min, max);
+	}
+
+	EventFilterRule *pRule = AddEventFilterRule(pContext, params, EventFilter_FloatRange);
+	if (!pRule)
+	{
+		return 0;
+	}
+
+	pRule->fmin = min;
+	pRule->fmax = max;
+
+	return 1;
+}
+
+static cell_t sm_EventFilterStringEquals(IPluginContext *pContext, const cell_t *params)
+{
+	EventFilterRule *pRule = AddEventFilterRule(pContext, params, EventFilter_String);
+	if (!pRule)
+	{
+		return 0;
+	}
+
+	char *value;
+	pContext->LocalToString(params[3], &value);
+
+	pRule->str = value;
+	pRule->flag = params[4] ? true : false;
+
+	return 1;
+}
+
+static cell_t sm_EventFilterClientTeam(IPluginContext *pContext, const cell_t *params)
+{
+	EventFilterRule *pRule = AddEventFilterRule(pContext, params, EventFilter_ClientTeam);
+	if (!pRule)
+	{
+		return 0;
+	}
+
+	pRule->min = params[3];
+
+	return 1;
+}
+
+static cell_t sm_EventFilterClientIsBot(IPluginContext *pContext, const cell_t *params)
+{
+	EventFilterRule *pRule = AddEventFilterRule(pContext, params, EventFilter_ClientBot);
+	if (!pRule)
+	{
+		return 0;
+	}
+
+	pRule->flag = params[3] ? true : false;
+
+	return 1;
+}
+
 static cell_t sm_CreateEvent(IPluginContext *pContext, const cell_t *params)
 {
 	char *name;
@@ -133,6 +336,11 @@ static cell_t sm_FireEvent(IPluginContext *pContext, const cell_t *params)
 		return pContext->ThrowNativeError("Invalid game event handle %x (error %d)", hndl, err);
 	}
 
+	if (!pInfo->pEvent)
+	{
+		return pContext->ThrowNativeError("Game event handle %x is no longer valid", hndl);
+	}
+
 	/* If identities do not match, don't fire event */
 	if (pContext->GetIdentity() != pInfo->pOwner)
 	{
@@ -160,6 +368,11 @@ static cell_t sm_FireEventToClient(IPluginContext *pContext, const cell_t *param
 		return pContext->ThrowNativeError("Invalid game event handle %x (error %d)", hndl, err);
 	}
 
+	if (!pInfo->pEvent)
+	{
+		return pContext->ThrowNativeError("Game event handle %x is no longer valid", hndl);
+	}
+
 	int client = params[2];
 	CPlayer *pPlayer = g_Players.GetPlayerByIndex(client);
 
@@ -197,6 +410,11 @@ static cell_t sm_CancelCreatedEvent(IPluginContext *pContext, const cell_t *para
 		return pContext->ThrowNativeError("Invalid game event handle %x (error %d)", hndl, err);
 	}
 
+	if (!pInfo->pEvent)
+	{
+		return pContext->ThrowNativeError("Game event handle %x is no longer valid", hndl);
+	}
+
 	/* If identities do not match, don't cancel event */
 	if (pContext->GetIdentity() != pInfo->pOwner)
 	{
@@ -224,6 +442,11 @@ static cell_t sm_GetEventName(IPluginContext *pContext, const cell_t *params)
 		return pContext->ThrowNativeError("Invalid game event handle %x (error %d)", hndl, err);
 	}
 
+	if (!pInfo->pEvent)
+	{
+		return pContext->ThrowNativeError("Game event handle %x is no longer valid", hndl);
+	}
+
 	pContext->StringToLocalUTF8(params[2], params[3], pInfo->pEvent->GetName(), NULL);
 
 	return 1;
@@ -242,6 +465,11 @@ static cell_t sm_GetEventBool(IPluginContext *pContext, const cell_t *params)
 		return pContext->ThrowNativeError("Invalid game event handle %x (error %d)", hndl, err);
 	}
 
+	if (!pInfo->pEvent)
+	{
+		return pContext->ThrowNativeError("Game event handle %x is no longer valid", hndl);
+	}
+
 	char *key;
 	pContext->LocalToString(params[2], &key);
 
@@ -267,6 +495,11 @@ static cell_t sm_GetEventInt(IPluginContext *pContext, const cell_t *params)
 		return pContext->ThrowNativeError("Invalid game event handle %x (error %d)", hndl, err);
 	}
 
+	if (!pInfo->pEvent)
+	{
+		return pContext->ThrowNativeError("Game event handle %x is no longer valid", hndl);
+	}
+
 	char *key;
 	pContext->LocalToString(params[2], &key);
 
@@ -292,6 +525,11 @@ static cell_t sm_GetEventFloat(IPluginContext *pContext, const cell_t *params)
 		return pContext->ThrowNativeError("Invalid game event handle %x (error %d)", hndl, err);
 	}
 
+	if (!pInfo->pEvent)
+	{
+		return pContext->ThrowNativeError("Game event handle %x is no longer valid", hndl);
+	}
+
 	char *key;
 	pContext->LocalToString(params[2], &key);
 
@@ -319,6 +557,11 @@ static cell_t sm_GetEventString(IPluginContext *pContext, const cell_t *params)
 		return pContext->ThrowNativeError("Invalid game event handle %x (error %d)", hndl, err);
 	}
 
+	if (!pInfo->pEvent)
+	{
+		return pContext->ThrowNativeError("Game event handle %x is no longer valid", hndl);
+	}
+
 	char *key;
 	pContext->LocalToString(params[2], &key);
 
@@ -347,6 +590,11 @@ static cell_t sm_SetEventBool(IPluginContext *pContext, const cell_t *params)
 		return pContext->ThrowNativeError("Invalid game event handle %x (error %d)", hndl, err);
 	}
 
+	if (!pInfo->pEvent)
+	{
+		return pContext->ThrowNativeError("Game event handle %x is no longer valid", hndl);
+	}
+
 	char *key;
 	pContext->LocalToString(params[2], &key);
 
@@ -368,6 +616,11 @@ static cell_t sm_SetEventInt(IPluginContext *pContext, const cell_t *params)
 		return pContext->ThrowNativeError("Invalid game event handle %x (error %d)", hndl, err);
 	}
 
+	if (!pInfo->pEvent)
+	{
+		return pContext->ThrowNativeError("Game event handle %x is no longer valid", hndl);
+	}
+
 	char *key;
 	pContext->LocalToString(params[2], &key);
 
@@ -389,6 +642,11 @@ static cell_t sm_SetEventFloat(IPluginContext *pContext, const cell_t *params)
 		return pContext->ThrowNativeError("Invalid game event handle %x (error %d)", hndl, err);
 	}
 
+	if (!pInfo->pEvent)
+	{
+		return pContext->ThrowNativeError("Game event handle %x is no longer valid", hndl);
+	}
+
 	char *key;
 	pContext->LocalToString(params[2], &key);
 
@@ -411,6 +669,11 @@ static cell_t sm_SetEventString(IPluginContext *pContext, const cell_t *params)
 		return pContext->ThrowNativeError("Invalid game event handle %x (error %d)", hndl, err);
 	}
 
+	if (!pInfo->pEvent)
+	{
+		return pContext->ThrowNativeError("Game event handle %x is no longer valid", hndl);
+	}
+
 	char *key, *value;
 	pContext->LocalToString(params[2], &key);
 	pContext->LocalToString(params[3], &value);
@@ -433,6 +696,11 @@ static cell_t sm_SetEventBroadcast(IPluginContext *pContext, const cell_t *param
 		return pContext->ThrowNativeError("Invalid game event handle %x (error %d)", hndl, err);
 	}
 
+	if (!pInfo->pEvent)
+	{
+		return pContext->ThrowNativeError("Game event handle %x is no longer valid", hndl);
+	}
+
 	pInfo->bDontBroadcast = params[2] ? true : false;
 
 	return 1;
@@ -451,6 +719,11 @@ static cell_t sm_GetEventBroadcast(IPluginContext *pContext, const cell_t *param
 		return pContext->ThrowNativeError("Invalid game event handle %x (error %d)", hndl, err);
 	}
 
+	if (!pInfo->pEvent)
+	{
+		return pContext->ThrowNativeError("Game event handle %x is no longer valid", hndl);
+	}
+
 	return pInfo->bDontBroadcast;
 }
 
@@ -458,6 +731,7 @@ REGISTER_NATIVES(gameEventNatives)
 {
 	{"HookEvent",			sm_HookEvent},
 	{"HookEventEx",			sm_HookEventEx},
+	{"HookEventFiltered",	sm_HookEventFiltered},
 	{"UnhookEvent",			sm_UnhookEvent},
 	{"CreateEvent",			sm_CreateEvent},
 	{"FireEvent",			sm_FireEvent},
@@ -489,6 +763,15 @@ REGISTER_NATIVES(gameEventNatives)
 	{"Event.BroadcastDisabled.set", sm_SetEventBroadcast},
 	{"Event.BroadcastDisabled.get", sm_GetEventBroadcast},
 
+	{"EventFilter.EventFilter",		sm_CreateEventFilter},
+	{"EventFilter.IntEquals",		sm_EventFilterIntEquals},
+	{"EventFilter.IntRange",		sm_EventFilterIntRange},
+	{"EventFilter.IntInSet",		sm_EventFilterIntInSet},
+	{"EventFilter.FloatRange",		sm_EventFilterFloatRange},
+	{"EventFilter.StringEquals",	sm_EventFilterStringEquals},
+	{"EventFilter.ClientTeam",		sm_EventFilterClientTeam},
+	{"EventFilter.ClientIsBot",		sm_EventFilterClientIsBot},
+
 	{NULL,					NULL}
 };
 
@@ -40,6 +40,7 @@
 #include <KeyValues.h>
 #include "utlbuffer.h"
 #include "logic_bridge.h"
+#include "KeyValuesBinary.h"
 
 HandleType_t g_KeyValueType;
 
@@ -1280,6 +1281,78 @@ static cell_t smn_KeyValuesExportLength(IPluginContext *pContext, const cell_t *
 	return (cell_t)buffer.TellPut();
 }
 
+static cell_t KeyValues_ExportToBinaryFile(IPluginContext *pContext, const cell_t *params)
+{
+	Handle_t hndl = static_cast<Handle_t>(params[1]);
+	HandleError herr;
+	HandleSecurity sec;
+	KeyValueStack *pStk;
+
+	sec.pOwner = NULL;
+	sec.pIdentity = g_pCoreIdent;
+
+	if ((herr=handlesys->ReadHandle(hndl, g_KeyValueType, &sec, (void **)&pStk))
+		!= HandleError_None)
+	{
+		return pContext->ThrowNativeError("Invalid key value handle %x (error %d)", hndl, herr);
+	}
+
+	char *path;
+	char realpath[PLATFORM_MAX_PATH];
+	pContext->LocalToString(params[2], &path);
+	g_SourceMod.BuildPath(Path_Game, realpath, sizeof(realpath), "%s", path);
+
+	std::unique_ptr<KeyValuesSnapshot> snapshot(new KeyValuesSnapshot);
+	if (!snapshot->Capture(pStk->pCurRoot.front()))
+		return 0;
+
+	/* Both paths go through the async file workers, so a synchronous save
+	 * can't be overtaken by, or overtake, an async one to the same file.
+	 */
+	if (!params[3])
+	{
+		KeyValuesSaveTask task(std::move(snapshot), realpath, path, NULL, 0);
+		logicore.RunFileTaskNow(realpath, &task);
+		return task.success() ? 1 : 0;
+	}
+
+	IPluginFunction *callback = NULL;
+	if (!pContext->GetFunctionByIdOrNull(params[4], &callback))
+		return 0;
+
+	KeyValuesSaveTask *task = new KeyValuesSaveTask(std::move(snapshot), realpath, path, callback, params[5]);
+	return logicore.QueueFileTask(realpath, pContext->GetIdentity(), task) ? 1 : 0;
+}
+
+static cell_t KeyValues_ImportFromBinaryFile(IPluginContext *pContext, const cell_t *params)
+{
+	Handle_t hndl = static_cast<Handle_t>(params[1]);
+	HandleError herr;
+	HandleSecurity sec;
+	KeyValueStack *pStk;
+
+	sec.pOwner = NULL;
+	sec.pIdentity = g_pCoreIdent;
+
+	if ((herr=handlesys->ReadHandle(hndl, g_KeyValueType, &sec, (void **)&pStk))
+		!= HandleError_None)
+	{
+		return pContext->ThrowNativeError("Invalid key value handle %x (error %d)", hndl, herr);
+	}
+
+	char *path;
+	char realpath[PLATFORM_MAX_PATH];
+	pContext->LocalToString(params[2], &path);
+	g_SourceMod.BuildPath(Path_Game, realpath, sizeof(realpath), "%s", path);
+
+	KeyValuesLoadTask task(realpath);
+	logicore.RunFileTaskNow(realpath, &task);
+	if (!task.success())
+		return 0;
+
+	return KeyValuesBinary::Decode(pStk->pCurRoot.front(), task.data().data(), task.data().size()) ? 1 : 0;
+}
+
 static KeyValueNatives s_KeyValueNatives;
 
 REGISTER_NATIVES(keyvaluenatives)
@@ -1356,6 +1429,8 @@ REGISTER_NATIVES(keyvaluenatives)
 	{"KeyValues.ImportFromString",		smn_StringToKeyValues},
 	{"KeyValues.ExportToFile",			smn_KeyValuesToFile},
 	{"KeyValues.ExportToString",		smn_KeyValuesToString},
+	{"KeyValues.ExportToBinaryFile",	KeyValues_ExportToBinaryFile},
+	{"KeyValues.ImportFromBinaryFile",	KeyValues_ImportFromBinaryFile},
 	{"KeyValues.ExportLength.get",		smn_KeyValuesExportLength},
 	{"KeyValues.Merge",					KeyValues_Merge},
 
@@ -36,10 +36,15 @@
 # include "UserMessagePBHelpers.h"
 #endif
 #include <bridge/include/IScriptManager.h>
+#include <bitset>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 HandleType_t g_ProtobufType = NO_HANDLE_TYPE;
 HandleType_t g_WrBitBufType = NO_HANDLE_TYPE;
 HandleType_t g_RdBitBufType = NO_HANDLE_TYPE;
+HandleType_t g_UserMsgBatchType = NO_HANDLE_TYPE;
 
 Handle_t g_CurMsgHandle;
 
@@ -54,6 +59,64 @@ bool g_IsMsgInExec = false;
 typedef List<MsgListenerWrapper *> MsgWrapperList;
 typedef List<MsgListenerWrapper *>::iterator MsgWrapperIter;
 
+struct UserMsgBatchEntry
+{
+	std::vector<cell_t> clients;
+	std::string payload;
+	unsigned int bits;
+};
+
+/* Collects per-recipient payloads of one message type, so they can be
+ * encoded once and sent with identical payloads merged into one filter.
+ */
+struct UserMsgBatch
+{
+	UserMsgBatch(int msgid, int flags)
+	 : msgid(msgid), flags(flags), writer(BAD_HANDLE), writingTemplate(false)
+#ifdef USE_PROTOBUF_USERMESSAGES
+	 , msg(NULL), tmpl(NULL)
+#else
+	 , tmplBits(0)
+	 , bf(data, sizeof(data))
+#endif
+	{
+	}
+	~UserMsgBatch()
+	{
+		FreeWriter();
+#ifdef USE_PROTOBUF_USERMESSAGES
+		delete msg;
+		delete tmpl;
+#endif
+	}
+	void FreeWriter()
+	{
+		if (writer != BAD_HANDLE)
+		{
+			HandleSecurity sec(NULL, g_pCoreIdent);
+			handlesys->FreeHandle(writer, &sec);
+			writer = BAD_HANDLE;
+		}
+	}
+
+	int msgid;
+	int flags;
+	std::vector<UserMsgBatchEntry> entries;
+	Handle_t writer;
+	bool writingTemplate;
+#ifdef USE_PROTOBUF_USERMESSAGES
+	protobuf::Message *msg;
+	/* Fields shared by every AddTexts payload */
+	protobuf::Message *tmpl;
+#else
+	unsigned char data[2500];
+	bf_write bf;
+	/* Bits written before the text of every AddTexts payload */
+	std::string tmplPayload;
+	unsigned int tmplBits;
+#endif
+};
+
 class UsrMessageNatives :
 	public SMGlobalClass,
 	public IHandleTypeDispatch,
@@ -101,6 +164,8 @@ void UsrMessageNatives::OnSourceModAllInitialized()
 	g_ReadBufHandle = handlesys->CreateHandle(g_RdBitBufType, &g_ReadBitBuf, NULL, g_pCoreIdent, NULL);
 #endif
 
+	g_UserMsgBatchType = handlesys->CreateType("UserMsgBatch", this, 0, NULL, NULL, g_pCoreIdent, NULL);
+
 	scripts->AddPluginsListener(this);
 }
 
@@ -109,6 +174,10 @@ void UsrMessageNatives::OnSourceModShutdown()
 	HandleSecurity sec;
 	sec.pIdentity = g_pCoreIdent;
 
+	/* Batches own writer handles, so they go first */
+	handlesys->RemoveType(g_UserMsgBatchType, g_pCoreIdent);
+	g_UserMsgBatchType = 0;
+
 #ifdef USE_PROTOBUF_USERMESSAGES
 	handlesys->RemoveType(g_ProtobufType, g_pCoreIdent);
 
@@ -126,6 +195,12 @@ void UsrMessageNatives::OnSourceModShutdown()
 
 void UsrMessageNatives::OnHandleDestroy(HandleType_t type, void *object)
 {
+	if (type == g_UserMsgBatchType)
+	{
+		delete (UserMsgBatch *)object;
+		return;
+	}
+
 #ifdef USE_PROTOBUF_USERMESSAGES
 	delete (SMProtobufMessage *)object;
 #endif
@@ -133,6 +208,25 @@ void UsrMessageNatives::OnHandleDestroy(HandleType_t type, void *object)
 
 bool UsrMessageNatives::GetHandleApproxSize(HandleType_t type, void *object, unsigned int *pSize)
 {
+	if (type == g_UserMsgBatchType)
+	{
+		UserMsgBatch *batch = (UserMsgBatch *)object;
+		*pSize = sizeof(UserMsgBatch);
+		for (size_t i = 0; i < batch->entries.size(); i++)
+		{
+			*pSize += batch->entries[i].payload.size() + batch->entries[i].clients.size() * sizeof(cell_t);
+		}
+#ifdef USE_PROTOBUF_USERMESSAGES
+		if (batch->tmpl)
+		{
+			*pSize += batch->tmpl->SpaceUsed();
+		}
+#else
+		*pSize += batch->tmplPayload.size();
+#endif
+		return true;
+	}
+
 #ifdef USE_PROTOBUF_USERMESSAGES
 	// Different messages have different sizes, but this works as an approximate
 	*pSize = sizeof(protobuf::Message) + sizeof(SMProtobufMessage);
@@ -549,6 +643,408 @@ static cell_t smn_EndMessage(IPluginContext *pCtx, const cell_t *params)
 	return 1;
 }
 
+static UserMsgBatch *ReadUserMsgBatch(IPluginContext *pCtx, Handle_t hndl)
+{
+	HandleError herr;
+	HandleSecurity sec(pCtx->GetIdentity(), g_pCoreIdent);
+	UserMsgBatch *batch;
+
+	if ((herr=handlesys->ReadHandle(hndl, g_UserMsgBatchType, &sec, (void **)&batch))
+		!= HandleError_None)
+	{
+		pCtx->ThrowNativeError("Invalid user message batch handle %x (error %d)", hndl, herr);
+		return NULL;
+	}
+
+	return batch;
+}
+
+/* Moves the payload written through the current writer handle into its entry */
+static void CaptureBatchPayload(UserMsgBatch *batch)
+{
+	if (batch->writer == BAD_HANDLE)
+	{
+		return;
+	}
+
+	if (batch->writingTemplate)
+	{
+#ifdef USE_PROTOBUF_USERMESSAGES
+		if (!batch->tmpl)
+		{
+			batch->tmpl = batch->msg->New();
+		}
+		batch->tmpl->CopyFrom(*batch->msg);
+		batch->msg->Clear();
+#else
+		batch->tmplPayload.assign((const char *)batch->bf.GetBasePointer(), batch->bf.GetNumBytesWritten());
+		batch->tmplBits = batch->bf.GetNumBitsWritten();
+#endif
+		batch->writingTemplate = false;
+		batch->FreeWriter();
+		return;
+	}
+
+	UserMsgBatchEntry &entry = batch->entries.back();
+
+#ifdef USE_PROTOBUF_USERMESSAGES
+	batch->msg->SerializePartialToString(&entry.payload);
+	entry.bits = entry.payload.size() * 8;
+	batch->msg->Clear();
+#else
+	entry.payload.assign((const char *)batch->bf.GetBasePointer(), batch->bf.GetNumBytesWritten());
+	entry.bits = batch->bf.GetNumBitsWritten();
+#endif
+
+	batch->FreeWriter();
+}
+
+static cell_t smn_CreateUserMessageBatch(IPluginContext *pCtx, const cell_t *params)
+{
+	char *msgname;
+	int msgid;
+
+	pCtx->LocalToString(params[1], &msgname);
+
+	if ((msgid=g_UserMsgs.GetMessageIndex(msgname)) == INVALID_MESSAGE_ID)
+	{
+		return pCtx->ThrowNativeError("Invalid message name: \"%s\"", msgname);
+	}
+
+	UserMsgBatch *batch = new UserMsgBatch(msgid, params[2]);
+	Handle_t hndl = handlesys->CreateHandle(g_UserMsgBatchType, batch, pCtx->GetIdentity(), g_pCoreIdent, NULL);
+	if (!hndl)
+	{
+		delete batch;
+	}
+
+	return hndl;
+}
+
+/* Hands out a writer for the batch's scratch message. The writer has no
+ * owner, so only the batch can free it.
+ */
+static Handle_t CreateBatchWriter(UserMsgBatch *batch)
+{
+#ifdef USE_PROTOBUF_USERMESSAGES
+	if (!batch->msg)
+	{
+		batch->msg = g_UserMsgs.GetMessagePrototype(batch->msgid)->New();
+	}
+	batch->msg->Clear();
+	batch->writer = handlesys->CreateHandle(g_ProtobufType, new SMProtobufMessage(batch->msg), NULL, g_pCoreIdent, NULL);
+#else
+	batch->bf.Reset();
+	batch->writer = handlesys->CreateHandle(g_WrBitBufType, &batch->bf, NULL, g_pCoreIdent, NULL);
+#endif
+	return batch->writer;
+}
+
+static bool ValidateBatchClients(IPluginContext *pCtx, const cell_t *clients, unsigned int numClients)
+{
+	for (unsigned int i = 0; i < numClients; i++)
+	{
+		int client = clients[i];
+		CPlayer *pPlayer = g_Players.GetPlayerByIndex(client);
+
+		if (!pPlayer)
+		{
+			pCtx->ThrowNativeError("Client index %d is invalid", client);
+			return false;
+		} else if (!pPlayer->IsConnected()) {
+			pCtx->ThrowNativeError("Client %d is not connected", client);
+			return false;
+		}
+	}
+	return true;
+}
+
+static cell_t smn_UserMessageBatch_StartTemplate(IPluginContext *pCtx, const cell_t *params)
+{
+	UserMsgBatch *batch = ReadUserMsgBatch(pCtx, params[1]);
+	if (!batch)
+	{
+		return 0;
+	}
+
+	CaptureBatchPayload(batch);
+
+	batch->writingTemplate = true;
+	return CreateBatchWriter(batch);
+}
+
+/* Reads entry |index| of a char[][] parameter */
+static char *GetStringArrayEntry(IPluginContext *pCtx, cell_t *array, cell_t index, bool direct)
+{
+	if (!direct)
+	{
+		return (char *)(&array[index]) + array[index];
+	}
+
+	ARRAY_PTR handle;
+	if (pCtx->LocalToArrayPtr(array[index], &handle) != SP_ERROR_NONE)
+	{
+		return NULL;
+	}
+	return (char *)pCtx->GetArrayData(handle);
+}
+
+static cell_t smn_UserMessageBatch_AddTexts(IPluginContext *pCtx, const cell_t *params)
+{
+	UserMsgBatch *batch = ReadUserMsgBatch(pCtx, params[1]);
+	if (!batch)
+	{
+		return 0;
+	}
+
+	cell_t *clients, *texts;
+	cell_t count = params[4];
+	bool direct = pCtx->GetRuntime()->UsesDirectArrays();
+
+	pCtx->LocalToPhysAddr(params[2], &clients);
+	if (direct)
+	{
+		ARRAY_PTR handle;
+		if (pCtx->LocalToArrayPtr(params[3], &handle) != SP_ERROR_NONE)
+		{
+			return 0;
+		}
+		texts = (cell_t *)pCtx->GetArrayData(handle);
+	}
+	else
+	{
+		pCtx->LocalToPhysAddr(params[3], &texts);
+	}
+
+	if (count < 0)
+	{
+		return pCtx->ThrowNativeError("Invalid text count %d", count);
+	}
+	if (!ValidateBatchClients(pCtx, clients, count))
+	{
+		return 0;
+	}
+
+	CaptureBatchPayload(batch);
+
+#ifdef USE_PROTOBUF_USERMESSAGES
+	char *fieldName;
+	pCtx->LocalToString(params[5], &fieldName);
+
+	if (!batch->msg)
+	{
+		batch->msg = g_UserMsgs.GetMessagePrototype(batch->msgid)->New();
+	}
+
+	protobuf::Message *msg = batch->msg;
+	const protobuf::FieldDescriptor *field = msg->GetDescriptor()->FindFieldByName(fieldName);
+	if (!field || field->cpp_type() != protobuf::FieldDescriptor::CPPTYPE_STRING)
+	{
+		return pCtx->ThrowNativeError("Field \"%s\" is not a string field of %s", fieldName, msg->GetTypeName().c_str());
+	}
+	const protobuf::Reflection *reflection = msg->GetReflection();
+#endif
+
+	batch->entries.reserve(batch->entries.size() + count);
+	for (cell_t i = 0; i < count; i++)
+	{
+		const char *text = GetStringArrayEntry(pCtx, texts, i, direct);
+		if (!text)
+		{
+			return pCtx->ThrowNativeError("Invalid text at index %d", i);
+		}
+
+		batch->entries.push_back(UserMsgBatchEntry());
+		UserMsgBatchEntry &entry = batch->entries.back();
+		entry.clients.assign(1, clients[i]);
+
+#ifdef USE_PROTOBUF_USERMESSAGES
+		if (batch->tmpl)
+		{
+			msg->CopyFrom(*batch->tmpl);
+		}
+		else
+		{
+			msg->Clear();
+		}
+
+		if (field->is_repeated())
+		{
+			reflection->AddString(msg, field, text);
+		}
+		else
+		{
+			reflection->SetString(msg, field, text);
+		}
+
+		msg->SerializePartialToString(&entry.payload);
+		entry.bits = entry.payload.size() * 8;
+#else
+		batch->bf.Reset();
+		if (batch->tmplBits)
+		{
+			bf_read reader;
+			reader.StartReading(batch->tmplPayload.data(), batch->tmplPayload.size());
+			batch->bf.WriteBitsFromBuffer(&reader, batch->tmplBits);
+		}
+		batch->bf.WriteString(text);
+		if (batch->bf.IsOverflowed())
+		{
+			batch->entries.pop_back();
+			return pCtx->ThrowNativeError("Text at index %d does not fit in a user message", i);
+		}
+
+		entry.payload.assign((const char *)batch->bf.GetBasePointer(), batch->bf.GetNumBytesWritten());
+		entry.bits = batch->bf.GetNumBitsWritten();
+#endif
+	}
+
+#ifdef USE_PROTOBUF_USERMESSAGES
+	msg->Clear();
+#endif
+
+	return count;
+}
+
+static cell_t smn_UserMessageBatch_AddPayload(IPluginContext *pCtx, const cell_t *params)
+{
+	UserMsgBatch *batch = ReadUserMsgBatch(pCtx, params[1]);
+	if (!batch)
+	{
+		return 0;
+	}
+
+	cell_t *cl_array;
+	unsigned int numClients = params[3];
+
+	pCtx->LocalToPhysAddr(params[2], &cl_array);
+
+	if (!ValidateBatchClients(pCtx, cl_array, numClients))
+	{
+		return 0;
+	}
+
+	CaptureBatchPayload(batch);
+
+	batch->entries.push_back(UserMsgBatchEntry());
+	batch->entries.back().clients.assign(cl_array, cl_array + numClients);
+	batch->entries.back().bits = 0;
+
+	return CreateBatchWriter(batch);
+}
+
+static cell_t smn_UserMessageBatch_Send(IPluginContext *pCtx, const cell_t *params)
+{
+	UserMsgBatch *batch = ReadUserMsgBatch(pCtx, params[1]);
+	if (!batch)
+	{
+		return 0;
+	}
+
+	if (g_IsMsgInExec)
+	{
+		return pCtx->ThrowNativeError("Unable to execute a new message, there is already one in progress");
+	}
+
+	CaptureBatchPayload(batch);
+
+	struct PayloadGroup
+	{
+		const UserMsgBatchEntry *entry;
+		std::vector<cell_t> clients;
+		std::bitset<SM_MAXPLAYERS + 1> seen;
+	};
+
+	/* Merge the recipients of identical payloads */
+	std::vector<PayloadGroup> groups;
+	std::unordered_map<std::string, size_t> lookup;
+	for (size_t i = 0; i < batch->entries.size(); i++)
+	{
+		const UserMsgBatchEntry &entry = batch->entries[i];
+
+		std::string key(entry.payload);
+		key.append((const char *)&entry.bits, sizeof(entry.bits));
+
+		auto iter = lookup.find(key);
+		size_t index;
+		if (iter == lookup.end())
+		{
+			index = groups.size();
+			lookup.emplace(std::move(key), index);
+			groups.push_back(PayloadGroup());
+			groups.back().entry = &entry;
+		} else {
+			index = iter->second;
+		}
+
+		PayloadGroup &group = groups[index];
+		for (size_t j = 0; j < entry.clients.size(); j++)
+		{
+			int client = entry.clients[j];
+			CPlayer *pPlayer = g_Players.GetPlayerByIndex(client);
+
+			/* Clients may have left since the payload was added */
+			if (!pPlayer || !pPlayer->IsConnected() || group.seen.test(client))
+			{
+				continue;
+			}
+
+			group.seen.set(client);
+			group.clients.push_back(client);
+		}
+	}
+
+	cell_t sent = 0;
+	for (size_t i = 0; i < groups.size(); i++)
+	{
+		PayloadGroup &group = groups[i];
+		if (group.clients.empty())
+		{
+			continue;
+		}
+
+#ifdef USE_PROTOBUF_USERMESSAGES
+		protobuf::Message *msg = g_UserMsgs.StartProtobufMessage(batch->msgid, &group.clients[0], group.clients.size(), batch->flags);
+		if (!msg)
+		{
+			batch->entries.clear();
+			return pCtx->ThrowNativeError("Unable to execute a new message while in hook");
+		}
+
+		msg->ParsePartialFromString(group.entry->payload);
+#else
+		bf_write *pBitBuf = g_UserMsgs.StartBitBufMessage(batch->msgid, &group.clients[0], group.clients.size(), batch->flags);
+		if (!pBitBuf)
+		{
+			batch->entries.clear();
+			return pCtx->ThrowNativeError("Unable to execute a new message while in hook");
+		}
+
+		bf_read reader;
+		reader.StartReading(group.entry->payload.data(), group.entry->payload.size());
+		pBitBuf->WriteBitsFromBuffer(&reader, group.entry->bits);
+#endif
+
+		g_UserMsgs.EndMessage();
+		sent++;
+	}
+
+	batch->entries.clear();
+
+	return sent;
+}
+
+static cell_t smn_UserMessageBatch_LengthGet(IPluginContext *pCtx, const cell_t *params)
+{
+	UserMsgBatch *batch = ReadUserMsgBatch(pCtx, params[1]);
+	if (!batch)
+	{
+		return 0;
+	}
+
+	return batch->entries.size();
+}
+
 static cell_t smn_HookUserMessage(IPluginContext *pCtx, const cell_t *params)
 {
 	IPluginFunction *pHook, *pNotify;
@@ -623,5 +1119,11 @@ REGISTER_NATIVES(usrmsgnatives)
 	{"EndMessage",					smn_EndMessage},
 	{"HookUserMessage",				smn_HookUserMessage},
 	{"UnhookUserMessage",			smn_UnhookUserMessage},
+	{"UserMessageBatch.UserMessageBatch",	smn_CreateUserMessageBatch},
+	{"UserMessageBatch.AddPayload",			smn_UserMessageBatch_AddPayload},
+	{"UserMessageBatch.StartTemplate",		smn_UserMessageBatch_StartTemplate},
+	{"UserMessageBatch.AddTexts",			smn_UserMessageBatch_AddTexts},
+	{"UserMessageBatch.Send",				smn_UserMessageBatch_Send},
+	{"UserMessageBatch.Length.get",			smn_UserMessageBatch_LengthGet},
 	{NULL,							NULL}
 };
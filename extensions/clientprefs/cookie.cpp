@@ -35,6 +35,16 @@
 
 CookieManager g_CookieManager;
 
+/* Flush the write-behind buffer early once this many writes are pending */
+#define MAX_PENDING_WRITES 512
+/* Give up on a write once it has been part of this many failed batches */
+#define MAX_WRITE_ATTEMPTS 3
+
+static void FormatWriteKey(char *key, size_t maxlength, int cookieId, const char *steamId)
+{
+	g_pSM->Format(key, maxlength, "%d:%s", cookieId, steamId);
+}
+
 CookieManager::CookieManager()
 {
 	for (int i=0; i<=SM_MAXPLAYERS; i++)
@@ -46,6 +56,7 @@ CookieManager::CookieManager()
 
 	cookieDataLoadedForward = NULL;
 	clientMenu = NULL;
+	writeSequence = 0;
 }
 CookieManager::~CookieManager(){}
 
@@ -58,6 +69,8 @@ void CookieManager::Unload()
 			OnClientDisconnecting(i);
 	}
 
+	FlushCookieWrites();
+
 	/* Find all cookies and delete them */
 	for (size_t iter = 0; iter < cookieList.size(); ++iter)
 		delete cookieList[iter];
@@ -157,13 +170,83 @@ void CookieManager::OnClientAuthorized(int client, const char *authstring)
 	statsPending[client] = true;
 
 	g_ClientPrefs.AttemptReconnection();
-	
-	TQueryOp *op = new TQueryOp(Query_SelectData, player->GetSerial());
-	UTIL_strncpy(op->m_params.steamId, GetPlayerCompatAuthId(player), MAX_NAME_LENGTH);
+
+	/* Buffered writes must reach the database before this player's values are read back */
+	if (!pendingWrites.empty())
+		FlushCookieWrites();
+
+	/* Players authorizing close together (e.g. after a map change) are selected in one query */
+	PendingLoad load;
+	load.serial = player->GetSerial();
+	UTIL_strncpy(load.steamId, GetPlayerCompatAuthId(player), MAX_NAME_LENGTH);
+
+	/* Queued behind the cache writes above, the remote result is merged in when it arrives */
+	g_ClientPrefs.LoadFromLocalCache(load.serial, load.steamId);
+
+	if (pendingLoads.empty())
+		g_ClientPrefs.ScheduleLoadFlush();
+	pendingLoads.push_back(load);
+}
+
+void CookieManager::FlushPendingLoads()
+{
+	if (pendingLoads.empty())
+		return;
+
+	TQueryOp *op;
+	if (pendingLoads.size() == 1)
+	{
+		op = new TQueryOp(Query_SelectData, pendingLoads[0].serial);
+		UTIL_strncpy(op->m_params.steamId, pendingLoads[0].steamId, MAX_NAME_LENGTH);
+	}
+	else
+	{
+		op = new TQueryOp(Query_SelectBatch, 0);
+		op->m_params.loads = pendingLoads;
+	}
+	pendingLoads.clear();
 
 	g_ClientPrefs.AddQueryToQueue(op);
 }
 
+void CookieManager::LocalCacheCallback(int serial, IQuery *data)
+{
+	int client;
+
+	/* The database may have answered first, its values replace the local ones anyway */
+	if ((client = playerhelpers->GetClientFromSerial(serial)) == 0 || statsLoaded[client])
+		return;
+
+	IResultSet *results;
+	if (data == NULL || (results = data->GetResultSet()) == NULL || results->GetRowCount() == 0)
+		return;
+
+	IResultRow *row;
+	while (results->MoreRows() && ((row = results->FetchRow()) != NULL))
+	{
+		const char *name = "";
+		row->GetString(0, &name, NULL);
+
+		/* Only cookies registered this session, descriptions aren't cached */
+		Cookie *parent = FindCookie(name);
+		if (parent == NULL || parent->data[client] != NULL)
+			continue;
+
+		const char *value = "";
+		row->GetString(1, &value, NULL);
+
+		unsigned int timestamp;
+		CookieData *pData = new CookieData(value);
+		pData->changed = false;
+		pData->timestamp = (row->GetInt(2, (int *)&timestamp) == DBVal_Data) ? timestamp : 0;
+		pData->parent = parent;
+		parent->data[client] = pData;
+		clientData[client].push_back(pData);
+	}
+
+	FinishClientLoad(client);
+}
+
 void CookieManager::OnClientDisconnecting(int client)
 {
 	connected[client] = false;
@@ -198,20 +281,132 @@ void CookieManager::OnClientDisconnecting(int client)
 			continue;
 		}
 
-		TQueryOp *op = new TQueryOp(Query_InsertData, client);
-
-		UTIL_strncpy(op->m_params.steamId, pAuth, MAX_NAME_LENGTH);
-		op->m_params.cookieId = dbId;
-		op->m_params.data = current;
-
-		g_ClientPrefs.AddQueryToQueue(op);
+		QueueCookieWrite(current->parent, pAuth, current->value, current->timestamp);
 
 		current->parent->data[client] = NULL;
+		delete current;
 	}
 	
 	clientvec.clear();
 }
 
+void CookieManager::QueueCookieWrite(Cookie *pCookie, const char *steamId, const char *value, time_t timestamp)
+{
+	int cookieId = pCookie->dbid;
+	char key[MAX_NAME_LENGTH + 16];
+	FormatWriteKey(key, sizeof(key), cookieId, steamId);
+
+	writeStats.queued++;
+
+	unsigned int sequence = ++writeSequence;
+	latestWrites[key] = sequence;
+
+	/* Only the newest value of a cookie needs to be written */
+	auto iter = pendingIndex.find(key);
+	if (iter != pendingIndex.end())
+	{
+		CookieWrite &write = pendingWrites[iter->second];
+		UTIL_strncpy(write.value, value, MAX_VALUE_LENGTH);
+		write.timestamp = timestamp;
+		write.sequence = sequence;
+		writeStats.coalesced++;
+		return;
+	}
+
+	CookieWrite write;
+	UTIL_strncpy(write.steamId, steamId, MAX_NAME_LENGTH);
+	write.cookieId = cookieId;
+	UTIL_strncpy(write.name, pCookie->name, MAX_NAME_LENGTH);
+	UTIL_strncpy(write.value, value, MAX_VALUE_LENGTH);
+	write.timestamp = timestamp;
+	write.attempts = 0;
+	write.sequence = sequence;
+
+	pendingIndex[key] = pendingWrites.size();
+	pendingWrites.push_back(write);
+
+	if (pendingWrites.size() >= MAX_PENDING_WRITES)
+		FlushCookieWrites();
+}
+
+void CookieManager::FlushCookieWrites()
+{
+	if (pendingWrites.empty())
+		return;
+
+	/* Batches go through the same queue as every other query, so they are
+	 * written in the order they were flushed.
+	 */
+	g_ClientPrefs.StoreInLocalCache(pendingWrites);
+
+	TQueryOp *op = new TQueryOp(Query_InsertBatch, 0);
+	op->m_params.batch.swap(pendingWrites);
+	pendingIndex.clear();
+
+	writeStats.flushes++;
+	writeStats.inFlight++;
+
+	g_ClientPrefs.AddQueryToQueue(op);
+}
+
+void CookieManager::WriteBatchCallback(const std::vector<CookieWrite> &rows, bool success, float elapsed)
+{
+	writeStats.inFlight--;
+	writeStats.lastFlushRows = rows.size();
+	writeStats.lastFlushTime = elapsed;
+
+	if (success)
+	{
+		writeStats.rowsWritten += rows.size();
+
+		for (size_t iter = 0; iter < rows.size(); ++iter)
+		{
+			char key[MAX_NAME_LENGTH + 16];
+			FormatWriteKey(key, sizeof(key), rows[iter].cookieId, rows[iter].steamId);
+
+			auto latest = latestWrites.find(key);
+			if (latest != latestWrites.end() && latest->second == rows[iter].sequence)
+				latestWrites.erase(latest);
+		}
+		return;
+	}
+
+	/* The transaction was rolled back, so none of these rows were written. Put them
+	 * back in the buffer for the next flush, unless a newer value of the cookie was
+	 * queued since. That value is either still pending or in a later batch, which
+	 * retries it itself if it fails, so writing this one again could only replace it.
+	 */
+	unsigned int dropped = 0;
+	for (size_t iter = 0; iter < rows.size(); ++iter)
+	{
+		const CookieWrite &write = rows[iter];
+		char key[MAX_NAME_LENGTH + 16];
+		FormatWriteKey(key, sizeof(key), write.cookieId, write.steamId);
+
+		auto latest = latestWrites.find(key);
+		if (latest == latestWrites.end() || latest->second != write.sequence)
+			continue;
+
+		if (write.attempts + 1 >= MAX_WRITE_ATTEMPTS)
+		{
+			latestWrites.erase(latest);
+			dropped++;
+			continue;
+		}
+
+		pendingIndex[key] = pendingWrites.size();
+		pendingWrites.push_back(write);
+		pendingWrites.back().attempts++;
+		writeStats.rowsRetried++;
+	}
+
+	if (dropped > 0)
+	{
+		writeStats.rowsFailed += dropped;
+		g_pSM->LogError(myself, "Dropped %u cookie writes after %d failed attempts", dropped, MAX_WRITE_ATTEMPTS);
+	}
+}
+
 void CookieManager::ClientConnectCallback(int serial, IQuery *data)
 {
 	int client;
@@ -230,41 +425,128 @@ void CookieManager::ClientConnectCallback(int serial, IQuery *data)
 		return;
 	}
 
-	CookieData *pData;
 	IResultRow *row;
-	unsigned int timestamp;
-	CookieAccess access;
+	std::vector<CookieWrite> cacheRows;
 	
 	while (results->MoreRows() && ((row = results->FetchRow()) != NULL))
 	{
-		const char *name = "";
-		row->GetString(0, &name, NULL);
-		
-		const char *value = "";
-		row->GetString(1, &value, NULL);
+		ApplyCookieRow(client, row, cacheRows);
+	}
 
-		pData = new CookieData(value);
-		pData->changed = false;
+	g_ClientPrefs.StoreInLocalCache(cacheRows);
 
-		pData->timestamp = (row->GetInt(4, (int *)&timestamp) == DBVal_Data) ? timestamp : 0;
+	FinishClientLoad(client);
+}
 
-		Cookie *parent = FindCookie(name);
+void CookieManager::LoadBatchCallback(const std::vector<PendingLoad> &loads, IQuery *data)
+{
+	std::vector<int> clients(loads.size());
+	for (size_t iter = 0; iter < loads.size(); ++iter)
+	{
+		clients[iter] = playerhelpers->GetClientFromSerial(loads[iter].serial);
+		if (clients[iter] != 0)
+			statsPending[clients[iter]] = false;
+	}
 
-		if (parent == NULL)
-		{
-			const char *desc = "";
-			row->GetString(2, &desc, NULL);
+	IResultSet *results;
+	if (data == NULL || (results = data->GetResultSet()) == NULL)
+	{
+		return;
+	}
+
+	IResultRow *row;
+	std::vector<CookieWrite> cacheRows;
 
-			access = CookieAccess_Public;
-			row->GetInt(3, (int *)&access);
+	while (results->MoreRows() && ((row = results->FetchRow()) != NULL))
+	{
+		const char *player = "";
+		row->GetString(5, &player, NULL);
 
-			parent = CreateCookie(name, desc, access);
+		for (size_t iter = 0; iter < loads.size(); ++iter)
+		{
+			if (clients[iter] != 0 && strcmp(loads[iter].steamId, player) == 0)
+			{
+				ApplyCookieRow(clients[iter], row, cacheRows);
+				break;
+			}
 		}
+	}
+
+	g_ClientPrefs.StoreInLocalCache(cacheRows);
+
+	for (size_t iter = 0; iter < loads.size(); ++iter)
+	{
+		if (clients[iter] != 0)
+			FinishClientLoad(clients[iter]);
+	}
+}
 
+void CookieManager::ApplyCookieRow(int client, IResultRow *row, std::vector<CookieWrite> &cacheRows)
+{
+	unsigned int timestamp;
+
+	const char *name = "";
+	row->GetString(0, &name, NULL);
+	
+	const char *value = "";
+	row->GetString(1, &value, NULL);
+
+	Cookie *parent = FindCookie(name);
+
+	if (parent == NULL)
+	{
+		const char *desc = "";
+		row->GetString(2, &desc, NULL);
+
+		CookieAccess access = CookieAccess_Public;
+		row->GetInt(3, (int *)&access);
+
+		parent = CreateCookie(name, desc, access);
+	}
+
+	CookieData *pData = parent->data[client];
+
+	if (pData == NULL)
+	{
+		pData = new CookieData(value);
 		pData->parent = parent;
 		parent->data[client] = pData;
 		clientData[client].push_back(pData);
 	}
+	else if (pData->changed)
+	{
+		/* Set by a plugin before the database answered, that value wins */
+		return;
+	}
+	else
+	{
+		/* Replace what the local cache provided */
+		UTIL_strncpy(pData->value, value, MAX_VALUE_LENGTH);
+	}
+
+	pData->changed = false;
+	pData->timestamp = (row->GetInt(4, (int *)&timestamp) == DBVal_Data) ? timestamp : 0;
+
+	IGamePlayer *player = playerhelpers->GetGamePlayer(client);
+	if (player != NULL && g_ClientPrefs.LocalCache)
+	{
+		CookieWrite write;
+		UTIL_strncpy(write.steamId, GetPlayerCompatAuthId(player), MAX_NAME_LENGTH);
+		write.cookieId = parent->dbid;
+		UTIL_strncpy(write.name, parent->name, MAX_NAME_LENGTH);
+		UTIL_strncpy(write.value, pData->value, MAX_VALUE_LENGTH);
+		write.timestamp = pData->timestamp;
+		write.attempts = 0;
+		write.sequence = 0;
+		cacheRows.push_back(write);
+	}
+}
+
+void CookieManager::FinishClientLoad(int client)
+{
+	/* Already announced from the local cache */
+	if (statsLoaded[client])
+		return;
 
 	statsLoaded[client] = true;
 
@@ -35,6 +35,8 @@
 #include "extension.h"
 #include "am-vector.h"
 #include <sm_namehashset.h>
+#include <string>
+#include <unordered_map>
 
 #define MAX_NAME_LENGTH 30
 #define MAX_DESC_LENGTH 255
@@ -62,6 +64,43 @@ struct CookieData
 	Cookie *parent;
 };
 
+/* A cookie value waiting to be written to the database */
+struct CookieWrite
+{
+	char steamId[MAX_NAME_LENGTH];
+	int cookieId;
+	char name[MAX_NAME_LENGTH+1];	/**< Key used by the local cache */
+	char value[MAX_VALUE_LENGTH+1];
+	time_t timestamp;
+	int attempts;					/**< Failed batches this write was part of */
+	unsigned int sequence;			/**< Order in which the value was queued */
+};
+
+/* A player waiting for their cookies to be selected */
+struct PendingLoad
+{
+	int serial;
+	char steamId[MAX_NAME_LENGTH];
+};
+
+struct CookieWriteStats
+{
+	CookieWriteStats()
+	{
+		memset(this, 0, sizeof(*this));
+	}
+
+	unsigned int queued;		/**< Writes added to the buffer */
+	unsigned int coalesced;		/**< Writes that replaced a pending write for the same cookie */
+	unsigned int flushes;		/**< Batches sent to the database */
+	unsigned int inFlight;		/**< Batches sent but not yet completed */
+	unsigned int rowsWritten;
+	unsigned int rowsRetried;	/**< Rows of a failed batch queued again */
+	unsigned int rowsFailed;	/**< Rows dropped after too many failed batches */
+	unsigned int lastFlushRows;
+	float lastFlushTime;		/**< Seconds the last completed batch took */
+};
+
 struct Cookie
 {
 	Cookie(const char *name, const char *description, CookieAccess access)
@@ -118,6 +157,8 @@ public:
 	void Unload();
 
 	void ClientConnectCallback(int serial, IQuery *data);
+	void LoadBatchCallback(const std::vector<PendingLoad> &loads, IQuery *data);
+	void FlushPendingLoads();
 	void InsertCookieCallback(Cookie *pCookie, int dbId);
 	void SelectIdCallback(Cookie *pCookie, IQuery *data);
 
@@ -130,6 +171,20 @@ public:
 	
 	bool AreClientCookiesPending(int client);
 
+	void QueueCookieWrite(Cookie *pCookie, const char *steamId, const char *value, time_t timestamp);
+	void FlushCookieWrites();
+	void LocalCacheCallback(int serial, IQuery *data);
+	void WriteBatchCallback(const std::vector<CookieWrite> &rows, bool success, float elapsed);
+
+	inline size_t GetPendingWriteCount()
+	{
+		return pendingWrites.size();
+	}
+	inline const CookieWriteStats &GetWriteStats()
+	{
+		return writeStats;
+	}
+
 public:
 	IForward *cookieDataLoadedForward;
 	std::vector<Cookie *> cookieList;
@@ -142,6 +197,24 @@ private:
 	bool connected[SM_MAXPLAYERS+1];
 	bool statsLoaded[SM_MAXPLAYERS+1];
 	bool statsPending[SM_MAXPLAYERS+1];
+
+	void ApplyCookieRow(int client, IResultRow *row, std::vector<CookieWrite> &cacheRows);
+	void FinishClientLoad(int client);
+
+	/* Players authorized within the last load batch delay, selected together in one query */
+	std::vector<PendingLoad> pendingLoads;
+
+	/* Write-behind buffer, one entry per (player, cookie) */
+	std::vector<CookieWrite> pendingWrites;
+	std::unordered_map<std::string, size_t> pendingIndex;
+
+	/* Sequence of the newest value queued per (player, cookie) that has not been
+	 * written yet, including values in batches that are still in flight. A failed
+	 * row is only retried while it is still the newest value of its cookie.
+	 */
+	std::unordered_map<std::string, unsigned int> latestWrites;
+	unsigned int writeSequence;
+	CookieWriteStats writeStats;
 };
 
 extern CookieManager g_CookieManager;
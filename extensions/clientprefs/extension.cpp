@@ -51,6 +51,13 @@ CookieIteratorHandler g_CookieIteratorHandler;
 DbDriver g_DriverType;
 
 constexpr auto kReconnectRetryDelay = std::chrono::seconds(30);
+constexpr float kWriteFlushInterval = 5.0f;
+constexpr float kLoadBatchDelay = 0.1f;
+constexpr int kLocalCacheLifetime = 30 * 24 * 60 * 60;
+/* Local cache reads and writes share one queue level so a read sees every earlier write,
+ * and run ahead of the remote queries so a slow database doesn't hold them up.
+ */
+constexpr PrioQueueLevel kLocalCachePriority = PrioQueue_High;
 
 bool ClientPrefs::SDK_OnLoad(char *error, size_t maxlength, bool late)
 {
@@ -66,6 +73,8 @@ bool ClientPrefs::SDK_OnLoad(char *error, size_t maxlength, bool late)
 
 	dbi->AddDependency(myself, Driver);
 
+	this->OpenLocalCache();
+
 	sharesys->AddNatives(myself, g_ClientPrefNatives);
 	sharesys->RegisterLibrary(myself, "clientprefs");
 	identity = sharesys->CreateIdentity(sharesys->CreateIdentType("ClientPrefs"), this);
@@ -93,6 +102,9 @@ bool ClientPrefs::SDK_OnLoad(char *error, size_t maxlength, bool late)
 
 	plsys->AddPluginsListener(&g_CookieManager);
 
+	flushTimer = timersys->CreateTimer(this, kWriteFlushInterval, NULL, TIMER_FLAG_REPEAT);
+	rootconsole->AddRootConsoleCommand3("clientprefs", "Client preferences write statistics", this);
+
 	phrases = translator->CreatePhraseCollection();
 	phrases->AddPhraseFile("clientprefs.phrases");
 	phrases->AddPhraseFile("common.phrases");
@@ -160,6 +172,90 @@ void ClientPrefs::SDK_OnAllLoaded()
 	playerhelpers->AddClientListener(&g_CookieManager);
 }
 
+void ClientPrefs::OpenLocalCache()
+{
+	const char *enabled = g_pSM->GetCoreConfigValue("ClientPrefsLocalCache");
+	if (enabled == NULL || strcasecmp(enabled, "yes") != 0)
+		return;
+
+	/* Nothing to gain if the database is already a local file */
+	if (strcmp(Driver->GetIdentifier(), "sqlite") == 0)
+		return;
+
+	IDBDriver *sqlite = dbi->FindOrLoadDriver("sqlite");
+	if (sqlite == NULL)
+	{
+		g_pSM->LogError(myself, "Could not load the SQLite driver for the local cookie cache");
+		return;
+	}
+
+	DatabaseInfo info;
+	info.host = "";
+	info.database = "clientprefs-cache";
+	info.user = "";
+	info.pass = "";
+	info.driver = "sqlite";
+
+	char error[256];
+	LocalCache = AdoptRef(sqlite->Connect(&info, false, error, sizeof(error)));
+	if (!LocalCache)
+	{
+		g_pSM->LogError(myself, "Could not open the local cookie cache: %s", error);
+		return;
+	}
+
+	if (!LocalCache->DoSimpleQuery(
+			"CREATE TABLE IF NOT EXISTS sm_cookie_local \
+			( \
+				player varchar(65) NOT NULL, \
+				name varchar(30) NOT NULL, \
+				value varchar(100), \
+				timestamp int, \
+				seen int, \
+				PRIMARY KEY (player, name) \
+			)"))
+	{
+		g_pSM->LogError(myself, "Failed to CreateTable sm_cookie_local: %s", LocalCache->GetError());
+		LocalCache = NULL;
+		return;
+	}
+
+	/* Only keep recently seen players */
+	char query[128];
+	g_pSM->Format(query, sizeof(query), "DELETE FROM sm_cookie_local WHERE seen < %d", (int)time(NULL) - kLocalCacheLifetime);
+	LocalCache->DoSimpleQuery(query);
+
+	dbi->AddDependency(myself, sqlite);
+}
+
+void ClientPrefs::StoreInLocalCache(const std::vector<CookieWrite> &rows)
+{
+	if (!LocalCache || rows.empty())
+		return;
+
+	TQueryOp *op = new TQueryOp(Query_StoreLocal, 0);
+	op->m_params.batch = rows;
+	op->SetDatabase(LocalCache);
+	dbi->AddToThreadQueue(op, kLocalCachePriority);
+}
+
+void ClientPrefs::LoadFromLocalCache(int serial, const char *steamId)
+{
+	if (!LocalCache)
+		return;
+
+	TQueryOp *op = new TQueryOp(Query_SelectLocal, serial);
+	UTIL_strncpy(op->m_params.steamId, steamId, MAX_NAME_LENGTH);
+	op->SetDatabase(LocalCache);
+	dbi->AddToThreadQueue(op, kLocalCachePriority);
+}
+
+void ClientPrefs::ScheduleLoadFlush()
+{
+	if (loadTimer == NULL)
+		loadTimer = timersys->CreateTimer(this, kLoadBatchDelay, NULL, 0);
+}
+
 bool ClientPrefs::QueryInterfaceDrop(SMInterface *pInterface)
 {
 	if ((void *)pInterface == (void *)(Database->GetDriver()))
@@ -174,18 +270,33 @@ void ClientPrefs::NotifyInterfaceDrop(SMInterface *pInterface)
 {
 	if (Database && (void *)pInterface == (void *)(Database->GetDriver()))
 		Database = NULL;
+	if (LocalCache && (void *)pInterface == (void *)(LocalCache->GetDriver()))
+		LocalCache = NULL;
 }
 
 void ClientPrefs::SDK_OnDependenciesDropped()
 {
 	// At this point, we're guaranteed that DBI has flushed the worker thread
 	// for us, so no cookies should have outstanding queries.
+	if (flushTimer != NULL)
+	{
+		timersys->KillTimer(flushTimer);
+		flushTimer = NULL;
+	}
+	if (loadTimer != NULL)
+	{
+		timersys->KillTimer(loadTimer);
+		loadTimer = NULL;
+	}
+	rootconsole->RemoveRootConsoleCommand("clientprefs", this);
+
 	g_CookieManager.Unload();
 
 	handlesys->RemoveType(g_CookieType, myself->GetIdentity());
 	handlesys->RemoveType(g_CookieIterator, myself->GetIdentity());
 
 	Database = NULL;
+	LocalCache = NULL;
 
 	if (g_CookieManager.cookieDataLoadedForward != NULL)
 	{
@@ -225,6 +336,40 @@ void ClientPrefs::OnCoreMapStart(edict_t *pEdictList, int edictCount, int client
 	this->AttemptReconnection();
 }
 
+void ClientPrefs::OnCoreMapEnd()
+{
+	g_CookieManager.FlushCookieWrites();
+}
+
+ResultType ClientPrefs::OnTimer(ITimer *pTimer, void *pData)
+{
+	if (pTimer == loadTimer)
+		g_CookieManager.FlushPendingLoads();
+	else
+		g_CookieManager.FlushCookieWrites();
+	return Pl_Continue;
+}
+
+void ClientPrefs::OnTimerEnd(ITimer *pTimer, void *pData)
+{
+	if (pTimer == loadTimer)
+		loadTimer = NULL;
+	else if (pTimer == flushTimer)
+		flushTimer = NULL;
+}
+
+void ClientPrefs::OnRootConsoleCommand(const char *cmdname, const ICommandArgs *command)
+{
+	const CookieWriteStats &stats = g_CookieManager.GetWriteStats();
+
+	rootconsole->ConsolePrint("[SM] Client preferences write-behind buffer:");
+	rootconsole->ConsolePrint("  Pending writes:   %u", (unsigned int)g_CookieManager.GetPendingWriteCount());
+	rootconsole->ConsolePrint("  Queued writes:    %u (%u coalesced)", stats.queued, stats.coalesced);
+	rootconsole->ConsolePrint("  Batches flushed:  %u (%u in flight)", stats.flushes, stats.inFlight);
+	rootconsole->ConsolePrint("  Rows written:     %u (%u retried, %u failed)", stats.rowsWritten, stats.rowsRetried, stats.rowsFailed);
+	rootconsole->ConsolePrint("  Last batch:       %u rows in %.3f ms", stats.lastFlushRows, stats.lastFlushTime * 1000.0f);
+}
+
 void ClientPrefs::AttemptReconnection()
 {
 	if (Database || databaseLoading)
@@ -338,7 +483,8 @@ void ClientPrefs::DatabaseConnect()
 	else if (strcmp(identifier, "pgsql") == 0)
 	{
 		g_DriverType = Driver_PgSQL;
-		// PostgreSQL supports 'IF NOT EXISTS' as of 9.1
+		// PostgreSQL supports 'IF NOT EXISTS' as of 9.1, the cookie upserts
+		// use 'ON CONFLICT' which needs 9.5 or later.
 		if (!Database->DoSimpleQuery(
 				"CREATE TABLE IF NOT EXISTS sm_cookies \
 				( \
@@ -380,28 +526,6 @@ void ClientPrefs::DatabaseConnect()
 			g_pSM->LogMessage(myself, "Failed to CreateTable sm_cookie_cache: %s", Database->GetError());
 			goto fatal_fail;
 		}
-
-		if (!Database->DoSimpleQuery(
-				"CREATE OR REPLACE FUNCTION add_or_update_cookie(in_player VARCHAR(65), in_cookie INT, in_value VARCHAR(100), in_time INT) RETURNS VOID AS \
-					$$ \
-					BEGIN \
-					  LOOP \
-						UPDATE sm_cookie_cache SET value = in_value, timestamp = in_time WHERE player = in_player AND cookie_id = in_cookie; \
-						IF found THEN \
-						  RETURN; \
-						END IF; \
-						BEGIN \
-						  INSERT INTO sm_cookie_cache (player, cookie_id, value, timestamp) VALUES (in_player, in_cookie, in_value, in_time); \
-						  RETURN; \
-						EXCEPTION WHEN unique_violation THEN \
-						END; \
-					  END LOOP; \
-					END; \
-					$$ LANGUAGE plpgsql;"))
-		{
-			g_pSM->LogMessage(myself, "Failed to create function add_or_update_cookie: %s", Database->GetError());
-			goto fatal_fail;
-		}
 	}
 	else
 	{
@@ -595,4 +719,6 @@ ClientPrefs::ClientPrefs()
 	phrases = NULL;
 
 	identity = NULL;
+	flushTimer = NULL;
+	loadTimer = NULL;
 }
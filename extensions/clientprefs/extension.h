@@ -63,7 +63,10 @@ class TQueryOp;
  * @brief Sample implementation of the SDK Extension.
  * Note: Uncomment one of the pre-defined virtual functions in order to use it.
  */
-class ClientPrefs : public SDKExtension
+class ClientPrefs :
+	public SDKExtension,
+	public ITimedEvent,
+	public IRootConsoleCommand
 {
 public:
 	ClientPrefs();
@@ -94,6 +97,7 @@ public:
 	const char *GetExtensionDateString();
 
 	virtual void OnCoreMapStart(edict_t *pEdictList, int edictCount, int clientMax);
+	virtual void OnCoreMapEnd();
 	
 	void DatabaseConnect();
 	bool RefreshDatabaseInfo(char *error, size_t maxlength);
@@ -105,6 +109,11 @@ public:
 	void CatchLateLoadClients();
 	void ClearQueryCache(int serial);
 
+	void ScheduleLoadFlush();
+	void OpenLocalCache();
+	void StoreInLocalCache(const std::vector<CookieWrite> &rows);
+	void LoadFromLocalCache(int serial, const char *steamId);
+
 	/**
 	 * @brief Called when the pause state is changed.
 	 */
@@ -118,6 +127,11 @@ public:
 	 * @return			True if working, false otherwise.
 	 */
 	//virtual bool QueryRunning(char *error, size_t maxlength);
+public: //ITimedEvent
+	ResultType OnTimer(ITimer *pTimer, void *pData);
+	void OnTimerEnd(ITimer *pTimer, void *pData);
+public: //IRootConsoleCommand
+	void OnRootConsoleCommand(const char *cmdname, const ICommandArgs *command);
 public:
 #if defined SMEXT_CONF_METAMOD
 	/**
@@ -156,6 +170,7 @@ public:
 public:
 	IDBDriver *Driver;
 	ke::RefPtr<IDatabase> Database;
+	ke::RefPtr<IDatabase> LocalCache;
 	IPhraseCollection *phrases;
 	DatabaseInfo DBInfo;
 
@@ -172,6 +187,8 @@ private:
 	std::string dbDriver;
 	std::string dbSchemaName;
 	IdentityToken_t *identity;
+	ITimer *flushTimer;
+	ITimer *loadTimer;
 };
 
 class CookieTypeHandler : public IHandleTypeDispatch
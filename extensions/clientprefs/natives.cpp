@@ -130,7 +130,6 @@ cell_t SetAuthIdCookie(IPluginContext *pContext, const cell_t *params)
 		return pContext->ThrowNativeError("Invalid Cookie handle %x (error %d)", hndl, err);
 	}
 
-	int i_dbId = pCookie->dbid;
 	char *value;
 	pContext->LocalToString(params[3], &value);
 
@@ -141,21 +140,8 @@ cell_t SetAuthIdCookie(IPluginContext *pContext, const cell_t *params)
 		return g_CookieManager.SetCookieValue(pCookie, client, value);
 	}
 
-	// constructor calls strncpy for us
-	CookieData *payload = new CookieData(value);
-
-	// set changed so players connecting later in during the same map will have the correct value
-	payload->changed = true;
-	payload->timestamp = time(NULL);
-
-	// edit database table
-	TQueryOp *op = new TQueryOp(Query_InsertData, pCookie);
-	// limit player auth length which doubles for cookie name length
-	UTIL_strncpy(op->m_params.steamId, steamID, MAX_NAME_LENGTH);
-	op->m_params.cookieId = i_dbId;
-	op->m_params.data = payload;
-
-	g_ClientPrefs.AddQueryToQueue(op);
+	// goes through the write-behind buffer so it stays ordered with disconnect writes
+	g_CookieManager.QueueCookieWrite(pCookie, steamID, value, time(NULL));
 
 	return 1;
 }
@@ -30,6 +30,7 @@
  */
 
 #include "query.h"
+#include <algorithm>
 
 
 void TQueryOp::RunThinkPart()
@@ -55,6 +56,24 @@ void TQueryOp::RunThinkPart()
 			break;
 		}
 
+		case Query_InsertBatch:
+		{
+			g_CookieManager.WriteBatchCallback(m_params.batch, m_success, m_elapsed);
+			break;
+		}
+
+		case Query_SelectBatch:
+		{
+			g_CookieManager.LoadBatchCallback(m_params.loads, m_pResult);
+			break;
+		}
+
+		case Query_SelectLocal:
+		{
+			g_CookieManager.LocalCacheCallback(m_serial, m_pResult);
+			break;
+		}
+
 		case Query_Connect:
 		{
 			return;
@@ -78,13 +97,24 @@ void TQueryOp::RunThreadPart()
 	assert(m_database != NULL);
 	/* I don't think this is needed anymore... keeping for now. */
 	m_database->LockForFullAtomicOperation();
-		if (!BindParamsAndRun())
+
+	auto start = std::chrono::steady_clock::now();
+	m_success = BindParamsAndRun();
+	m_elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+	if (!m_success)
 	{
 		g_pSM->LogError(myself, 
 						"Failed SQL Query, Error: \"%s\" (Query id %i - serial %i)", 
 						m_database->GetError(),
 						m_type, 
 						m_serial);
+
+		/* Don't leave a failed batch's transaction open */
+		if (m_type == Query_InsertBatch || m_type == Query_StoreLocal)
+		{
+			m_database->DoSimpleQuery("ROLLBACK");
+		}
 	}
 
 	m_database->UnlockFromFullAtomicOperation();
@@ -117,6 +147,8 @@ TQueryOp::TQueryOp(enum querytype type, int serial)
 	m_driver = NULL;
 	m_insertId = -1;
 	m_pResult = NULL;
+	m_success = false;
+	m_elapsed = 0.0f;
 }
 
 TQueryOp::TQueryOp(enum querytype type, Cookie *cookie)
@@ -128,6 +160,8 @@ TQueryOp::TQueryOp(enum querytype type, Cookie *cookie)
 	m_insertId = -1;
 	m_pResult = NULL;
 	m_serial = 0;
+	m_success = false;
+	m_elapsed = 0.0f;
 }
 
 void TQueryOp::SetDatabase(IDatabase *db)
@@ -220,68 +254,155 @@ bool TQueryOp::BindParamsAndRun()
 			return (m_pResult != NULL);
 		}
 
-		case Query_InsertData:
+		case Query_InsertBatch:
 		{
-			char safe_id[128];
-			char safe_val[MAX_VALUE_LENGTH*2 + 1];
-
-			m_database->QuoteString(m_params.steamId,
-				safe_id,
-				sizeof(safe_id),
-				&ignore);
-			m_database->QuoteString(m_params.data->value,
-				safe_val,
-				sizeof(safe_val),
-				&ignore);
+			/* Write everything in one transaction, several rows per statement */
+			const size_t kRowsPerStatement = 100;
+			std::vector<CookieWrite> &batch = m_params.batch;
 
-			if (g_DriverType == Driver_MySQL)
+			if (!m_database->DoSimpleQuery(g_DriverType == Driver_MySQL ? "START TRANSACTION" : "BEGIN"))
 			{
-				g_pSM->Format(query, 
-					sizeof(query),
-					"INSERT INTO sm_cookie_cache (player, cookie_id, value, timestamp) 	\
-					 VALUES ('%s', %d, '%s', %d)									\
-					 ON DUPLICATE KEY UPDATE											\
-					 value = '%s', timestamp = %d",
-					safe_id,
-					m_params.cookieId,
-					safe_val,
-					(unsigned int)m_params.data->timestamp,
-					safe_val,
-					(unsigned int)m_params.data->timestamp);
+				return false;
 			}
-			else if (g_DriverType == Driver_SQLite)
+
+			for (size_t first = 0; first < batch.size(); first += kRowsPerStatement)
 			{
-				g_pSM->Format(query,
-					sizeof(query),
-					"INSERT OR REPLACE INTO sm_cookie_cache						\
-					 (player, cookie_id, value, timestamp)						\
-					 VALUES ('%s', %d, '%s', %d)",
-					safe_id,
-					m_params.cookieId,
-					safe_val,
-					(unsigned int)m_params.data->timestamp);
+				size_t last = std::min(first + kRowsPerStatement, batch.size());
+				std::string sql;
+
+				if (g_DriverType == Driver_SQLite)
+				{
+					sql = "INSERT OR REPLACE INTO sm_cookie_cache (player, cookie_id, value, timestamp) VALUES ";
+				}
+				else
+				{
+					sql = "INSERT INTO sm_cookie_cache (player, cookie_id, value, timestamp) VALUES ";
+				}
+
+				for (size_t i = first; i < last; i++)
+				{
+					char safe_id[128];
+					char safe_val[MAX_VALUE_LENGTH*2 + 1];
+
+					m_database->QuoteString(batch[i].steamId, safe_id, sizeof(safe_id), &ignore);
+					m_database->QuoteString(batch[i].value, safe_val, sizeof(safe_val), &ignore);
+
+					g_pSM->Format(query,
+						sizeof(query),
+						"%s('%s', %d, '%s', %d)",
+						(i == first) ? "" : ", ",
+						safe_id,
+						batch[i].cookieId,
+						safe_val,
+						(unsigned int)batch[i].timestamp);
+					sql += query;
+				}
+
+				if (g_DriverType == Driver_MySQL)
+				{
+					sql += " ON DUPLICATE KEY UPDATE value = VALUES(value), timestamp = VALUES(timestamp)";
+				}
+				else if (g_DriverType == Driver_PgSQL)
+				{
+					/* Requires PostgreSQL 9.5 or later */
+					sql += " ON CONFLICT (player, cookie_id) DO UPDATE SET value = EXCLUDED.value, timestamp = EXCLUDED.timestamp";
+				}
+
+				if (!m_database->DoSimpleQuery(sql.c_str()))
+				{
+					return false;
+				}
 			}
-			else if (g_DriverType == Driver_PgSQL)
+
+			return m_database->DoSimpleQuery("COMMIT");
+		}
+
+		case Query_SelectBatch:
+		{
+			std::string sql = "SELECT sm_cookies.name, sm_cookie_cache.value, sm_cookies.description, \
+						sm_cookies.access, sm_cookie_cache.timestamp, sm_cookie_cache.player \
+				FROM sm_cookies \
+				JOIN sm_cookie_cache \
+				ON sm_cookies.id = sm_cookie_cache.cookie_id \
+				WHERE player IN (";
+
+			for (size_t i = 0; i < m_params.loads.size(); i++)
 			{
-				// Using a PL/Pgsql function, called add_or_update_cookie(),
-				// since Postgres does not have an 'OR REPLACE' functionality.
-				g_pSM->Format(query,
-					sizeof(query),
-					"SELECT add_or_update_cookie ('%s', %d, '%s', %d)",
-					safe_id,
-					m_params.cookieId,
-					safe_val,
-					(unsigned int)m_params.data->timestamp);
+				char safe_str[128];
+				m_database->QuoteString(m_params.loads[i].steamId, safe_str, sizeof(safe_str), &ignore);
+
+				g_pSM->Format(query, sizeof(query), "%s'%s'", (i == 0) ? "" : ", ", safe_str);
+				sql += query;
 			}
+			sql += ")";
 
-			if (!m_database->DoSimpleQuery(query))
+			m_pResult = m_database->DoQuery(sql.c_str());
+
+			return (m_pResult != NULL);
+		}
+
+		case Query_StoreLocal:
+		{
+			/* The local cache is always SQLite, keyed by cookie name rather than id */
+			const size_t kRowsPerStatement = 100;
+			std::vector<CookieWrite> &batch = m_params.batch;
+			unsigned int now = (unsigned int)time(NULL);
+
+			if (!m_database->DoSimpleQuery("BEGIN"))
 			{
 				return false;
 			}
 
-			m_insertId = m_database->GetInsertID();
+			for (size_t first = 0; first < batch.size(); first += kRowsPerStatement)
+			{
+				size_t last = std::min(first + kRowsPerStatement, batch.size());
+				std::string sql = "INSERT OR REPLACE INTO sm_cookie_local (player, name, value, timestamp, seen) VALUES ";
+
+				for (size_t i = first; i < last; i++)
+				{
+					char safe_id[128];
+					char safe_name[MAX_NAME_LENGTH*2 + 1];
+					char safe_val[MAX_VALUE_LENGTH*2 + 1];
+
+					m_database->QuoteString(batch[i].steamId, safe_id, sizeof(safe_id), &ignore);
+					m_database->QuoteString(batch[i].name, safe_name, sizeof(safe_name), &ignore);
+					m_database->QuoteString(batch[i].value, safe_val, sizeof(safe_val), &ignore);
+
+					g_pSM->Format(query,
+						sizeof(query),
+						"%s('%s', '%s', '%s', %d, %d)",
+						(i == first) ? "" : ", ",
+						safe_id,
+						safe_name,
+						safe_val,
+						(unsigned int)batch[i].timestamp,
+						now);
+					sql += query;
+				}
+
+				if (!m_database->DoSimpleQuery(sql.c_str()))
+				{
+					return false;
+				}
+			}
 
-			return true;
+			return m_database->DoSimpleQuery("COMMIT");
+		}
+
+		case Query_SelectLocal:
+		{
+			char safe_id[128];
+
+			m_database->QuoteString(m_params.steamId, safe_id, sizeof(safe_id), &ignore);
+
+			g_pSM->Format(query,
+				sizeof(query),
+				"SELECT name, value, timestamp FROM sm_cookie_local WHERE player = '%s'",
+				safe_id);
+
+			m_pResult = m_database->DoQuery(query);
+
+			return (m_pResult != NULL);
 		}
 
 		case Query_SelectId:
@@ -326,20 +447,9 @@ int TQueryOp::PullQuerySerial()
 	return m_serial;
 }
 
-ParamData::~ParamData()
-{
-	if (data)
-	{
-		/* Data is only ever passed in a client disconnect query and always needs to be deleted */
-		delete data;
-		data = NULL;
-	}
-}
-
 ParamData::ParamData()
 {
 	cookie = NULL;
-	data = NULL;
 	steamId[0] = '\0';
 	cookieId = 0;
 }
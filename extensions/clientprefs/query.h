@@ -40,9 +40,12 @@ enum querytype
 {
 	Query_InsertCookie = 0,
 	Query_SelectData,
-	Query_InsertData,
+	Query_InsertBatch,
 	Query_SelectId,
 	Query_Connect,
+	Query_SelectBatch,
+	Query_StoreLocal,
+	Query_SelectLocal,
 };
 
 struct Cookie;
@@ -54,15 +57,16 @@ struct ParamData
 {
 	ParamData();
 
-	~ParamData();
-
 	/* Contains a name, description and access for InsertCookie queries */
 	Cookie *cookie;
 	/* A clients steamid - Used for most queries - Doubles as storage for the cookie name*/
 	char steamId[MAX_NAME_LENGTH];
 
 	int cookieId;
-	CookieData *data;
+	/* Cookie values to write for InsertBatch and StoreLocal queries */
+	std::vector<CookieWrite> batch;
+	/* Players to select for SelectBatch queries */
+	std::vector<PendingLoad> loads;
 };
 
 class TQueryOp : public IDBThreadOperation
@@ -110,6 +114,10 @@ private:
 	int m_serial;
 	int m_insertId;
 	Cookie *m_pCookie;
+
+	/* Result of InsertBatch queries */
+	bool m_success;
+	float m_elapsed;
 };
 
 
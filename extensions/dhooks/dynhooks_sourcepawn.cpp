@@ -365,6 +365,10 @@ ReturnAction_t HandleDetour(HookType_t hookType, CHook* pDetour)
 		CDynamicHooksSourcePawn *pWrapper = wrappers->at(i);
 		IPluginFunction *pCallback = pWrapper->plugin_callback;
 
+		// Don't bother marshalling anything if the plugin filtered this call out.
+		if (!pWrapper->filters.empty() && !pWrapper->PassesFilters())
+			continue;
+
 		// Create a seperate buffer for changed return values for this plugin.
 		// We update the finalRet above if the tempRet is higher than the previous ones in the callback list.
 		ReturnAction_t tempRet = ReturnAction_Ignored;
@@ -534,6 +538,7 @@ ReturnAction_t HandleDetour(HookType_t hookType, CHook* pDetour)
 CDynamicHooksSourcePawn::CDynamicHooksSourcePawn(HookSetup *setup, CHook *pDetour, IPluginFunction *pCallback, bool int64_addr, bool post)
 {
 	this->params = setup->params;
+	this->filters = setup->filters;
 	this->offset = -1;
 	this->returnFlag = setup->returnFlag;
 	this->returnType = setup->returnType;
@@ -684,6 +689,34 @@ HookParamsStruct *CDynamicHooksSourcePawn::GetParamStruct()
 	return params;
 }
 
+bool CDynamicHooksSourcePawn::PassesFilters()
+{
+	ICallingConvention* callingConvention = m_pDetour->m_pCallingConvention;
+
+	size_t firstArg = 0;
+	// TODO: Support custom register for this ptr.
+	if (callConv == CallConv_THISCALL)
+		firstArg = 1;
+
+	for (size_t i = 0; i < filters.size(); i++)
+	{
+		const HookFilter &filter = filters[i];
+		if (filter.type == HookFilter_This)
+		{
+			// The this pointer is implicitly always the first argument.
+			if (!PassesThisFilter(filter, m_pDetour->GetArgument<void *>(0)))
+				return false;
+		}
+		else
+		{
+			void *addr = callingConvention->GetArgumentPtr(filter.param + firstArg, m_pDetour->m_pRegisters);
+			if (!PassesParamFilter(filter, params[filter.param].type, addr))
+				return false;
+		}
+	}
+	return true;
+}
+
 void CDynamicHooksSourcePawn::UpdateParamsFromStruct(HookParamsStruct *params)
 {
 	// Function had no params to update now.
@@ -56,6 +56,7 @@ public:
 	HookReturnStruct *GetReturnStruct();
 	HookParamsStruct *GetParamStruct();
 	void UpdateParamsFromStruct(HookParamsStruct *params);
+	bool PassesFilters();
 
 public:
 	CHook *m_pDetour;
@@ -105,11 +105,19 @@ void DHooks::OnHandleDestroy(HandleType_t type, void *object)
 	}
 	else if(type == g_HookParamsHandle)
 	{
-		delete (HookParamsStruct *)object;
+		HookParamsStruct *params = (HookParamsStruct *)object;
+		if(!params->pooled)
+		{
+			delete params;
+		}
 	}
 	else if(type == g_HookReturnHandle)
 	{
-		delete (HookReturnStruct *)object;
+		HookReturnStruct *res = (HookReturnStruct *)object;
+		if(!res->pooled)
+		{
+			delete res;
+		}
 	}
 }
 
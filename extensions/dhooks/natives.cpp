@@ -80,6 +80,13 @@ bool GetCallbackArgHandleIfValidOrError(HandleType_t type, HandleType_t otherTyp
 			return pContext->ThrowNativeError("Invalid Handle %x (error %d). It looks like you've chosen the wrong hook callback signature for your setup and you're trying to access the wrong handle.", param, err) != 0;
 		return pContext->ThrowNativeError("Invalid Handle %x (error %d)", param, err) != 0;
 	}
+
+	// Handles of pooled call frames outlive the callback they were passed to.
+	bool expired = (type == g_HookParamsHandle) ? ((HookParamsStruct *)*object)->expired : ((HookReturnStruct *)*object)->expired;
+	if (expired)
+	{
+		return pContext->ThrowNativeError("Handle %x is no longer valid, it can only be used during its hook callback", param) != 0;
+	}
 	return true;
 }
 
@@ -396,6 +403,80 @@ cell_t Native_AddParam(IPluginContext *pContext, const cell_t *params)
 	return 1;
 }
 
+// native void DHookSetup.AddThisFilter(int minIndex=0, int maxIndex=-1, const char[] classname="");
+cell_t Native_AddThisFilter(IPluginContext *pContext, const cell_t *params)
+{
+	HookSetup *setup;
+
+	if(!GetHandleIfValidOrError(g_HookSetupHandle, (void **)&setup, pContext, params[1]))
+	{
+		return 0;
+	}
+
+	if(setup->thisType != ThisPointer_CBaseEntity || (setup->hookMethod == Detour && setup->callConv != CallConv_THISCALL))
+	{
+		return pContext->ThrowNativeError("This pointer filters require a CBaseEntity this pointer.");
+	}
+
+	char *classname;
+	pContext->LocalToString(params[4], &classname);
+
+	HookFilter filter;
+	filter.type = HookFilter_This;
+	filter.minIndex = params[2];
+	filter.maxIndex = params[3];
+	filter.classname = classname;
+	filter.param = 0;
+	setup->filters.push_back(filter);
+
+	return 1;
+}
+
+// native void DHookSetup.AddParamFilter(int param, const any[] values, int numValues);
+cell_t Native_AddParamFilter(IPluginContext *pContext, const cell_t *params)
+{
+	HookSetup *setup;
+
+	if(!GetHandleIfValidOrError(g_HookSetupHandle, (void **)&setup, pContext, params[1]))
+	{
+		return 0;
+	}
+
+	if(params[2] <= 0 || params[2] > static_cast<int>(setup->params.size()))
+	{
+		return pContext->ThrowNativeError("Invalid param number %i max params is %i", params[2], setup->params.size());
+	}
+
+	int index = params[2] - 1;
+	switch(setup->params.at(index).type)
+	{
+		case HookParamType_Int:
+		case HookParamType_Bool:
+		case HookParamType_CBaseEntity:
+			break;
+		default:
+			return pContext->ThrowNativeError("Param filters only support int, bool and CBaseEntity params.");
+	}
+
+	if(params[4] <= 0)
+	{
+		return pContext->ThrowNativeError("Param filter needs at least one value.");
+	}
+
+	cell_t *values;
+	pContext->LocalToPhysAddr(params[3], &values);
+
+	HookFilter filter;
+	filter.type = HookFilter_Param;
+	filter.minIndex = 0;
+	filter.maxIndex = -1;
+	filter.param = index;
+	filter.values.assign(values, values + params[4]);
+	setup->filters.push_back(filter);
+
+	return 1;
+}
+
 
 // native bool:DHookEnableDetour(Handle:setup, bool:post, DHookCallback:callback);
 cell_t Native_EnableDetour(IPluginContext *pContext, const cell_t *params)
@@ -1555,6 +1636,8 @@ sp_nativeinfo_t g_Natives[] =
 
 	// Methodmap API
 	{"DHookSetup.AddParam",                 Native_AddParam},
+	{"DHookSetup.AddThisFilter",            Native_AddThisFilter},
+	{"DHookSetup.AddParamFilter",           Native_AddParamFilter},
 	{"DHookSetup.SetFromConf",              Native_SetFromConf},
 
 	{"DynamicHook.DynamicHook",             Native_CreateHook},
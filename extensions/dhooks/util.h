@@ -75,6 +75,9 @@ enum PluginRegister
 };
 
 size_t GetParamOffset(HookParamsStruct *params, unsigned int index);
+size_t GetParamOffset(DHooksInfo *dg, unsigned int index);
+bool PassesThisFilter(const HookFilter &filter, void *thisPtr);
+bool PassesParamFilter(const HookFilter &filter, HookParamType type, void *addr);
 void * GetObjectAddr(HookParamType type, unsigned int flags, void **params, size_t offset);
 size_t GetParamTypeSize(HookParamType type);
 size_t GetParamsSize(DHooksCallback *dg);
@@ -250,6 +250,7 @@ DHooksManager::DHooksManager(HookSetup *setup, void *iface, IPluginFunction *rem
 	this->callback->post = post;
 	this->callback->hookType = setup->hookType;
 	this->callback->params = setup->params;
+	this->callback->filters = setup->filters;
 
 	this->addr = 0;
 
@@ -356,7 +357,7 @@ HookReturnStruct::~HookReturnStruct()
 
 HookParamsStruct::~HookParamsStruct()
 {
-	if (this->orgParams != NULL)
+	if (this->orgParams != NULL && this->ownsOrgParams)
 	{
 		free(this->orgParams);
 	}
@@ -370,39 +371,84 @@ HookParamsStruct::~HookParamsStruct()
 	}
 }
 
-HookParamsStruct *GetParamStruct(DHooksCallback *dg, void **argStack, size_t argStackSize)
+struct HookCallFrame
+{
+	HookParamsStruct *paramStruct;
+	HookReturnStruct *returnStruct;
+	Handle_t pHndl;
+	Handle_t rHndl;
+};
+
+static size_t GetResultPtrOffset(DHooksCallback *dg)
 {
-	HookParamsStruct *params = new HookParamsStruct();
-	params->dg = dg;
 #ifdef  WIN32
-	if(dg->returnType != ReturnType_Vector)
+	if(dg->returnType == ReturnType_Vector)
 #else
-	if(dg->returnType != ReturnType_Vector && dg->returnType != ReturnType_String)
+	if(dg->returnType == ReturnType_Vector || dg->returnType == ReturnType_String)
 #endif
 	{
-		params->orgParams = (void **)malloc(argStackSize);
-		memcpy(params->orgParams, argStack, argStackSize);
+		return OBJECT_OFFSET;
 	}
-	else //Offset result ptr
+	return 0;
+}
+
+static bool HasStackObjectParams(DHooksCallback *dg)
+{
+	// By value objects live inside the arg stack itself and natives may write
+	// to them, so those hooks still get a private copy of the stack.
+	for (unsigned int i = 0; i < dg->params.size(); i++)
 	{
-		params->orgParams = (void **)malloc(argStackSize-OBJECT_OFFSET);
-		memcpy(params->orgParams, (void*)((uintptr_t)argStack + OBJECT_OFFSET), argStackSize - OBJECT_OFFSET);
+		if (dg->params[i].type == HookParamType_Object)
+		{
+			return true;
+		}
 	}
-	size_t paramsSize = GetParamsSize(dg);
+	return false;
+}
+
+HookParamsStruct *AllocParamStruct(DHooksCallback *dg, size_t argStackSize)
+{
+	HookParamsStruct *params = new HookParamsStruct();
+	params->dg = dg;
 
-	params->newParams = (void **)malloc(paramsSize);
+	if(HasStackObjectParams(dg))
+	{
+		params->orgParams = (void **)malloc(argStackSize - GetResultPtrOffset(dg));
+	}
+	else
+	{
+		params->ownsOrgParams = false;
+	}
+
+	params->newParams = (void **)malloc(GetParamsSize(dg));
 	params->isChanged = (bool *)malloc(dg->params.size() * sizeof(bool));
 
+	return params;
+}
+
+void ResetParamStruct(HookParamsStruct *params, void **argStack, size_t argStackSize)
+{
+	DHooksCallback *dg = static_cast<DHooksCallback *>(params->dg);
+	size_t resultOffset = GetResultPtrOffset(dg);
+	void **args = (void **)((uintptr_t)argStack + resultOffset);
+
+	if(params->ownsOrgParams)
+	{
+		memcpy(params->orgParams, args, argStackSize - resultOffset);
+	}
+	else
+	{
+		params->orgParams = args;
+	}
+
 	for (unsigned int i = 0; i < dg->params.size(); i++)
 	{
 		*(void **)((intptr_t)params->newParams + GetParamOffset(params, i)) = NULL;
 		params->isChanged[i] = false;
 	}
-
-	return params;
 }
 
-HookReturnStruct *GetReturnStruct(DHooksCallback *dg)
+HookReturnStruct *AllocReturnStruct(DHooksCallback *dg)
 {
 	HookReturnStruct *res = new HookReturnStruct();
 	res->isChanged = false;
@@ -410,40 +456,62 @@ HookReturnStruct *GetReturnStruct(DHooksCallback *dg)
 	res->orgResult = NULL;
 	res->newResult = NULL;
 
+	switch(dg->returnType)
+	{
+		case ReturnType_String:
+			res->orgResult = malloc(sizeof(string_t));
+			res->newResult = malloc(sizeof(string_t));
+			break;
+		case ReturnType_Int:
+			res->orgResult = malloc(sizeof(int));
+			res->newResult = malloc(sizeof(int));
+			break;
+		case ReturnType_Bool:
+			res->orgResult = malloc(sizeof(bool));
+			res->newResult = malloc(sizeof(bool));
+			break;
+		case ReturnType_Float:
+			res->orgResult = malloc(sizeof(float));
+			res->newResult = malloc(sizeof(float));
+			break;
+		case ReturnType_Vector:
+			res->orgResult = malloc(sizeof(SDKVector));
+			res->newResult = malloc(sizeof(SDKVector));
+			break;
+	}
+
+	return res;
+}
+
+void ResetReturnStruct(HookReturnStruct *res, DHooksCallback *dg)
+{
+	res->isChanged = false;
+
 	if(g_SHPtr->GetOrigRet() && dg->post)
 	{
 		switch(dg->returnType)
 		{
 			case ReturnType_String:
-				res->orgResult = malloc(sizeof(string_t));
-				res->newResult = malloc(sizeof(string_t));
 				*(string_t *)res->orgResult = META_RESULT_ORIG_RET(string_t);
 				break;
 			case ReturnType_Int:
-				res->orgResult = malloc(sizeof(int));
-				res->newResult = malloc(sizeof(int));
 				*(int *)res->orgResult = META_RESULT_ORIG_RET(int);
 				break;
 			case ReturnType_Bool:
-				res->orgResult = malloc(sizeof(bool));
-				res->newResult = malloc(sizeof(bool));
 				*(bool *)res->orgResult = META_RESULT_ORIG_RET(bool);
 				break;
 			case ReturnType_Float:
-				res->orgResult = malloc(sizeof(float));
-				res->newResult = malloc(sizeof(float));
 				*(float *)res->orgResult = META_RESULT_ORIG_RET(float);
 				break;
 			case ReturnType_Vector:
 			{
-				res->orgResult = malloc(sizeof(SDKVector));
-				res->newResult = malloc(sizeof(SDKVector));
 				SDKVector vec = META_RESULT_ORIG_RET(SDKVector);
 				*(SDKVector *)res->orgResult = vec;
 				break;
 			}
 			default:
 				res->orgResult = META_RESULT_ORIG_RET(void *);
+				res->newResult = NULL;
 				break;
 		}
 	}
@@ -452,34 +520,160 @@ HookReturnStruct *GetReturnStruct(DHooksCallback *dg)
 		switch(dg->returnType)
 		{
 			case ReturnType_String:
-				res->orgResult = malloc(sizeof(string_t));
-				res->newResult = malloc(sizeof(string_t));
 				*(string_t *)res->orgResult = NULL_STRING;
 				break;
 			case ReturnType_Vector:
-				res->orgResult = malloc(sizeof(SDKVector));
-				res->newResult = malloc(sizeof(SDKVector));
 				*(SDKVector *)res->orgResult = SDKVector();
 				break;
 			case ReturnType_Int:
-				res->orgResult = malloc(sizeof(int));
-				res->newResult = malloc(sizeof(int));
 				*(int *)res->orgResult = 0;
 				break;
 			case ReturnType_Bool:
-				res->orgResult = malloc(sizeof(bool));
-				res->newResult = malloc(sizeof(bool));
 				*(bool *)res->orgResult = false;
 				break;
 			case ReturnType_Float:
-				res->orgResult = malloc(sizeof(float));
-				res->newResult = malloc(sizeof(float));
 				*(float *)res->orgResult = 0.0;
 				break;
+			default:
+				res->orgResult = NULL;
+				res->newResult = NULL;
+				break;
 		}
 	}
+}
 
-	return res;
+static Handle_t CreateCallFrameHandle(HandleType_t type, void *object)
+{
+	// Owned by no plugin so it survives between calls, but only we may free it.
+	HandleSecurity sec(NULL, myself->GetIdentity());
+	HandleAccess access;
+	handlesys->InitAccessDefaults(NULL, &access);
+	access.access[HandleAccess_Delete] = HANDLE_RESTRICT_IDENTITY;
+
+	return handlesys->CreateHandleEx(type, object, &sec, &access, NULL);
+}
+
+static void FreeCallFrame(HookCallFrame *frame)
+{
+	HandleSecurity sec(NULL, myself->GetIdentity());
+
+	// The structs are pooled, destroying the handles leaves them alone.
+	if(frame->rHndl)
+	{
+		handlesys->FreeHandle(frame->rHndl, &sec);
+	}
+	if(frame->pHndl)
+	{
+		handlesys->FreeHandle(frame->pHndl, &sec);
+	}
+	delete frame->returnStruct;
+	delete frame->paramStruct;
+	delete frame;
+}
+
+static HookCallFrame *NewCallFrame(DHooksCallback *dg, size_t argStackSize)
+{
+	HookCallFrame *frame = new HookCallFrame();
+	frame->paramStruct = NULL;
+	frame->returnStruct = NULL;
+	frame->pHndl = BAD_HANDLE;
+	frame->rHndl = BAD_HANDLE;
+
+	if(dg->returnType != ReturnType_Void)
+	{
+		frame->returnStruct = AllocReturnStruct(dg);
+		frame->returnStruct->pooled = true;
+		frame->rHndl = CreateCallFrameHandle(g_HookReturnHandle, frame->returnStruct);
+		if(!frame->rHndl)
+		{
+			FreeCallFrame(frame);
+			return NULL;
+		}
+	}
+	if(argStackSize > 0)
+	{
+		frame->paramStruct = AllocParamStruct(dg, argStackSize);
+		frame->paramStruct->pooled = true;
+		frame->pHndl = CreateCallFrameHandle(g_HookParamsHandle, frame->paramStruct);
+		if(!frame->pHndl)
+		{
+			FreeCallFrame(frame);
+			return NULL;
+		}
+	}
+
+	return frame;
+}
+
+// Like the game event hook handles in core, each frame keeps one handle per struct for
+// the lifetime of the hook. The structs are flagged as expired between calls, so a
+// handle a plugin kept past its callback is rejected by the natives instead of
+// reading a dead arg stack.
+static void SetCallFrameExpired(HookCallFrame *frame, bool expired)
+{
+	if(frame->returnStruct)
+	{
+		frame->returnStruct->expired = expired;
+	}
+	if(frame->paramStruct)
+	{
+		frame->paramStruct->expired = expired;
+	}
+}
+
+HookCallFrame *AcquireCallFrame(DHooksCallback *dg, size_t argStackSize)
+{
+	if(dg->callDepth == dg->callFrames.size())
+	{
+		HookCallFrame *frame = NewCallFrame(dg, argStackSize);
+		if(!frame)
+		{
+			return NULL;
+		}
+		dg->callFrames.push_back(frame);
+	}
+	HookCallFrame *frame = dg->callFrames[dg->callDepth];
+	SetCallFrameExpired(frame, false);
+
+	dg->callDepth++;
+	return frame;
+}
+
+void ReleaseCallFrame(DHooksCallback *dg, HookCallFrame *frame)
+{
+	SetCallFrameExpired(frame, true);
+	dg->callDepth--;
+}
+
+void FreeCallFrames(DHooksCallback *dg)
+{
+	for (size_t i = 0; i < dg->callFrames.size(); i++)
+	{
+		FreeCallFrame(dg->callFrames[i]);
+	}
+	dg->callFrames.clear();
+}
+
+static bool PassesHookFilters(DHooksCallback *dg, void **argStack)
+{
+	void **args = (void **)((uintptr_t)argStack + GetResultPtrOffset(dg));
+
+	for (size_t i = 0; i < dg->filters.size(); i++)
+	{
+		const HookFilter &filter = dg->filters[i];
+		if (filter.type == HookFilter_This)
+		{
+			if (!PassesThisFilter(filter, g_SHPtr->GetIfacePtr()))
+				return false;
+		}
+		else
+		{
+			void *addr = (void *)((intptr_t)args + GetParamOffset(dg, filter.param));
+			if (!PassesParamFilter(filter, dg->params[filter.param].type, addr))
+				return false;
+		}
+	}
+	return true;
 }
 
 #if defined( WIN32 ) && !defined( KE_ARCH_X64 )
@@ -488,16 +682,30 @@ void *Callback(DHooksCallback *dg, void **argStack, size_t *argsizep)
 void *Callback(DHooksCallback *dg, void **argStack)
 #endif
 {
-	HookReturnStruct *returnStruct = NULL;
-	HookParamsStruct *paramStruct = NULL;
-	Handle_t rHndl;
-	Handle_t pHndl;
-
 #if defined( WIN32 ) && !defined( KE_ARCH_X64 )
 	*argsizep = GetStackArgsSize(dg);
+#endif
+	if(!dg->filters.empty() && !PassesHookFilters(dg, argStack))
+	{
+		g_SHPtr->SetRes(MRES_IGNORED);
+		return NULL;
+	}
+
+#if defined( WIN32 ) && !defined( KE_ARCH_X64 )
+	HookCallFrame *frame = AcquireCallFrame(dg, *argsizep);
 #else
 	size_t argsize = GetStackArgsSize(dg);
+	HookCallFrame *frame = AcquireCallFrame(dg, argsize);
 #endif
+	if(!frame)
+	{
+		g_SHPtr->SetRes(MRES_IGNORED);
+		return NULL;
+	}
+
+	HookReturnStruct *returnStruct = frame->returnStruct;
+	HookParamsStruct *paramStruct = frame->paramStruct;
+
 	//g_pSM->LogMessage(myself, "[DEFAULT]DHooksCallback(%p) argStack(%p) - argsize(%d)", dg, argStack, argsize);
 
 	if(dg->thisType == ThisPointer_CBaseEntity || dg->thisType == ThisPointer_Address)
@@ -518,49 +726,19 @@ void *Callback(DHooksCallback *dg, void **argStack)
 			}
 		}
 	}
-	if(dg->returnType != ReturnType_Void)
+	if(returnStruct)
 	{
-		returnStruct = GetReturnStruct(dg);
-		rHndl = handlesys->CreateHandle(g_HookReturnHandle, returnStruct, dg->plugin_callback->GetParentRuntime()->GetDefaultContext()->GetIdentity(), myself->GetIdentity(), NULL);
-		if(!rHndl)
-		{
-			dg->plugin_callback->Cancel();
-			if(returnStruct)
-			{
-				delete returnStruct;
-			}
-			g_SHPtr->SetRes(MRES_IGNORED);
-			return NULL;
-		}
-		dg->plugin_callback->PushCell(rHndl);
+		ResetReturnStruct(returnStruct, dg);
+		dg->plugin_callback->PushCell(frame->rHndl);
 	}
-
-#if defined( WIN32 ) && !defined( KE_ARCH_X64 )
-	if(*argsizep > 0)
+	if(paramStruct)
 	{
-		paramStruct = GetParamStruct(dg, argStack, *argsizep);
+#if defined( WIN32 ) && !defined( KE_ARCH_X64 )
+		ResetParamStruct(paramStruct, argStack, *argsizep);
 #else
-	if(argsize > 0)
-	{
-		paramStruct = GetParamStruct(dg, argStack, argsize);
+		ResetParamStruct(paramStruct, argStack, argsize);
 #endif
-		pHndl = handlesys->CreateHandle(g_HookParamsHandle, paramStruct, dg->plugin_callback->GetParentRuntime()->GetDefaultContext()->GetIdentity(), myself->GetIdentity(), NULL);
-		if(!pHndl)
-		{
-			dg->plugin_callback->Cancel();
-			if(returnStruct)
-			{
-				HandleSecurity sec(dg->plugin_callback->GetParentRuntime()->GetDefaultContext()->GetIdentity(), myself->GetIdentity());
-				handlesys->FreeHandle(rHndl, &sec);
-			}
-			if(paramStruct)
-			{
-				delete paramStruct;
-			}
-			g_SHPtr->SetRes(MRES_IGNORED);
-			return NULL;
-		}
-		dg->plugin_callback->PushCell(pHndl);
+		dg->plugin_callback->PushCell(frame->pHndl);
 	}
 	cell_t result = (cell_t)MRES_Ignored;
 	META_RES mres = MRES_IGNORED;
@@ -663,16 +841,7 @@ void *Callback(DHooksCallback *dg, void **argStack)
 			break;
 	}
 
-	HandleSecurity sec(dg->plugin_callback->GetParentRuntime()->GetDefaultContext()->GetIdentity(), myself->GetIdentity());
-
-	if(returnStruct)
-	{
-		handlesys->FreeHandle(rHndl, &sec);
-	}
-	if(paramStruct)
-	{
-		handlesys->FreeHandle(pHndl, &sec);
-	}
+	ReleaseCallFrame(dg, frame);
 
 	if(dg->returnType == ReturnType_Void || mres <= MRES_HANDLED)
 	{
@@ -686,16 +855,30 @@ float Callback_float(DHooksCallback *dg, void **argStack, size_t *argsizep)
 float Callback_float(DHooksCallback *dg, void **argStack)
 #endif
 {
-	HookReturnStruct *returnStruct = NULL;
-	HookParamsStruct *paramStruct = NULL;
-	Handle_t rHndl;
-	Handle_t pHndl;
-
 #if defined( WIN32 ) && !defined( KE_ARCH_X64 )
 	*argsizep = GetStackArgsSize(dg);
+#endif
+	if(!dg->filters.empty() && !PassesHookFilters(dg, argStack))
+	{
+		g_SHPtr->SetRes(MRES_IGNORED);
+		return 0.0;
+	}
+
+#if defined( WIN32 ) && !defined( KE_ARCH_X64 )
+	HookCallFrame *frame = AcquireCallFrame(dg, *argsizep);
 #else
 	size_t argsize = GetStackArgsSize(dg);
+	HookCallFrame *frame = AcquireCallFrame(dg, argsize);
 #endif
+	if(!frame)
+	{
+		g_SHPtr->SetRes(MRES_IGNORED);
+		return 0.0;
+	}
+
+	HookReturnStruct *returnStruct = frame->returnStruct;
+	HookParamsStruct *paramStruct = frame->paramStruct;
+
 	//g_pSM->LogMessage(myself, "[FLOAT]DHooksCallback(%p) argStack(%p) - argsize(%d)", dg, argStack, argsize);
 
 	if(dg->thisType == ThisPointer_CBaseEntity || dg->thisType == ThisPointer_Address)
@@ -717,46 +900,19 @@ float Callback_float(DHooksCallback *dg, void **argStack)
 		}
 	}
 
-	returnStruct = GetReturnStruct(dg);
-	rHndl = handlesys->CreateHandle(g_HookReturnHandle, returnStruct, dg->plugin_callback->GetParentRuntime()->GetDefaultContext()->GetIdentity(), myself->GetIdentity(), NULL);
-
-	if(!rHndl)
+	if(returnStruct)
 	{
-		dg->plugin_callback->Cancel();
-		if(returnStruct)
-		{
-			delete returnStruct;
-		}
-		g_SHPtr->SetRes(MRES_IGNORED);
-		return 0.0;
+		ResetReturnStruct(returnStruct, dg);
+		dg->plugin_callback->PushCell(frame->rHndl);
 	}
-	dg->plugin_callback->PushCell(rHndl);
-
-	#if defined( WIN32 ) && !defined( KE_ARCH_X64 )
-	if(*argsizep > 0)
-	{
-		paramStruct = GetParamStruct(dg, argStack, *argsizep);
-	#else
-	if(argsize > 0)
+	if(paramStruct)
 	{
-		paramStruct = GetParamStruct(dg, argStack, argsize);
-	#endif
-		pHndl = handlesys->CreateHandle(g_HookParamsHandle, paramStruct, dg->plugin_callback->GetParentRuntime()->GetDefaultContext()->GetIdentity(), myself->GetIdentity(), NULL);
-		if(!pHndl)
-		{
-			dg->plugin_callback->Cancel();
-			if(returnStruct)
-			{
-				delete returnStruct;
-			}
-			if(paramStruct)
-			{
-				delete paramStruct;
-			}
-			g_SHPtr->SetRes(MRES_IGNORED);
-			return 0.0;
-		}
-		dg->plugin_callback->PushCell(pHndl);
+#if defined( WIN32 ) && !defined( KE_ARCH_X64 )
+		ResetParamStruct(paramStruct, argStack, *argsizep);
+#else
+		ResetParamStruct(paramStruct, argStack, argsize);
+#endif
+		dg->plugin_callback->PushCell(frame->pHndl);
 	}
 	cell_t result = (cell_t)MRES_Ignored;
 	META_RES mres = MRES_IGNORED;
@@ -832,16 +988,7 @@ float Callback_float(DHooksCallback *dg, void **argStack)
 			break;
 	}
 
-	HandleSecurity sec(dg->plugin_callback->GetParentRuntime()->GetDefaultContext()->GetIdentity(), myself->GetIdentity());
-
-	if(returnStruct)
-	{
-		handlesys->FreeHandle(rHndl, &sec);
-	}
-	if(paramStruct)
-	{
-		handlesys->FreeHandle(pHndl, &sec);
-	}
+	ReleaseCallFrame(dg, frame);
 
 	if(dg->returnType == ReturnType_Void || mres <= MRES_HANDLED)
 	{
@@ -857,16 +1004,30 @@ SDKVector *Callback_vector(DHooksCallback *dg, void **argStack)
 {
 	SDKVector *vec_result = (SDKVector *)argStack[0];
 
-	HookReturnStruct *returnStruct = NULL;
-	HookParamsStruct *paramStruct = NULL;
-	Handle_t rHndl;
-	Handle_t pHndl;
-
 #if defined( WIN32 ) && !defined( KE_ARCH_X64 )
 	*argsizep = GetStackArgsSize(dg);
+#endif
+	if(!dg->filters.empty() && !PassesHookFilters(dg, argStack))
+	{
+		g_SHPtr->SetRes(MRES_IGNORED);
+		return NULL;
+	}
+
+#if defined( WIN32 ) && !defined( KE_ARCH_X64 )
+	HookCallFrame *frame = AcquireCallFrame(dg, *argsizep);
 #else
 	size_t argsize = GetStackArgsSize(dg);
+	HookCallFrame *frame = AcquireCallFrame(dg, argsize);
 #endif
+	if(!frame)
+	{
+		g_SHPtr->SetRes(MRES_IGNORED);
+		return NULL;
+	}
+
+	HookReturnStruct *returnStruct = frame->returnStruct;
+	HookParamsStruct *paramStruct = frame->paramStruct;
+
 	//g_pSM->LogMessage(myself, "[VECTOR]DHooksCallback(%p) argStack(%p) - argsize(%d) - params count %d", dg, argStack, argsize, dg->params.size());
 
 	if(dg->thisType == ThisPointer_CBaseEntity || dg->thisType == ThisPointer_Address)
@@ -888,46 +1049,19 @@ SDKVector *Callback_vector(DHooksCallback *dg, void **argStack)
 		}
 	}
 
-	returnStruct = GetReturnStruct(dg);
-	rHndl = handlesys->CreateHandle(g_HookReturnHandle, returnStruct, dg->plugin_callback->GetParentRuntime()->GetDefaultContext()->GetIdentity(), myself->GetIdentity(), NULL);
-
-	if(!rHndl)
+	if(returnStruct)
 	{
-		dg->plugin_callback->Cancel();
-		if(returnStruct)
-		{
-			delete returnStruct;
-		}
-		g_SHPtr->SetRes(MRES_IGNORED);
-		return NULL;
+		ResetReturnStruct(returnStruct, dg);
+		dg->plugin_callback->PushCell(frame->rHndl);
 	}
-	dg->plugin_callback->PushCell(rHndl);
-
-	#if defined( WIN32 ) && !defined( KE_ARCH_X64 )
-	if(*argsizep > 0)
-	{
-		paramStruct = GetParamStruct(dg, argStack, *argsizep);
-	#else
-	if(argsize > 0)
+	if(paramStruct)
 	{
-		paramStruct = GetParamStruct(dg, argStack, argsize);
-	#endif
-		pHndl = handlesys->CreateHandle(g_HookParamsHandle, paramStruct, dg->plugin_callback->GetParentRuntime()->GetDefaultContext()->GetIdentity(), myself->GetIdentity(), NULL);
-		if(!pHndl)
-		{
-			dg->plugin_callback->Cancel();
-			if(returnStruct)
-			{
-				delete returnStruct;
-			}
-			if(paramStruct)
-			{
-				delete paramStruct;
-			}
-			g_SHPtr->SetRes(MRES_IGNORED);
-			return NULL;
-		}
-		dg->plugin_callback->PushCell(pHndl);
+#if defined( WIN32 ) && !defined( KE_ARCH_X64 )
+		ResetParamStruct(paramStruct, argStack, *argsizep);
+#else
+		ResetParamStruct(paramStruct, argStack, argsize);
+#endif
+		dg->plugin_callback->PushCell(frame->pHndl);
 	}
 	cell_t result = (cell_t)MRES_Ignored;
 	META_RES mres = MRES_IGNORED;
@@ -1004,16 +1138,7 @@ SDKVector *Callback_vector(DHooksCallback *dg, void **argStack)
 			break;
 	}
 
-	HandleSecurity sec(dg->plugin_callback->GetParentRuntime()->GetDefaultContext()->GetIdentity(), myself->GetIdentity());
-
-	if(returnStruct)
-	{
-		handlesys->FreeHandle(rHndl, &sec);
-	}
-	if(paramStruct)
-	{
-		handlesys->FreeHandle(pHndl, &sec);
-	}
+	ReleaseCallFrame(dg, frame);
 
 	if(dg->returnType == ReturnType_Void || mres <= MRES_HANDLED)
 	{
@@ -1030,12 +1155,22 @@ string_t *Callback_stringt(DHooksCallback *dg, void **argStack)
 {
 	string_t *string_result = (string_t *)argStack[0]; // Save the result
 
-	HookReturnStruct *returnStruct = NULL;
-	HookParamsStruct *paramStruct = NULL;
-	Handle_t rHndl;
-	Handle_t pHndl;
+	if(!dg->filters.empty() && !PassesHookFilters(dg, argStack))
+	{
+		g_SHPtr->SetRes(MRES_IGNORED);
+		return NULL;
+	}
 
 	size_t argsize = GetStackArgsSize(dg);
+	HookCallFrame *frame = AcquireCallFrame(dg, argsize);
+	if(!frame)
+	{
+		g_SHPtr->SetRes(MRES_IGNORED);
+		return NULL;
+	}
+
+	HookReturnStruct *returnStruct = frame->returnStruct;
+	HookParamsStruct *paramStruct = frame->paramStruct;
 
 	if(dg->thisType == ThisPointer_CBaseEntity || dg->thisType == ThisPointer_Address)
 	{
@@ -1056,40 +1191,15 @@ string_t *Callback_stringt(DHooksCallback *dg, void **argStack)
 		}
 	}
 
-	returnStruct = GetReturnStruct(dg);
-	rHndl = handlesys->CreateHandle(g_HookReturnHandle, returnStruct, dg->plugin_callback->GetParentRuntime()->GetDefaultContext()->GetIdentity(), myself->GetIdentity(), NULL);
-
-	if(!rHndl)
+	if(returnStruct)
 	{
-		dg->plugin_callback->Cancel();
-		if(returnStruct)
-		{
-			delete returnStruct;
-		}
-		g_SHPtr->SetRes(MRES_IGNORED);
-		return NULL;
+		ResetReturnStruct(returnStruct, dg);
+		dg->plugin_callback->PushCell(frame->rHndl);
 	}
-	dg->plugin_callback->PushCell(rHndl);
-
-	if(argsize > 0)
+	if(paramStruct)
 	{
-		paramStruct = GetParamStruct(dg, argStack, argsize);
-		pHndl = handlesys->CreateHandle(g_HookParamsHandle, paramStruct, dg->plugin_callback->GetParentRuntime()->GetDefaultContext()->GetIdentity(), myself->GetIdentity(), NULL);
-		if(!pHndl)
-		{
-			dg->plugin_callback->Cancel();
-			if(returnStruct)
-			{
-				delete returnStruct;
-			}
-			if(paramStruct)
-			{
-				delete paramStruct;
-			}
-			g_SHPtr->SetRes(MRES_IGNORED);
-			return NULL;
-		}
-		dg->plugin_callback->PushCell(pHndl);
+		ResetParamStruct(paramStruct, argStack, argsize);
+		dg->plugin_callback->PushCell(frame->pHndl);
 	}
 	cell_t result = (cell_t)MRES_Ignored;
 	META_RES mres = MRES_IGNORED;
@@ -1166,16 +1276,7 @@ string_t *Callback_stringt(DHooksCallback *dg, void **argStack)
 			break;
 	}
 
-	HandleSecurity sec(dg->plugin_callback->GetParentRuntime()->GetDefaultContext()->GetIdentity(), myself->GetIdentity());
-
-	if(returnStruct)
-	{
-		handlesys->FreeHandle(rHndl, &sec);
-	}
-	if(paramStruct)
-	{
-		handlesys->FreeHandle(pHndl, &sec);
-	}
+	ReleaseCallFrame(dg, frame);
 
 	if(dg->returnType == ReturnType_Void || mres <= MRES_HANDLED)
 	{
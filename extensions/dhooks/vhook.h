@@ -38,6 +38,7 @@
 #include <sourcehook_pibuilder.h>
 #include <registers.h>
 #include <vector>
+#include <string>
 
 #ifdef KE_ARCH_X64
 #include "sh_asm_x86_64.h"
@@ -133,6 +134,24 @@ struct ParamInfo
 	Register_t custom_register;
 };
 
+enum HookFilterType
+{
+	HookFilter_This,
+	HookFilter_Param
+};
+
+// Checked natively before the plugin callback is entered. All filters on a
+// hook have to pass, a param filter passes if the value is in its set.
+struct HookFilter
+{
+	HookFilterType type;
+	int minIndex;
+	int maxIndex;
+	std::string classname;
+	unsigned int param;
+	std::vector<cell_t> values;
+};
+
 #ifdef  WIN32
 #define OBJECT_OFFSET sizeof(void *)
 #else
@@ -142,8 +161,15 @@ struct ParamInfo
 class HookReturnStruct
 {
 public:
+	HookReturnStruct() : pooled(false), expired(false)
+	{
+	}
 	~HookReturnStruct();
 public:
+	// True if owned by a hook's call frame rather than by its handle.
+	bool pooled;
+	// Set on pooled structs between calls, their handle must not be used then.
+	bool expired;
 	ReturnType type;
 	bool isChanged;
 	void *orgResult;
@@ -164,12 +190,17 @@ public:
 	ThisPointerType thisType;
 	HookType hookType;
 	CallingConvention thisFuncCallConv;
+	std::vector<HookFilter> filters;
 };
 
+struct HookCallFrame;
+class DHooksCallback;
+void FreeCallFrames(DHooksCallback *dg);
+
 class DHooksCallback : public SourceHook::ISHDelegate, public DHooksInfo
 {
 public:
-	DHooksCallback()
+	DHooksCallback() : callDepth(0)
 	{
 		//g_pSM->LogMessage(myself, "DHooksCallback(%p)", this);
 	}
@@ -177,6 +208,7 @@ public:
     virtual bool IsEqual(ISHDelegate *pOtherDeleg){return false;};
     virtual void DeleteThis()
 	{
+		FreeCallFrames(this);
 		*(void ***)this = this->oldvtable;
 #ifdef KE_ARCH_X64
 		delete callThunk;
@@ -190,6 +222,9 @@ public:
 public:
 	void **newvtable;
 	void **oldvtable;
+	// Param/return structs, one frame per recursion depth.
+	SourceHook::CVector<HookCallFrame *> callFrames;
+	unsigned int callDepth;
 #ifdef KE_ARCH_X64
 	SourceHook::Asm::x64JitWriter* callThunk;
 #endif
@@ -220,10 +255,19 @@ public:
 		this->newParams = NULL;
 		this->dg = NULL;
 		this->isChanged = NULL;
+		this->ownsOrgParams = true;
+		this->pooled = false;
+		this->expired = false;
 	}
 	~HookParamsStruct();
 public:
+	// True if owned by a hook's call frame rather than by its handle.
+	bool pooled;
+	// Set on pooled structs between calls, their handle must not be used then.
+	bool expired;
 	void **orgParams;
+	// False if orgParams points straight into the hooked call's arg stack.
+	bool ownsOrgParams;
 	void **newParams;
 	bool *isChanged;
 	DHooksInfo *dg;
@@ -274,6 +318,7 @@ public:
 	CallingConvention callConv;
 	ThisPointerType thisType;
 	SourceHook::CVector<ParamInfo> params;
+	std::vector<HookFilter> filters;
 	int offset;
 	void *funcAddr;
 	IPluginFunction *callback;
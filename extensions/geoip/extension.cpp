@@ -145,6 +145,7 @@ bool GeoIP_Extension::SDK_OnLoad(char *error, size_t maxlength, bool late)
 
 void GeoIP_Extension::SDK_OnUnload()
 {
+	clearRecordCache();
 	MMDB_close(&mmdb);
 }
 
@@ -406,6 +407,197 @@ static cell_t sm_Geoip_Longitude(IPluginContext *pCtx, const cell_t *params)
 	return sp_ftoc(longitude);
 }
 
+/* Cell offsets of the GeoInfo enum struct fields in geoip.inc. Char arrays are
+ * packed four characters to a cell.
+ */
+enum GeoInfoField
+{
+	GeoInfo_Found = 0,
+	GeoInfo_Code2 = 1,			/* char[3] */
+	GeoInfo_Code3 = 2,			/* char[4] */
+	GeoInfo_RegionCode = 3,		/* char[12] */
+	GeoInfo_ContinentId = 6,
+	GeoInfo_ContinentCode = 7,	/* char[3] */
+	GeoInfo_Country = 8,		/* char[GEOINFO_NAME_LENGTH] */
+	GeoInfo_Continent = 24,
+	GeoInfo_Region = 40,
+	GeoInfo_City = 56,
+	GeoInfo_Timezone = 72,
+	GeoInfo_Latitude = 88,
+	GeoInfo_Longitude = 89,
+	GeoInfo_Size = 90
+};
+
+#define GEOINFO_NAME_LENGTH 64
+
+static void SetInfoString(cell_t *info, GeoInfoField field, size_t maxbytes, const char *str)
+{
+	char *dest = reinterpret_cast<char *>(&info[field]);
+	size_t len = strlen(str);
+
+	if (len >= maxbytes)
+	{
+		/* Don't cut a multi-byte character in half */
+		len = maxbytes - 1;
+		while (len > 0 && (str[len] & 0xC0) == 0x80)
+		{
+			len--;
+		}
+	}
+
+	memcpy(dest, str, len);
+	dest[len] = '\0';
+}
+
+static bool FillGeoInfo(cell_t *info, GeoRecord *record)
+{
+	memset(info, 0, GeoInfo_Size * sizeof(cell_t));
+
+	if (!record->found)
+	{
+		return false;
+	}
+
+	const char *code3 = "";
+	for (size_t i = 0; i < SM_ARRAYSIZE(GeoIPCountryCode); i++)
+	{
+		if (!strncmp(record->code2.c_str(), GeoIPCountryCode[i], 2))
+		{
+			code3 = GeoIPCountryCode3[i];
+			break;
+		}
+	}
+
+	char regionCode[12] = { 0 };
+	if (record->code2.length() != 0 && record->regionCode.length() != 0)
+	{
+		ke::SafeSprintf(regionCode, sizeof(regionCode), "%s-%s", record->code2.c_str(), record->regionCode.c_str());
+	}
+
+	info[GeoInfo_Found] = 1;
+	SetInfoString(info, GeoInfo_Code2, 3, record->code2.c_str());
+	SetInfoString(info, GeoInfo_Code3, 4, code3);
+	SetInfoString(info, GeoInfo_RegionCode, sizeof(regionCode), regionCode);
+	info[GeoInfo_ContinentId] = getContinentId(record->continentCode.c_str());
+	SetInfoString(info, GeoInfo_ContinentCode, 3, record->continentCode.c_str());
+	SetInfoString(info, GeoInfo_Country, GEOINFO_NAME_LENGTH, record->country.c_str());
+	SetInfoString(info, GeoInfo_Continent, GEOINFO_NAME_LENGTH, record->continent.c_str());
+	SetInfoString(info, GeoInfo_Region, GEOINFO_NAME_LENGTH, record->region.c_str());
+	SetInfoString(info, GeoInfo_City, GEOINFO_NAME_LENGTH, record->city.c_str());
+	SetInfoString(info, GeoInfo_Timezone, GEOINFO_NAME_LENGTH, record->timezone.c_str());
+	info[GeoInfo_Latitude] = sp_ftoc(record->latitude);
+	info[GeoInfo_Longitude] = sp_ftoc(record->longitude);
+
+	return true;
+}
+
+static bool CheckGeoInfoSize(IPluginContext *pCtx, cell_t size)
+{
+	if (size != GeoInfo_Size)
+	{
+		pCtx->ThrowNativeError("GeoInfo size mismatch (%d, expected %d), recompile the plugin against the current geoip.inc", size, GeoInfo_Size);
+		return false;
+	}
+
+	return true;
+}
+
+/* Resolves entry |index| of a two-dimensional plugin array in either array layout */
+static cell_t *GetArrayEntry(IPluginContext *pCtx, cell_t *array, cell_t index, bool direct)
+{
+	if (!direct)
+	{
+		return reinterpret_cast<cell_t *>(reinterpret_cast<char *>(&array[index]) + array[index]);
+	}
+
+	ARRAY_PTR handle;
+	if (pCtx->LocalToArrayPtr(array[index], &handle) != SP_ERROR_NONE)
+	{
+		return NULL;
+	}
+	return reinterpret_cast<cell_t *>(pCtx->GetArrayData(handle));
+}
+
+static cell_t *GetArrayBase(IPluginContext *pCtx, cell_t param, bool direct)
+{
+	cell_t *array;
+
+	if (!direct)
+	{
+		pCtx->LocalToPhysAddr(param, &array);
+		return array;
+	}
+
+	ARRAY_PTR handle;
+	if (pCtx->LocalToArrayPtr(param, &handle) != SP_ERROR_NONE)
+	{
+		return NULL;
+	}
+	return reinterpret_cast<cell_t *>(pCtx->GetArrayData(handle));
+}
+
+static cell_t sm_Geoip_Lookup(IPluginContext *pCtx, const cell_t *params)
+{
+	if (!CheckGeoInfoSize(pCtx, params[3]))
+	{
+		return 0;
+	}
+
+	char *ip;
+	pCtx->LocalToString(params[1], &ip);
+	StripPort(ip);
+
+	cell_t *info;
+	pCtx->LocalToPhysAddr(params[2], &info);
+
+	return FillGeoInfo(info, lookupRecord(ip)) ? 1 : 0;
+}
+
+static cell_t sm_Geoip_LookupMany(IPluginContext *pCtx, const cell_t *params)
+{
+	if (!CheckGeoInfoSize(pCtx, params[4]))
+	{
+		return 0;
+	}
+
+	cell_t num = params[2];
+	if (num < 0)
+	{
+		return pCtx->ThrowNativeError("Invalid number of addresses %d", num);
+	}
+
+	bool direct = pCtx->GetRuntime()->UsesDirectArrays();
+	cell_t *ips = GetArrayBase(pCtx, params[1], direct);
+	cell_t *infos = GetArrayBase(pCtx, params[3], direct);
+	if (!ips || !infos)
+	{
+		return 0;
+	}
+
+	char ip[64];
+	cell_t found = 0;
+
+	for (cell_t i = 0; i < num; i++)
+	{
+		char *entry = reinterpret_cast<char *>(GetArrayEntry(pCtx, ips, i, direct));
+		cell_t *info = GetArrayEntry(pCtx, infos, i, direct);
+		if (!entry || !info)
+		{
+			return pCtx->ThrowNativeError("Invalid array entry %d", i);
+		}
+
+		ke::SafeStrcpy(ip, sizeof(ip), entry);
+		StripPort(ip);
+
+		if (FillGeoInfo(info, lookupRecord(ip)))
+		{
+			found++;
+		}
+	}
+
+	return found;
+}
+
 static cell_t sm_Geoip_Distance(IPluginContext *pCtx, const cell_t *params)
 {
 	float earthRadius = params[5] ? 3958.0 : 6370.997; // miles / km
@@ -433,6 +625,8 @@ const sp_nativeinfo_t geoip_natives[] =
 	{"GeoipLatitude",		sm_Geoip_Latitude},
 	{"GeoipLongitude",		sm_Geoip_Longitude},
 	{"GeoipDistance",		sm_Geoip_Distance},
+	{"GeoipLookup",			sm_Geoip_Lookup},
+	{"GeoipLookupMany",		sm_Geoip_LookupMany},
 	{NULL,					NULL},
 };
 
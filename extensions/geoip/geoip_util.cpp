@@ -30,6 +30,15 @@
  */
 
 #include "geoip_util.h"
+#include <list>
+#include <unordered_map>
+
+/* Most recently used addresses first */
+#define MAX_CACHED_RECORDS 1024
+
+typedef std::list<std::pair<std::string, ke::RefPtr<GeoRecord>>> RecordList;
+static RecordList recordList;
+static std::unordered_map<std::string, RecordList::iterator> recordCache;
 
 const char GeoIPCountryCode[252][3] =
 {
@@ -91,18 +100,102 @@ const char GeoIPCountryCode3[252][4] =
 	"BLM", "MAF"
 };
 
-bool lookupByIp(const char *ip, const char **path, MMDB_entry_data_s *result)
+static std::string entryString(MMDB_entry_s *entry, const char **path)
+{
+	MMDB_entry_data_s result;
+
+	if (MMDB_aget_value(entry, &result, path) != MMDB_SUCCESS || !result.has_data || result.type != MMDB_DATA_TYPE_UTF8_STRING)
+	{
+		return std::string("");
+	}
+
+	return std::string(result.utf8_string, result.data_size);
+}
+
+static double entryDouble(MMDB_entry_s *entry, const char **path)
+{
+	MMDB_entry_data_s result;
+
+	if (MMDB_aget_value(entry, &result, path) != MMDB_SUCCESS || !result.has_data || result.type != MMDB_DATA_TYPE_DOUBLE)
+	{
+		return 0;
+	}
+
+	return result.double_value;
+}
+
+GeoRecord *lookupRecord(const char *ip)
 {
+	auto iter = recordCache.find(ip);
+	if (iter != recordCache.end())
+	{
+		recordList.splice(recordList.begin(), recordList, iter->second);
+		return iter->second->second;
+	}
+
+	ke::RefPtr<GeoRecord> record = new GeoRecord();
+
 	int gai_error = 0, mmdb_error = 0;
 	MMDB_lookup_result_s lookup = MMDB_lookup_string(&mmdb, ip, &gai_error, &mmdb_error);
 
-	if (gai_error != 0 || mmdb_error != MMDB_SUCCESS || !lookup.found_entry)
+	/* Misses are cached too, so unknown addresses don't walk the tree again */
+	if (gai_error == 0 && mmdb_error == MMDB_SUCCESS && lookup.found_entry)
+	{
+		record->found = true;
+		record->entry = lookup.entry;
+
+		const char *pathCode2[] = {"country", "iso_code", NULL};
+		const char *pathContinentCode[] = {"continent", "code", NULL};
+		const char *pathRegionCode[] = {"subdivisions", "0", "iso_code", NULL};
+		const char *pathCountry[] = {"country", "names", "en", NULL};
+		const char *pathContinent[] = {"continent", "names", "en", NULL};
+		const char *pathRegion[] = {"subdivisions", "0", "names", "en", NULL};
+		const char *pathCity[] = {"city", "names", "en", NULL};
+		const char *pathTimezone[] = {"location", "time_zone", NULL};
+		const char *pathLatitude[] = {"location", "latitude", NULL};
+		const char *pathLongitude[] = {"location", "longitude", NULL};
+
+		record->code2 = entryString(&record->entry, pathCode2);
+		record->continentCode = entryString(&record->entry, pathContinentCode);
+		record->regionCode = entryString(&record->entry, pathRegionCode);
+		record->country = entryString(&record->entry, pathCountry);
+		record->continent = entryString(&record->entry, pathContinent);
+		record->region = entryString(&record->entry, pathRegion);
+		record->city = entryString(&record->entry, pathCity);
+		record->timezone = entryString(&record->entry, pathTimezone);
+		record->latitude = entryDouble(&record->entry, pathLatitude);
+		record->longitude = entryDouble(&record->entry, pathLongitude);
+	}
+
+	if (recordList.size() >= MAX_CACHED_RECORDS)
+	{
+		recordCache.erase(recordList.back().first);
+		recordList.pop_back();
+	}
+
+	recordList.emplace_front(ip, record);
+	recordCache[ip] = recordList.begin();
+
+	return record;
+}
+
+void clearRecordCache()
+{
+	recordCache.clear();
+	recordList.clear();
+}
+
+bool lookupByIp(const char *ip, const char **path, MMDB_entry_data_s *result)
+{
+	GeoRecord *record = lookupRecord(ip);
+
+	if (!record->found)
 	{
 		return false;
 	}
 
 	MMDB_entry_data_s entry_data;
-	mmdb_error = MMDB_aget_value(&lookup.entry, &entry_data, path);
+	int mmdb_error = MMDB_aget_value(&record->entry, &entry_data, path);
 
 	if (mmdb_error != MMDB_SUCCESS)
 	{
@@ -33,7 +33,32 @@
 #define _INCLUDE_SOURCEMOD_GEOIPUTIL_H_
 
 #include "extension.h"
+#include <am-refcounting.h>
+#include <string>
 
+/* Everything commonly asked about an address, decoded once per cache entry */
+struct GeoRecord : public ke::Refcounted<GeoRecord>
+{
+	GeoRecord() : found(false), latitude(0.0), longitude(0.0)
+	{
+	}
+
+	bool found;
+	MMDB_entry_s entry;
+	std::string code2;
+	std::string continentCode;
+	std::string regionCode;
+	std::string country;
+	std::string continent;
+	std::string region;
+	std::string city;
+	std::string timezone;
+	double latitude;
+	double longitude;
+};
+
+GeoRecord *lookupRecord(const char *ip);
+void clearRecordCache();
 bool lookupByIp(const char *ip, const char **path, MMDB_entry_data_s *result);
 double lookupDouble(const char *ip, const char **path);
 int getContinentId(const char *code);
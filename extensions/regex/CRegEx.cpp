@@ -34,13 +34,34 @@
 #include "pcre.h"
 #include "CRegEx.h"
 #include "extension.h"
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+/* Compiled patterns by flags and source, oldest evicted first */
+#define MAX_CACHED_PATTERNS 256
+
+static std::unordered_map<std::string, ke::RefPtr<CompiledRegex>> sPatternCache;
+static std::deque<std::string> sPatternOrder;
+
+CompiledRegex::~CompiledRegex()
+{
+	if (extra)
+		pcre_free_study(extra);
+	pcre_free(re);
+}
+
+void RegEx::ClearCache()
+{
+	sPatternCache.clear();
+	sPatternOrder.clear();
+}
 
 RegEx::RegEx()
 {
 	mErrorOffset = 0;
 	mErrorCode = 0;
 	mError = nullptr;
-	re = nullptr;
 	mFree = true;
 	subject = nullptr;
 	mMatchCount = 0;
@@ -51,9 +72,7 @@ void RegEx::Clear ()
 	mErrorOffset = 0;
 	mErrorCode = 0;
 	mError = nullptr;
-	if (re)
-		pcre_free(re);
-	re = nullptr;
+	mPattern = nullptr;
 	mFree = true;
 	if (subject)
 		free(subject);
@@ -81,32 +100,76 @@ int RegEx::Compile(const char *pattern, int iFlags)
 {
 	if (!mFree)
 		Clear();
-		
-	re = pcre_compile2(pattern, iFlags, &mErrorCode, &mError, &mErrorOffset, nullptr);
+
+	std::string key = std::to_string(iFlags) + ":" + pattern;
+
+	auto iter = sPatternCache.find(key);
+	if (iter != sPatternCache.end())
+	{
+		mPattern = iter->second;
+		mFree = false;
+		return 1;
+	}
+
+	pcre *re = pcre_compile2(pattern, iFlags, &mErrorCode, &mError, &mErrorOffset, nullptr);
 
 	if (re == nullptr)
 	{
 		return 0;
 	}
 
+	/* Failing to study or JIT isn't fatal, pcre_exec falls back to the interpreter */
+	const char *studyError = nullptr;
+	pcre_extra *extra = pcre_study(re, PCRE_STUDY_JIT_COMPILE, &studyError);
+
+	mPattern = new CompiledRegex(re, extra);
 	mFree = false;
 
+	if (sPatternOrder.size() >= MAX_CACHED_PATTERNS)
+	{
+		sPatternCache.erase(sPatternOrder.front());
+		sPatternOrder.pop_front();
+	}
+	sPatternCache.emplace(key, mPattern);
+	sPatternOrder.push_back(key);
+
 	return 1;
 }
 
+int RegEx::Test(const char *str, size_t len)
+{
+	if (mFree || !mPattern)
+		return -1;
+
+	int ovector[3];
+	int rc = pcre_exec(mPattern->re, mPattern->extra, str, len, 0, 0, ovector, 3);
+
+	if (rc == PCRE_ERROR_NOMATCH)
+		return 0;
+
+	return (rc < 0) ? -1 : 1;
+}
+
+void RegEx::SaveSubject(const char *str, size_t len)
+{
+	subject = (char *)malloc(len + 1);
+	memcpy(subject, str, len + 1);
+}
+
 int RegEx::Match(const char *const str, const size_t offset)
 {
 	int rc = 0;
 
-	if (mFree || re == nullptr)
+	if (mFree || !mPattern)
 		return -1;
 		
 	this->ClearMatch();
 
 	//save str
-	subject = strdup(str);
+	size_t len = strlen(str);
+	SaveSubject(str, len);
 
-	rc = pcre_exec(re, nullptr, subject, strlen(subject), offset, 0, mMatches[0].mVector, MAX_CAPTURES);
+	rc = pcre_exec(mPattern->re, mPattern->extra, subject, len, offset, 0, mMatches[0].mVector, MAX_CAPTURES);
 
 	if (rc < 0)
 	{
@@ -129,19 +192,19 @@ int RegEx::MatchAll(const char *str)
 {
 	int rc = 0;
 
-	if (mFree || re == nullptr)
+	if (mFree || !mPattern)
 		return -1;
 
 	this->ClearMatch();
 
 	//save str
-	subject = strdup(str);
-	size_t len = strlen(subject);
+	size_t len = strlen(str);
+	SaveSubject(str, len);
 
 	size_t offset = 0;
 	unsigned int matches = 0;
 
-	while (matches < MAX_MATCHES && offset < len && (rc = pcre_exec(re, 0, subject, len, offset, 0, mMatches[matches].mVector, MAX_CAPTURES)) >= 0)
+	while (matches < MAX_MATCHES && offset < len && (rc = pcre_exec(mPattern->re, mPattern->extra, subject, len, offset, 0, mMatches[matches].mVector, MAX_CAPTURES)) >= 0)
 	{
 		offset = mMatches[matches].mVector[1];
 		mMatches[matches].mSubStringCount = rc;
@@ -29,6 +29,7 @@
  * Version: $Id$
  */
 #include <am-string.h>
+#include <am-refcounting.h>
 
 #ifndef _INCLUDE_CREGEX_H
 #define _INCLUDE_CREGEX_H
@@ -42,6 +43,19 @@ struct RegexMatch
 	int mVector[MAX_CAPTURES];
 };
 
+/* A compiled and studied pattern, shared by every RegEx compiled from the same source */
+struct CompiledRegex : public ke::Refcounted<CompiledRegex>
+{
+	CompiledRegex(pcre *re, pcre_extra *extra)
+		: re(re), extra(extra)
+	{
+	}
+	~CompiledRegex();
+
+	pcre *re;
+	pcre_extra *extra;
+};
+
 class RegEx
 {
 public:
@@ -51,10 +65,15 @@ public:
 	void Clear();
 
 	int Compile(const char *pattern, int iFlags);
+	int Test(const char *str, size_t len);
 	int Match(const char *const str, const size_t offset);
 	int MatchAll(const char *str);
 	void ClearMatch();
 	bool GetSubstring(int s, char buffer[], int max, int match);
+
+	static void ClearCache();
+private:
+	void SaveSubject(const char *str, size_t len);
 public:
 	int mErrorOffset;
 	int mErrorCode;
@@ -62,7 +81,7 @@ public:
 	int mMatchCount;
 	RegexMatch mMatches[MAX_MATCHES];
 private:
-	pcre *re;
+	ke::RefPtr<CompiledRegex> mPattern;
 	bool mFree;
 	char *subject;
 };
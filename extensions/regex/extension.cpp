@@ -61,6 +61,7 @@ bool RegexExtension::SDK_OnLoad(char *error, size_t err_max, bool late)
 void RegexExtension::SDK_OnUnload()
 {
 	g_pHandleSys->RemoveType(g_RegexHandle, myself->GetIdentity());
+	RegEx::ClearCache();
 
 }
 
@@ -326,6 +327,39 @@ static cell_t GetRegexOffset(IPluginContext *pCtx, const cell_t *params)
 	return x->mMatches[params[2]].mVector[1];
 }
 
+static cell_t MatchRegexAny(IPluginContext *pCtx, const cell_t *params)
+{
+	HandleError err;
+	HandleSecurity sec;
+	sec.pOwner = NULL;
+	sec.pIdentity = myself->GetIdentity();
+
+	char *str;
+	pCtx->LocalToString(params[1], &str);
+	size_t len = strlen(str);
+
+	cell_t *regexes;
+	pCtx->LocalToPhysAddr(params[2], &regexes);
+
+	for (cell_t i = 0; i < params[3]; i++)
+	{
+		Handle_t hndl = static_cast<Handle_t>(regexes[i]);
+
+		RegEx *x;
+		if ((err = g_pHandleSys->ReadHandle(hndl, g_RegexHandle, &sec, (void **)&x)) != HandleError_None)
+		{
+			return pCtx->ThrowNativeError("Invalid regex handle %x at index %d (error %d)", hndl, i, err);
+		}
+
+		if (x->Test(str, len) > 0)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
 void RegexHandler::OnHandleDestroy(HandleType_t type, void *object)
 {
 	RegEx *x = (RegEx *)object;
@@ -339,6 +373,7 @@ const sp_nativeinfo_t regex_natives[] =
 	{"GetRegexSubString",			GetRegexSubString},
 	{"MatchRegex",					MatchRegex},
 	{"CompileRegex",				CompileRegex},
+	{"MatchRegexAny",				MatchRegexAny},
 
 	// Methodmap versions/
 	{"Regex.GetSubString",		GetRegexSubString},
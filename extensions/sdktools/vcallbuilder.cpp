@@ -40,6 +40,8 @@ ValveCall::ValveCall()
 	retinfo = NULL;
 	thisinfo = NULL;
 	retbuf = NULL;
+	decoders = NULL;
+	copyback = false;
 }
 
 ValveCall::~ValveCall()
@@ -56,6 +58,7 @@ ValveCall::~ValveCall()
 	}
 	delete [] retbuf;
 	delete [] vparams;
+	delete [] decoders;
 }
 
 unsigned char *ValveCall::stk_get()
@@ -51,6 +51,8 @@ struct ValveCall
 	size_t stackSize;							/**< Stack size */
 	size_t stackEnd;							/**< End of the bintools stack */
 	unsigned char *retbuf;						/**< Return buffer */
+	ValveParamDecoder *decoders;				/**< Per-parameter decoders */
+	bool copyback;								/**< Any parameter needs copying back */
 	SourceHook::CStack<unsigned char *> stk;	/**< Parameter stack */
 
 	unsigned char *stk_get();
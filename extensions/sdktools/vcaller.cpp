@@ -292,6 +292,18 @@ static cell_t EndPrepSDKCall(IPluginContext *pContext, const cell_t *params)
 		vc->thisinfo->decflags |= VDECODE_FLAG_BYREF;
 	}
 
+	/* Resolve each parameter's decoder now instead of on every SDKCall */
+	unsigned int callparams = vc->call->GetParamCount();
+	vc->decoders = new ValveParamDecoder[callparams];
+	for (unsigned int i=0; i<callparams; i++)
+	{
+		vc->decoders[i] = GetValveParamDecoder(&vc->vparams[i]);
+		if (vc->vparams[i].encflags & VENCODE_FLAG_COPYBACK)
+		{
+			vc->copyback = true;
+		}
+	}
+
 	Handle_t hndl = handlesys->CreateHandle(g_CallHandle, vc, pContext->GetIdentity(), myself->GetIdentity(), NULL);
 	if (!hndl)
 	{
@@ -445,17 +457,15 @@ static cell_t SDKCall(IPluginContext *pContext, const cell_t *params)
 	}
 
 	unsigned int callparams = vc->call->GetParamCount();
-	bool will_copyback = false;
+	if (startparam + callparams - 1 > numparams)
+	{
+		vc->stk_put(ptr);
+		return pContext->ThrowNativeError("Expected %dth parameter, found none", numparams + 1);
+	}
 	for (unsigned int i=0; i<callparams; i++)
 	{
-		unsigned int p = startparam + i;
-		if (p > numparams)
-		{
-			vc->stk_put(ptr);
-			return pContext->ThrowNativeError("Expected %dth parameter, found none", p);
-		}
-		if (DecodeValveParam(pContext,
-			params[p],
+		if (vc->decoders[i](pContext,
+			params[startparam + i],
 			vc,
 			&(vc->vparams[i]),
 			ptr) == Data_Fail)
@@ -463,17 +473,13 @@ static cell_t SDKCall(IPluginContext *pContext, const cell_t *params)
 			vc->stk_put(ptr);
 			return 0;
 		}
-		if (vc->vparams[i].encflags & VENCODE_FLAG_COPYBACK)
-		{
-			will_copyback = true;
-		}
 	}
 
 	/* Make the actual call */
 	vc->call->Execute(ptr, vc->retbuf);
 
 	/* Do we need to copy anything back? */
-	if (will_copyback)
+	if (vc->copyback)
 	{
 		for (unsigned int i=0; i<callparams; i++)
 		{
@@ -642,3 +642,78 @@ DataStatus DecodeValveParam(IPluginContext *pContext,
 
 	return Data_Fail;
 }
+
+/* The decoders below cover the plain data shapes plugins pass most often.
+ * SDKCall params are always marked VDECODE_FLAG_BYREF, so these only need
+ * to handle that case.
+ */
+static DataStatus DecodeCellByRef(IPluginContext *pContext,
+					  cell_t param,
+					  const ValveCall *pCall,
+					  const ValvePassInfo *data,
+					  void *_buffer)
+{
+	cell_t *addr;
+	pContext->LocalToPhysAddr(param, &addr);
+	*(cell_t *)((unsigned char *)_buffer + data->offset) = *addr;
+	return Data_Okay;
+}
+
+static DataStatus DecodeCellByRefAsPointer(IPluginContext *pContext,
+					  cell_t param,
+					  const ValveCall *pCall,
+					  const ValvePassInfo *data,
+					  void *_buffer)
+{
+	cell_t *addr;
+	pContext->LocalToPhysAddr(param, &addr);
+	cell_t *mem = (cell_t *)((unsigned char *)_buffer + pCall->stackEnd + data->obj_offset);
+	*(cell_t **)((unsigned char *)_buffer + data->offset) = mem;
+	*mem = *addr;
+	return Data_Okay;
+}
+
+static DataStatus DecodeBoolByRef(IPluginContext *pContext,
+					  cell_t param,
+					  const ValveCall *pCall,
+					  const ValvePassInfo *data,
+					  void *_buffer)
+{
+	cell_t *addr;
+	pContext->LocalToPhysAddr(param, &addr);
+	*(bool *)((unsigned char *)_buffer + data->offset) = *addr ? true : false;
+	return Data_Okay;
+}
+
+ValveParamDecoder GetValveParamDecoder(const ValvePassInfo *vdata)
+{
+	if (!(vdata->decflags & VDECODE_FLAG_BYREF))
+	{
+		return DecodeValveParam;
+	}
+
+	switch (vdata->vtype)
+	{
+	case Valve_POD:
+	case Valve_Float:
+		{
+			if (vdata->flags & PASSFLAG_ASPOINTER)
+			{
+				return DecodeCellByRefAsPointer;
+			}
+			return DecodeCellByRef;
+		}
+	case Valve_Bool:
+		{
+			if (!(vdata->flags & PASSFLAG_ASPOINTER))
+			{
+				return DecodeBoolByRef;
+			}
+			break;
+		}
+	default:
+		break;
+	}
+
+	return DecodeValveParam;
+}
@@ -153,4 +153,24 @@ DataStatus EncodeValveParam(IPluginContext *pContext,
 					  const ValvePassInfo *vdata,
 					  const void *buffer);
 
+/**
+ * @brief Decoder with the same semantics as DecodeValveParam().
+ */
+typedef DataStatus (*ValveParamDecoder)(IPluginContext *pContext,
+					  cell_t param,
+					  const ValveCall *pCall,
+					  const ValvePassInfo *vdata,
+					  void *buffer);
+
+/**
+ * @brief Picks a decoder specialized for a parameter's type and flags.
+ *
+ * Common plain data parameters get a decoder that writes straight into the
+ * stack buffer. Everything else falls back to DecodeValveParam().
+ *
+ * @param vdata			Parameter info, with offsets already computed.
+ * @return				Decoder to use for this parameter.
+ */
+ValveParamDecoder GetValveParamDecoder(const ValvePassInfo *vdata);
+
 #endif //_INCLUDE_SOURCEMOD_VDECODER_H_
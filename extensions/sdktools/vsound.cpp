@@ -68,16 +68,62 @@ cell_t SoundReferenceToIndex(cell_t ref)
 	return gamehelpers->ReferenceToIndex(ref);
 }
 
-size_t SoundHooks::_FillInPlayers(int *pl_array, IRecipientFilter *pFilter)
+void SoundHooks::_DecodeRecipients(SoundRecipients &recipients, IRecipientFilter *pFilter)
 {
-	size_t size = static_cast<size_t>(pFilter->GetRecipientCount());
+	int size = pFilter->GetRecipientCount();
+	if (size > SM_ARRAYSIZE(recipients.players))
+	{
+		size = SM_ARRAYSIZE(recipients.players);
+	}
+
+	recipients.clients.reset();
+	for (int i=0; i<size; i++)
+	{
+		int client = pFilter->GetRecipientIndex(i);
+		recipients.players[i] = client;
+		if (client >= 0 && client <= SM_MAXPLAYERS)
+		{
+			recipients.clients.set(client);
+		}
+	}
+
+	recipients.count = size;
+}
+
+bool SoundHooks::_WantsSound(const NormalSoundHook &hook, const char *sample, int entity)
+{
+	if (hook.entity < SOUND_FROM_ANY)
+	{
+		/* A reference goes stale when its entity is deleted, even if the index is reused */
+		int index = gamehelpers->ReferenceToIndex(hook.entity);
+		if ((unsigned)index == INVALID_EHANDLE_INDEX || index != entity)
+		{
+			return false;
+		}
+	}
+	else if (hook.entity != SOUND_FROM_ANY && hook.entity != entity)
+	{
+		return false;
+	}
+
+	return hook.samplePrefix.empty()
+		|| strncmp(sample, hook.samplePrefix.c_str(), hook.samplePrefix.size()) == 0;
+}
 
-	for (size_t i=0; i<size; i++)
+bool SoundHooks::_SameRecipients(const SoundRecipients &recipients, const int *players, int size)
+{
+	if (size != recipients.count)
 	{
-		pl_array[i] = pFilter->GetRecipientIndex(i);
+		return false;
 	}
 
-	return size;
+	std::bitset<SM_MAXPLAYERS + 1> clients;
+	for (int i=0; i<size; i++)
+	{
+		clients.set(players[i]);
+	}
+
+	return clients == recipients.clients;
 }
 
 void SoundHooks::_IncRefCounter(int type)
@@ -159,9 +205,9 @@ void SoundHooks::OnPluginUnloaded(IPlugin *plugin)
 	}
 	if (m_NormalCount)
 	{
-		for (iter=m_NormalFuncs.begin(); iter!=m_NormalFuncs.end(); )
+		for (NormalSoundHookIter iter=m_NormalFuncs.begin(); iter!=m_NormalFuncs.end(); )
 		{
-			if ((*iter)->GetParentContext() == pContext)
+			if (iter->pFunc->GetParentContext() == pContext)
 			{
 				iter = m_NormalFuncs.erase(iter);
 				_DecRefCounter(NORMAL_SOUND_HOOK);
@@ -178,8 +224,7 @@ void SoundHooks::AddHook(int type, IPluginFunction *pFunc)
 {
 	if (type == NORMAL_SOUND_HOOK)
 	{
-		m_NormalFuncs.push_back(pFunc);
-		_IncRefCounter(NORMAL_SOUND_HOOK);
+		AddNormalHook(pFunc, "", SOUND_FROM_ANY);
 	}
 	else if (type == AMBIENT_SOUND_HOOK)
 	{
@@ -188,21 +233,33 @@ void SoundHooks::AddHook(int type, IPluginFunction *pFunc)
 	}
 }
 
+void SoundHooks::AddNormalHook(IPluginFunction *pFunc, const char *samplePrefix, cell_t entity)
+{
+	NormalSoundHook hook;
+	hook.pFunc = pFunc;
+	hook.samplePrefix = samplePrefix;
+	hook.entity = entity;
+
+	m_NormalFuncs.push_back(hook);
+	_IncRefCounter(NORMAL_SOUND_HOOK);
+}
+
 bool SoundHooks::RemoveHook(int type, IPluginFunction *pFunc)
 {
 	SoundHookIter iter;
 	if (type == NORMAL_SOUND_HOOK)
 	{
-		if ((iter=m_NormalFuncs.find(pFunc)) != m_NormalFuncs.end())
+		for (NormalSoundHookIter niter=m_NormalFuncs.begin(); niter!=m_NormalFuncs.end(); niter++)
 		{
-			m_NormalFuncs.erase(iter);
-			_DecRefCounter(NORMAL_SOUND_HOOK);
-			return true;
-		}
-		else
-		{
-			return false;
+			if (niter->pFunc == pFunc)
+			{
+				m_NormalFuncs.erase(niter);
+				_DecRefCounter(NORMAL_SOUND_HOOK);
+				return true;
+			}
 		}
+
+		return false;
 	}
 	else if (type == AMBIENT_SOUND_HOOK)
 	{
@@ -340,7 +397,7 @@ void SoundHooks::OnEmitSound(IRecipientFilter &filter, int iEntIndex, int iChann
 							 float soundtime, int speakerentity)
 #endif
 {
-	SoundHookIter iter;
+	NormalSoundHookIter iter;
 	IPluginFunction *pFunc;
 	cell_t res = static_cast<ResultType>(Pl_Continue);
 	char buffer[PLATFORM_MAX_PATH];
@@ -355,11 +412,26 @@ void SoundHooks::OnEmitSound(IRecipientFilter &filter, int iEntIndex, int iChann
 	int nSeed = 0;
 #endif
 
+	SoundRecipients recipients;
+	recipients.count = -1;
+
 	for (iter=m_NormalFuncs.begin(); iter!=m_NormalFuncs.end(); iter++)
 	{
+		if (!_WantsSound(*iter, buffer, iEntIndex))
+		{
+			continue;
+		}
+
+		/* Only decode the filter once a hook is interested, and only once per sound */
+		if (recipients.count == -1)
+		{
+			_DecodeRecipients(recipients, &filter);
+		}
+
 		int players[SM_MAXPLAYERS], size;
-		size = _FillInPlayers(players, &filter);
-		pFunc = (*iter);
+		size = recipients.count;
+		memcpy(players, recipients.players, size * sizeof(int));
+		pFunc = iter->pFunc;
 
 		pFunc->PushArray(players, SM_ARRAYSIZE(players), SM_PARAM_COPYBACK);
 		pFunc->PushCellByRef(&size);
@@ -433,15 +505,21 @@ void SoundHooks::OnEmitSound(IRecipientFilter &filter, int iEntIndex, int iChann
 				}
 #endif
 
+				/* Hand the engine's own filter back if the recipients weren't touched */
 				CellRecipientFilter crf;
-				crf.Initialize(players, size);
+				IRecipientFilter *pNewFilter = &filter;
+				if (!_SameRecipients(recipients, players, size))
+				{
+					crf.Initialize(players, size);
+					pNewFilter = &crf;
+				}
 #if SOURCE_ENGINE == SE_CSGO || SOURCE_ENGINE == SE_BLADE || SOURCE_ENGINE == SE_MCV
 				RETURN_META_VALUE_NEWPARAMS(
 					MRES_IGNORED,
 					-1,
 					static_cast<int (IEngineSound::*)(IRecipientFilter &, int, int, const char*, unsigned int, const char*, float, soundlevel_t, 
 					int, int, int, const Vector *, const Vector *, CUtlVector<Vector> *, bool, float, int, void *)>(&IEngineSound::EmitSound), 
-					(crf, iEntIndex, iChannel, soundEntry, nSoundEntryHash, buffer, flVolume, iSoundlevel, nSeed, iFlags, iPitch, pOrigin,
+					(*pNewFilter, iEntIndex, iChannel, soundEntry, nSoundEntryHash, buffer, flVolume, iSoundlevel, nSeed, iFlags, iPitch, pOrigin,
 					pDirection, pUtlVecOrigins, bUpdatePositions, soundtime, speakerentity, nullptr)
 					);
 #elif SOURCE_ENGINE >= SE_PORTAL2
@@ -450,7 +528,7 @@ void SoundHooks::OnEmitSound(IRecipientFilter &filter, int iEntIndex, int iChann
 					-1,
 					static_cast<int (IEngineSound::*)(IRecipientFilter &, int, int, const char*, unsigned int, const char*, float, soundlevel_t, 
 					int, int, int, const Vector *, const Vector *, CUtlVector<Vector> *, bool, float, int)>(&IEngineSound::EmitSound), 
-					(crf, iEntIndex, iChannel, soundEntry, nSoundEntryHash, buffer, flVolume, iSoundlevel, nSeed, iFlags, iPitch, pOrigin,
+					(*pNewFilter, iEntIndex, iChannel, soundEntry, nSoundEntryHash, buffer, flVolume, iSoundlevel, nSeed, iFlags, iPitch, pOrigin,
 					pDirection, pUtlVecOrigins, bUpdatePositions, soundtime, speakerentity)
 					);
 #elif SOURCE_ENGINE == SE_CSS || SOURCE_ENGINE == SE_HL2DM || SOURCE_ENGINE == SE_DODS || SOURCE_ENGINE == SE_SDK2013 \
@@ -459,7 +537,7 @@ void SoundHooks::OnEmitSound(IRecipientFilter &filter, int iEntIndex, int iChann
 					MRES_IGNORED,
 					static_cast<void (IEngineSound::*)(IRecipientFilter &, int, int, const char*, float, soundlevel_t, 
 					int, int, int, const Vector *, const Vector *, CUtlVector<Vector> *, bool, float, int)>(&IEngineSound::EmitSound), 
-					(crf, iEntIndex, iChannel, buffer, flVolume, iSoundlevel, iFlags, iPitch, iSpecialDSP, pOrigin, 
+					(*pNewFilter, iEntIndex, iChannel, buffer, flVolume, iSoundlevel, iFlags, iPitch, iSpecialDSP, pOrigin, 
 					pDirection, pUtlVecOrigins, bUpdatePositions, soundtime, speakerentity)
 					);
 #else
@@ -467,7 +545,7 @@ void SoundHooks::OnEmitSound(IRecipientFilter &filter, int iEntIndex, int iChann
 					MRES_IGNORED,
 					static_cast<void (IEngineSound::*)(IRecipientFilter &, int, int, const char*, float, soundlevel_t, 
 					int, int, const Vector *, const Vector *, CUtlVector<Vector> *, bool, float, int)>(&IEngineSound::EmitSound), 
-					(crf, iEntIndex, iChannel, buffer, flVolume, iSoundlevel, iFlags, iPitch, pOrigin, 
+					(*pNewFilter, iEntIndex, iChannel, buffer, flVolume, iSoundlevel, iFlags, iPitch, pOrigin, 
 					pDirection, pUtlVecOrigins, bUpdatePositions, soundtime, speakerentity)
 					);
 #endif
@@ -503,7 +581,7 @@ void SoundHooks::OnEmitSound2(IRecipientFilter &filter, int iEntIndex, int iChan
 							 float soundtime, int speakerentity)
 #endif
 {
-	SoundHookIter iter;
+	NormalSoundHookIter iter;
 	IPluginFunction *pFunc;
 	cell_t res = static_cast<ResultType>(Pl_Continue);
 	cell_t sndlevel = static_cast<cell_t>(ATTN_TO_SNDLVL(flAttenuation));
@@ -519,11 +597,26 @@ void SoundHooks::OnEmitSound2(IRecipientFilter &filter, int iEntIndex, int iChan
 	int nSeed = 0;
 #endif
 
+	SoundRecipients recipients;
+	recipients.count = -1;
+
 	for (iter=m_NormalFuncs.begin(); iter!=m_NormalFuncs.end(); iter++)
 	{
+		if (!_WantsSound(*iter, buffer, iEntIndex))
+		{
+			continue;
+		}
+
+		/* Only decode the filter once a hook is interested, and only once per sound */
+		if (recipients.count == -1)
+		{
+			_DecodeRecipients(recipients, &filter);
+		}
+
 		int players[SM_MAXPLAYERS], size;
-		size = _FillInPlayers(players, &filter);
-		pFunc = (*iter);
+		size = recipients.count;
+		memcpy(players, recipients.players, size * sizeof(int));
+		pFunc = iter->pFunc;
 
 		pFunc->PushArray(players, SM_ARRAYSIZE(players), SM_PARAM_COPYBACK);
 		pFunc->PushCellByRef(&size);
@@ -597,15 +690,21 @@ void SoundHooks::OnEmitSound2(IRecipientFilter &filter, int iEntIndex, int iChan
 				}
 #endif
 
+				/* Hand the engine's own filter back if the recipients weren't touched */
 				CellRecipientFilter crf;
-				crf.Initialize(players, size);
+				IRecipientFilter *pNewFilter = &filter;
+				if (!_SameRecipients(recipients, players, size))
+				{
+					crf.Initialize(players, size);
+					pNewFilter = &crf;
+				}
 #if SOURCE_ENGINE == SE_CSGO || SOURCE_ENGINE == SE_BLADE || SOURCE_ENGINE == SE_MCV
 				RETURN_META_VALUE_NEWPARAMS(
 					MRES_IGNORED,
 					-1,
 					static_cast<int (IEngineSound::*)(IRecipientFilter &, int, int, const char *, unsigned int, const char *, float, float, 
 					int, int, int, const Vector *, const Vector *, CUtlVector<Vector> *, bool, float, int, void *)>(&IEngineSound::EmitSound), 
-					(crf, iEntIndex, iChannel, soundEntry, nSoundEntryHash, buffer, flVolume, SNDLVL_TO_ATTN(static_cast<soundlevel_t>(sndlevel)),
+					(*pNewFilter, iEntIndex, iChannel, soundEntry, nSoundEntryHash, buffer, flVolume, SNDLVL_TO_ATTN(static_cast<soundlevel_t>(sndlevel)),
 					nSeed, iFlags, iPitch, pOrigin, pDirection, pUtlVecOrigins, bUpdatePositions, soundtime, speakerentity, pUnknown)
 					);
 #elif SOURCE_ENGINE >= SE_PORTAL2
@@ -614,7 +713,7 @@ void SoundHooks::OnEmitSound2(IRecipientFilter &filter, int iEntIndex, int iChan
 					-1,
 					static_cast<int (IEngineSound::*)(IRecipientFilter &, int, int, const char *, unsigned int, const char *, float, float, 
 					int, int, int, const Vector *, const Vector *, CUtlVector<Vector> *, bool, float, int)>(&IEngineSound::EmitSound), 
-					(crf, iEntIndex, iChannel, soundEntry, nSoundEntryHash, buffer, flVolume, SNDLVL_TO_ATTN(static_cast<soundlevel_t>(sndlevel)),
+					(*pNewFilter, iEntIndex, iChannel, soundEntry, nSoundEntryHash, buffer, flVolume, SNDLVL_TO_ATTN(static_cast<soundlevel_t>(sndlevel)),
 					nSeed, iFlags, iPitch, pOrigin, pDirection, pUtlVecOrigins, bUpdatePositions, soundtime, speakerentity)
 					);
 #elif SOURCE_ENGINE == SE_CSS || SOURCE_ENGINE == SE_HL2DM || SOURCE_ENGINE == SE_DODS || SOURCE_ENGINE == SE_SDK2013 \
@@ -623,7 +722,7 @@ RETURN_META_NEWPARAMS(
 					MRES_IGNORED,
 					static_cast<void (IEngineSound::*)(IRecipientFilter &, int, int, const char *, float, float, 
 					int, int, int, const Vector *, const Vector *, CUtlVector<Vector> *, bool, float, int)>(&IEngineSound::EmitSound), 
-					(crf, iEntIndex, iChannel, buffer, flVolume, SNDLVL_TO_ATTN(static_cast<soundlevel_t>(sndlevel)), 
+					(*pNewFilter, iEntIndex, iChannel, buffer, flVolume, SNDLVL_TO_ATTN(static_cast<soundlevel_t>(sndlevel)), 
 					iFlags, iPitch, iSpecialDSP, pOrigin, pDirection, pUtlVecOrigins, bUpdatePositions, soundtime, speakerentity)
 					);
 #else
@@ -631,7 +730,7 @@ RETURN_META_NEWPARAMS(
 					MRES_IGNORED,
 					static_cast<void (IEngineSound::*)(IRecipientFilter &, int, int, const char *, float, float, 
 					int, int, const Vector *, const Vector *, CUtlVector<Vector> *, bool, float, int)>(&IEngineSound::EmitSound), 
-					(crf, iEntIndex, iChannel, buffer, flVolume, SNDLVL_TO_ATTN(static_cast<soundlevel_t>(sndlevel)), 
+					(*pNewFilter, iEntIndex, iChannel, buffer, flVolume, SNDLVL_TO_ATTN(static_cast<soundlevel_t>(sndlevel)), 
 					iFlags, iPitch, pOrigin, pDirection, pUtlVecOrigins, bUpdatePositions, soundtime, speakerentity)
 					);
 #endif
@@ -1544,7 +1643,30 @@ static cell_t smn_AddNormalSoundHook(IPluginContext *pContext, const cell_t *par
 		return pContext->ThrowNativeError("Invalid function id (%X)", params[1]);
 	}
 
-	s_SoundHooks.AddHook(NORMAL_SOUND_HOOK, pFunc);
+	/* Older plugins only pass the hook */
+	if (params[0] < 3)
+	{
+		s_SoundHooks.AddHook(NORMAL_SOUND_HOOK, pFunc);
+		return 1;
+	}
+
+	char *samplePrefix;
+	pContext->LocalToString(params[2], &samplePrefix);
+
+	/* Entities are matched by reference, the special sources (world, player) by value */
+	cell_t entity = params[3];
+	if (entity > 0 || entity < SOUND_FROM_ANY)
+	{
+		int index = gamehelpers->ReferenceToIndex(entity);
+		cell_t ref = gamehelpers->IndexToReference(index);
+		if ((unsigned)ref == INVALID_EHANDLE_INDEX)
+		{
+			return pContext->ThrowNativeError("Entity %d (%d) is invalid", index, entity);
+		}
+		entity = ref;
+	}
+
+	s_SoundHooks.AddNormalHook(pFunc, samplePrefix, entity);
 
 	return 1;
 }
@@ -33,13 +33,34 @@
 #define _INCLUDE_SOURCEMOD_VSOUND_H_
 
 #include <sh_list.h>
+#include <bitset>
+#include <string>
 #include "extension.h"
 #include "CellRecipientFilter.h"
 
 #define NORMAL_SOUND_HOOK		0
 #define AMBIENT_SOUND_HOOK		1
 
+/* Matches sounds from any entity when used as a normal sound hook's entity filter */
+#define SOUND_FROM_ANY			-3
+
+struct NormalSoundHook
+{
+	IPluginFunction *pFunc;
+	std::string samplePrefix;	/* Empty matches every sample */
+	cell_t entity;				/* Entity reference, world/player source, or SOUND_FROM_ANY */
+};
+
+/* A sound's recipients, decoded once per emit and shared by every hook */
+struct SoundRecipients
+{
+	int players[SM_MAXPLAYERS];
+	int count;
+	std::bitset<SM_MAXPLAYERS + 1> clients;
+};
+
 typedef SourceHook::List<IPluginFunction *>::iterator SoundHookIter;
+typedef SourceHook::List<NormalSoundHook>::iterator NormalSoundHookIter;
 
 class SoundHooks : public IPluginsListener
 {
@@ -49,6 +70,7 @@ public:
 	void Initialize();
 	void Shutdown();
 	void AddHook(int type, IPluginFunction *pFunc);
+	void AddNormalHook(IPluginFunction *pFunc, const char *samplePrefix, cell_t entity);
 	bool RemoveHook(int type, IPluginFunction *pFunc);
 
 	void OnEmitAmbientSound(int entindex, const Vector &pos, const char *samp, float vol, soundlevel_t soundlevel, int fFlags, int pitch, float delay);
@@ -95,12 +117,14 @@ public:
 #endif // SOURCE_ENGINE == SE_CSS, SE_HL2DM, SE_DODS, SE_SDK2013, SE_BMS, SE_TF2, SE_PVKII
 #endif // SOURCE_ENGINE >= SE_PORTAL2
 private:
-	size_t _FillInPlayers(int *pl_array, IRecipientFilter *pFilter);
+	void _DecodeRecipients(SoundRecipients &recipients, IRecipientFilter *pFilter);
+	bool _WantsSound(const NormalSoundHook &hook, const char *sample, int entity);
+	bool _SameRecipients(const SoundRecipients &recipients, const int *players, int size);
 	void _IncRefCounter(int type);
 	void _DecRefCounter(int type);
 private:
 	SourceHook::List<IPluginFunction *> m_AmbientFuncs;
-	SourceHook::List<IPluginFunction *> m_NormalFuncs;
+	SourceHook::List<NormalSoundHook> m_NormalFuncs;
 	size_t m_NormalCount;
 	size_t m_AmbientCount;
 };
@@ -104,6 +104,11 @@ unsigned int TopMenu::CalcMemUsage()
 	size += (m_Objects.size() * (sizeof(topmenu_object_t *) + sizeof(topmenu_object_t)));
 	size += m_ObjLookup.mem_usage();
 
+	for (size_t i = 0; i < m_Objects.size(); i++)
+	{
+		size += m_Objects[i]->renders.size() * (sizeof(uint64_t) + sizeof(topmenu_render_t));
+	}
+
 	for (size_t i = 0; i < m_Categories.size(); i++)
 	{
 		size += m_Categories[i]->obj_list.size() * sizeof(topmenu_object_t *);
@@ -224,6 +229,8 @@ unsigned int TopMenu::AddToMenu2(const char *name,
 	obj->owner = owner;
 	obj->type = type;
 	obj->is_free = false;
+	obj->is_static = false;
+	obj->renders.clear();
 	obj->parent = parent_obj;
 	strncopy(obj->name, name, sizeof(obj->name));
 	strncopy(obj->cmdname, cmdname ? cmdname : "", sizeof(obj->cmdname));
@@ -325,6 +332,8 @@ void TopMenu::RemoveFromMenu(unsigned int object_id)
 					m_ObjLookup.remove(cat->obj_list[j]->name);
 					cat->obj_list[j]->callbacks->OnTopMenuObjectRemoved(this, cat->obj_list[j]->object_id);
 					cat->obj_list[j]->is_free = true;
+					cat->obj_list[j]->is_static = false;
+					cat->obj_list[j]->renders.clear();
 				}
 				
 				/* Remove the category from the list, then delete it. */
@@ -382,6 +391,102 @@ void TopMenu::RemoveFromMenu(unsigned int object_id)
 
 	/* Finally, mark the object as free. */
 	obj->is_free = true;
+	obj->is_static = false;
+	obj->renders.clear();
+}
+
+bool TopMenu::SetObjectStatic(unsigned int object_id, bool is_static)
+{
+	if (object_id == 0 
+		|| object_id > m_Objects.size() 
+		|| m_Objects[object_id - 1]->is_free)
+	{
+		return false;
+	}
+
+	topmenu_object_t *obj = m_Objects[object_id - 1];
+	obj->is_static = is_static;
+	obj->renders.clear();
+
+	return true;
+}
+
+void TopMenu::InvalidateRenders(unsigned int object_id)
+{
+	for (size_t i = 0; i < m_Objects.size(); i++)
+	{
+		if (object_id == 0 || m_Objects[i]->object_id == object_id)
+		{
+			m_Objects[i]->renders.clear();
+		}
+	}
+
+	/* Unsorted items were ordered by their old display text */
+	for (size_t i = 0; i < m_Categories.size(); i++)
+	{
+		m_Categories[i]->serial++;
+	}
+	m_SerialNo++;
+}
+
+topmenu_render_t *TopMenu::FindRender(topmenu_object_t *obj, int client)
+{
+	if (!obj->is_static || obj->is_free)
+	{
+		return NULL;
+	}
+
+	/* Static objects render the same for everyone sharing a language and 
+	 * set of admin flags, so that's all the cache is keyed on.
+	 */
+	FlagBits flags = 0;
+	IGamePlayer *pPlayer = playerhelpers->GetGamePlayer(client);
+	if (pPlayer != NULL && pPlayer->GetAdminId() != INVALID_ADMIN_ID)
+	{
+		flags = adminsys->GetAdminFlags(pPlayer->GetAdminId(), Access_Effective);
+	}
+
+	uint64_t key = ((uint64_t)translator->GetClientLanguage(client) << 32) | flags;
+
+	return &obj->renders[key];
+}
+
+void TopMenu::RenderObject(topmenu_object_t *obj, int client, char buffer[], size_t maxlength)
+{
+	topmenu_render_t *render = FindRender(obj, client);
+	if (render != NULL && render->has_display)
+	{
+		strncopy(buffer, render->display, maxlength);
+		return;
+	}
+
+	obj->callbacks->OnTopMenuDisplayOption(this, client, obj->object_id, buffer, maxlength);
+
+	/* Look the entry up again, the callback may have changed the object */
+	if ((render = FindRender(obj, client)) != NULL)
+	{
+		strncopy(render->display, buffer, sizeof(render->display));
+		render->has_display = true;
+	}
+}
+
+unsigned int TopMenu::DrawObject(topmenu_object_t *obj, int client)
+{
+	topmenu_render_t *render = FindRender(obj, client);
+	if (render != NULL && render->has_style)
+	{
+		return render->style;
+	}
+
+	unsigned int style = obj->callbacks->OnTopMenuDrawOption(this, client, obj->object_id);
+
+	if ((render = FindRender(obj, client)) != NULL)
+	{
+		render->style = style;
+		render->has_style = true;
+	}
+
+	return style;
 }
 
 bool TopMenu::DisplayMenu(int client, unsigned int hold_time, TopMenuPosition position)
@@ -633,7 +738,7 @@ void TopMenu::OnMenuDrawItem(IBaseMenu *menu, int client, unsigned int item, uns
 		}
 	}
 
-	style = obj->callbacks->OnTopMenuDrawOption(this, client, obj->object_id);
+	style = DrawObject(obj, client);
 	if (style != ITEMDRAW_DEFAULT)
 	{
 		return;
@@ -668,7 +773,7 @@ unsigned int TopMenu::OnMenuDisplayItem(IBaseMenu *menu,
 
 	/* Ask the object to render the text for this client */
 	char renderbuf[TOPMENU_DISPLAY_BUFFER_SIZE];
-	obj->callbacks->OnTopMenuDisplayOption(this, client, obj->object_id, renderbuf, sizeof(renderbuf));
+	RenderObject(obj, client, renderbuf, sizeof(renderbuf));
 
 	/* Build the new draw info */
 	ItemDrawInfo new_dr = dr;
@@ -756,11 +861,7 @@ void TopMenu::UpdateClientRoot(int client, IGamePlayer *pGamePlayer)
 		{
 			obj_by_name_t *temp_obj = &item_list[i];
 			topmenu_object_t *obj = m_Categories[m_UnsortedCats[i]]->obj;
-			obj->callbacks->OnTopMenuDisplayOption(this,
-				client, 
-				obj->object_id,
-				temp_obj->name,
-				sizeof(temp_obj->name));
+			RenderObject(obj, client, temp_obj->name, sizeof(temp_obj->name));
 			temp_obj->obj_index = m_UnsortedCats[i];
 		}
 
@@ -863,11 +964,7 @@ void TopMenu::UpdateClientCategory(int client, unsigned int category, bool bSkip
 		{
 			obj_by_name_t *item = &item_list[i];
 			topmenu_object_t *obj = cat->unsorted[i];
-			obj->callbacks->OnTopMenuDisplayOption(this,
-				client,
-				obj->object_id,
-				item->name,
-				sizeof(item->name));
+			RenderObject(obj, client, item->name, sizeof(item->name));
 			item->obj_index = (unsigned int)i;
 			if (!has_access && adminsys->CheckAccess(client, obj->cmdname, obj->flags, false))
 			{
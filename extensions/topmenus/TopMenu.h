@@ -38,6 +38,7 @@
 #include "smsdk_ext.h"
 #include "sm_memtable.h"
 #include <sm_namehashset.h>
+#include <unordered_map>
 
 using namespace SourceHook;
 using namespace SourceMod;
@@ -59,6 +60,14 @@ struct config_root_t
 	CVector<config_category_t *> cats;
 };
 
+struct topmenu_render_t
+{
+	char display[TOPMENU_DISPLAY_BUFFER_SIZE];	/** Rendered display text */
+	unsigned int style;							/** Rendered draw style */
+	bool has_display;							/** Whether display is valid */
+	bool has_style;								/** Whether style is valid */
+};
+
 struct topmenu_object_t
 {
 	char name[64];						/** Name */
@@ -72,6 +81,8 @@ struct topmenu_object_t
 	bool is_free;						/** Free or not? */
 	char info[255];						/** Info string */
 	unsigned int cat_id;				/** Set if a category */
+	bool is_static;						/** Whether renders can be cached */
+	std::unordered_map<uint64_t, topmenu_render_t> renders;	/** Renders by language and access */
 
 	static inline bool matches(const char *name, const topmenu_object_t *topmenu)
 	{
@@ -162,6 +173,8 @@ public:
 	unsigned int CalcMemUsage();
 	void SetTitleCaching(bool cache_titles);
 	bool DisplayMenuAtCategory(int client, unsigned int object_id);
+	bool SetObjectStatic(unsigned int object_id, bool is_static);
+	void InvalidateRenders(unsigned int object_id);
 private:
 	void SortCategoriesIfNeeded();
 	void SortCategoryIfNeeded(unsigned int category);
@@ -172,6 +185,9 @@ private:
 	void UpdateClientCategory(int client, unsigned int category, bool bSkipRootCheck=false);
 	void TearDownClient(topmenu_player_t *player);
 	bool FindCategoryByObject(unsigned int obj_id, size_t *index);
+	topmenu_render_t *FindRender(topmenu_object_t *obj, int client);
+	void RenderObject(topmenu_object_t *obj, int client, char buffer[], size_t maxlength);
+	unsigned int DrawObject(topmenu_object_t *obj, int client);
 private:
 	void OnClientConnected(int client);
 	void OnClientDisconnected(int client);
@@ -417,6 +417,37 @@ static cell_t SetTopMenuTitleCaching(IPluginContext *pContext, const cell_t *par
 	return 0;
 }
 
+static cell_t TopMenu_SetStatic(IPluginContext *pContext, const cell_t *params)
+{
+	HandleError err;
+	TopMenu *pMenu;
+	HandleSecurity sec(pContext->GetIdentity(), myself->GetIdentity());
+
+	if ((err = handlesys->ReadHandle(params[1], hTopMenuType, &sec, (void **)&pMenu))
+		!= HandleError_None)
+	{
+		return pContext->ThrowNativeError("Invalid Handle %x (error: %d)", params[1], err);
+	}
+
+	return pMenu->SetObjectStatic(params[2], params[3] ? true : false) ? 1 : 0;
+}
+
+static cell_t TopMenu_InvalidateRenders(IPluginContext *pContext, const cell_t *params)
+{
+	HandleError err;
+	TopMenu *pMenu;
+	HandleSecurity sec(pContext->GetIdentity(), myself->GetIdentity());
+
+	if ((err = handlesys->ReadHandle(params[1], hTopMenuType, &sec, (void **)&pMenu))
+		!= HandleError_None)
+	{
+		return pContext->ThrowNativeError("Invalid Handle %x (error: %d)", params[1], err);
+	}
+
+	pMenu->InvalidateRenders(params[2]);
+	return 0;
+}
+
 static cell_t TopMenu_AddItem(IPluginContext *pContext, const cell_t *params)
 {
 	cell_t new_params[] = {
@@ -490,6 +521,8 @@ sp_nativeinfo_t g_TopMenuNatives[] =
 	{"TopMenu.GetObjName",		GetTopMenuName},
 	{"TopMenu.CacheTitles.set",	SetTopMenuTitleCaching},
 	{"TopMenu.FromHandle",      TopMenu_FromHandle},
+	{"TopMenu.SetStatic",		TopMenu_SetStatic},
+	{"TopMenu.InvalidateRenders",	TopMenu_InvalidateRenders},
 
 	{NULL,					NULL},
 };
@@ -74,5 +74,6 @@
 #define SMEXT_ENABLE_PLUGINSYS
 #define SMEXT_ENABLE_ADMINSYS
 #define SMEXT_ENABLE_TEXTPARSERS
+#define SMEXT_ENABLE_TRANSLATOR
 
 #endif // _INCLUDE_SOURCEMOD_EXTENSION_CONFIG_H_
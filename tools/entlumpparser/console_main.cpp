@@ -1,12 +1,39 @@
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <string.h>
+#include <stdlib.h>
 
 #include "LumpManager.h"
 
+static void Benchmark(const std::string& data, int iterations) {
+	using clock = std::chrono::steady_clock;
+	
+	EntityLumpManager lumpmgr;
+	clock::duration parse{}, dump{};
+	size_t length = 0;
+	
+	for (int i = 0; i < iterations; i++) {
+		auto start = clock::now();
+		lumpmgr.Parse(data.c_str());
+		auto parsed = clock::now();
+		length = lumpmgr.Dump().size();
+		dump += clock::now() - parsed;
+		parse += parsed - start;
+	}
+	
+	auto average = [iterations](clock::duration total) {
+		return std::chrono::duration<double, std::milli>(total).count() / iterations;
+	};
+	std::cout << data.size() << " bytes, " << lumpmgr.Length() << " entities, " << length << " bytes dumped\n";
+	std::cout << "parse: " << average(parse) << " ms, dump: " << average(dump) << " ms (average of " << iterations << ")\n";
+}
+
 int main(int argc, char *argv[]) {
 	if (argc < 2) {
 		std::cout << "Missing input file\n";
+		std::cout << "Usage: " << argv[0] << " <file> [--bench [iterations]]\n";
 		return 0;
 	}
 	
@@ -15,6 +42,12 @@ int main(int argc, char *argv[]) {
 	std::ifstream input(filepath, std::ios_base::binary);
 	std::string data((std::istreambuf_iterator<char>(input)),  std::istreambuf_iterator<char>());
 	
+	if (argc >= 3 && strcmp(argv[2], "--bench") == 0) {
+		int iterations = argc >= 4 ? atoi(argv[3]) : 20;
+		Benchmark(data, iterations > 0 ? iterations : 1);
+		return 0;
+	}
+	
 	EntityLumpManager lumpmgr;
 	lumpmgr.Parse(data.c_str());
 	